@@ -1,5 +1,6 @@
 #include <boost/python.hpp>
 #include <boost/python/suite/indexing/vector_indexing_suite.hpp>
+#include <stdexcept>
 #include "LPBoostMulticlassClassifier.h"
 #include "container_conversions.h"
 
@@ -7,6 +8,115 @@ using namespace Boosting;
 using namespace boost::python;
 using namespace container_conversions;
 
+// Releases the GIL while in scope.  The arguments are converted before,
+// so the LP work below touches no Python objects and other Python threads,
+// including other classifier instances, run meanwhile.
+class ScopedGILRelease {
+public:
+    ScopedGILRelease() { thread_state = PyEval_SaveThread(); }
+    ~ScopedGILRelease() { PyEval_RestoreThread(thread_state); }
+private:
+    PyThreadState* thread_state;
+};
+
+// The library exits on problems beyond the LP solver's row and element
+// index ranges, which would take the interpreter down with it, also from
+// update_async's worker thread.  Check first and raise RuntimeError.
+void check_fits_solver(bool fits) {
+    if (fits == false)
+        throw std::runtime_error("problem too large for the LP solver");
+}
+
+void initialize_boosting_nogil(LPBoostMulticlassClassifier& c,
+    const std::vector<int>& labels, bool interior_point, const std::string& solver,
+    LPBoostMulticlassClassifier::Formulation formulation) {
+    check_fits_solver(c.CanInitialize(labels.size()));
+    ScopedGILRelease release;
+    c.InitializeBoosting(labels, interior_point, solver, formulation);
+}
+
+void reset_nogil(LPBoostMulticlassClassifier& c, int number_classes,
+    double nu, bool weight_sharing, const std::vector<int>& labels,
+    bool interior_point, const std::string& solver,
+    LPBoostMulticlassClassifier::Formulation formulation) {
+    check_fits_solver(LPBoostMulticlassClassifier::FitsSolver(labels.size(),
+        number_classes, 0, weight_sharing));
+    ScopedGILRelease release;
+    c.Reset(number_classes, nu, weight_sharing, labels, interior_point,
+        solver, formulation);
+}
+
+unsigned int add_multiclass_classifier_nogil(LPBoostMulticlassClassifier& c,
+    const std::vector<std::vector<double> >& response) {
+    check_fits_solver(c.CanAdd(0, 1));
+    ScopedGILRelease release;
+    return c.AddMulticlassClassifier(response);
+}
+
+// Dense (N,K) float32 or float64 response read in place at address, see
+// the strided AddMulticlassClassifier.  The caller keeps the array alive.
+unsigned int add_multiclass_classifier_strided_nogil(LPBoostMulticlassClassifier& c,
+    size_t address, bool single_precision, long sample_stride, long class_stride) {
+    check_fits_solver(c.CanAdd(0, 1));
+    ScopedGILRelease release;
+    if (single_precision)
+        return c.AddMulticlassClassifier(reinterpret_cast<const float*>(address),
+            sample_stride, class_stride);
+    return c.AddMulticlassClassifier(reinterpret_cast<const double*>(address),
+        sample_stride, class_stride);
+}
+
+unsigned int add_multiclass_classifier_sparse_nogil(LPBoostMulticlassClassifier& c,
+    const std::vector<unsigned int>& sample_start, const std::vector<int>& classes,
+    const std::vector<double>& values) {
+    check_fits_solver(c.CanAdd(0, 1));
+    ScopedGILRelease release;
+    return c.AddMulticlassClassifierSparse(sample_start, classes, values);
+}
+
+void add_samples_nogil(LPBoostMulticlassClassifier& c,
+    const std::vector<int>& labels,
+    const std::vector<std::vector<std::vector<double> > >& responses) {
+    check_fits_solver(c.CanAdd(labels.size(), 0));
+    ScopedGILRelease release;
+    c.AddSamples(labels, responses);
+}
+
+// A failed solve raises RuntimeError, also through update_async's future.
+void update_nogil(LPBoostMulticlassClassifier& c) {
+    bool solved;
+    {
+        ScopedGILRelease release;
+        solved = c.Update();
+    }
+    if (solved == false)
+        throw std::runtime_error(
+            "update failed: no weak learners or the LP solver failed");
+}
+
+// The solver's LP as sizes and raw addresses of its arrays, see SolverLP().
+// lpboost_classifier.py wraps these as read-only numpy arrays without
+// copying; they are valid until the problem changes.
+dict solver_lp(const LPBoostMulticlassClassifier& c) {
+    LPBoostMulticlassClassifier::LPData lp = c.SolverLP();
+    dict result;
+    result["number_rows"] = lp.number_rows;
+    result["number_columns"] = lp.number_columns;
+    result["number_elements"] = static_cast<long>(lp.number_elements);
+    result["has_gaps"] = lp.has_gaps;
+    result["index_bytes"] = sizeof(CoinBigIndex);
+    result["column_starts"] = reinterpret_cast<size_t>(lp.column_starts);
+    result["column_lengths"] = reinterpret_cast<size_t>(lp.column_lengths);
+    result["row_indices"] = reinterpret_cast<size_t>(lp.row_indices);
+    result["values"] = reinterpret_cast<size_t>(lp.values);
+    result["column_lower"] = reinterpret_cast<size_t>(lp.column_lower);
+    result["column_upper"] = reinterpret_cast<size_t>(lp.column_upper);
+    result["objective"] = reinterpret_cast<size_t>(lp.objective);
+    result["row_lower"] = reinterpret_cast<size_t>(lp.row_lower);
+    result["row_upper"] = reinterpret_cast<size_t>(lp.row_upper);
+    return result;
+}
+
 
 BOOST_PYTHON_MODULE(_mclp)
 {
@@ -29,16 +139,85 @@ BOOST_PYTHON_MODULE(_mclp)
         
     
     from_python_sequence<std::vector<int>, variable_capacity_policy>();
+    from_python_sequence<std::vector<unsigned int>, variable_capacity_policy>();
     from_python_sequence<std::vector<double>, variable_capacity_policy>();
     from_python_sequence<std::vector<DoubleVector>, variable_capacity_policy>();
+    from_python_sequence<std::vector<DVVector>, variable_capacity_policy>();
     
+    enum_<LPBoostMulticlassClassifier::Formulation>("Formulation")
+        .value("primal", LPBoostMulticlassClassifier::PrimalFormulation)
+        .value("dual", LPBoostMulticlassClassifier::DualFormulation)
+        .value("entropy", LPBoostMulticlassClassifier::EntropyRegularizedFormulation)
+    ;
+
+    enum_<LPBoostMulticlassClassifier::ResponseNormalization>("ResponseNormalization")
+        .value("none", LPBoostMulticlassClassifier::NoNormalization)
+        .value("maxabs", LPBoostMulticlassClassifier::MaxAbsNormalization)
+        .value("std", LPBoostMulticlassClassifier::MarginStdNormalization)
+        ;
+
+    class_<LPBoostMulticlassClassifier::Statistics>("Statistics", no_init)
+        .def_readonly("classifiers_added", &LPBoostMulticlassClassifier::Statistics::classifiers_added)
+        .def_readonly("classifiers_duplicate", &LPBoostMulticlassClassifier::Statistics::classifiers_duplicate)
+        .def_readonly("classifiers_dominated", &LPBoostMulticlassClassifier::Statistics::classifiers_dominated)
+        .def_readonly("barrier_dense_columns", &LPBoostMulticlassClassifier::Statistics::barrier_dense_columns)
+        .def_readonly("solver_iterations", &LPBoostMulticlassClassifier::Statistics::solver_iterations)
+        .def_readonly("cache_hits", &LPBoostMulticlassClassifier::Statistics::cache_hits)
+        .def_readonly("cache_warm_starts", &LPBoostMulticlassClassifier::Statistics::cache_warm_starts)
+        .def_readonly("scratch_allocations", &LPBoostMulticlassClassifier::Statistics::scratch_allocations)
+        .def_readonly("race_simplex_wins", &LPBoostMulticlassClassifier::Statistics::race_simplex_wins)
+        .def_readonly("race_barrier_wins", &LPBoostMulticlassClassifier::Statistics::race_barrier_wins)
+        .def_readonly("race_skipped", &LPBoostMulticlassClassifier::Statistics::race_skipped)
+        .def_readonly("samples_screened", &LPBoostMulticlassClassifier::Statistics::samples_screened)
+        .def_readonly("samples_reinserted", &LPBoostMulticlassClassifier::Statistics::samples_reinserted)
+        .def_readonly("relaxed_row_fraction", &LPBoostMulticlassClassifier::Statistics::relaxed_row_fraction)
+        .def_readonly("coarse_iterations", &LPBoostMulticlassClassifier::Statistics::coarse_iterations)
+        .def_readonly("barrier_threads_ignored", &LPBoostMulticlassClassifier::Statistics::barrier_threads_ignored)
+    ;
+
+    class_<LPBoostMulticlassClassifier::ValidationResult>("ValidationResult", no_init)
+        .def_readonly("accuracy", &LPBoostMulticlassClassifier::ValidationResult::accuracy)
+        .def_readonly("margins", &LPBoostMulticlassClassifier::ValidationResult::margins)
+        .def_readonly("learners_changed", &LPBoostMulticlassClassifier::ValidationResult::learners_changed)
+        .def_readonly("seconds", &LPBoostMulticlassClassifier::ValidationResult::seconds)
+    ;
+
     class_<LPBoostMulticlassClassifier>("LPBoostMulticlassClassifier_wrap", init<int, double, bool>())
-        .def("initialize_boosting", &LPBoostMulticlassClassifier::InitializeBoosting, "(Re)initialize the object to allow boosting")
-        .def("add_multiclass_classifier",  &LPBoostMulticlassClassifier::AddMulticlassClassifier)
-        .def("update",  &LPBoostMulticlassClassifier::Update, "Solve for the optimal blend of the weak learners")
+        .def("initialize_boosting", &initialize_boosting_nogil, "(Re)initialize the object to allow boosting")
+        .def("reset", &reset_nogil, "Start a new job (number_classes, nu, weight_sharing, labels, interior_point, solver, formulation), reusing the solver and buffers")
+        .def("set_solver_pool_size", &LPBoostMulticlassClassifier::SetSolverPoolSize, "Keep up to max_idle solvers of destroyed classifiers for reuse, process-wide")
+        .staticmethod("set_solver_pool_size")
+        .def("add_multiclass_classifier",  &add_multiclass_classifier_nogil)
+        .def("add_multiclass_classifier_strided",  &add_multiclass_classifier_strided_nogil, "Add a weak learner given as the address, precision and element strides of a dense response array")
+        .def("add_multiclass_classifier_sparse",  &add_multiclass_classifier_sparse_nogil, "Add a weak learner given as CSR (indptr, indices, data) response matrix")
+        .def("add_samples", &add_samples_nogil, "Append samples (labels, per weak learner responses) to the problem")
+        .def("set_nu", &LPBoostMulticlassClassifier::SetNu, "Change nu, keeping the weak learners; the next update continues from the last basis")
+        .def("set_initial_weights", &LPBoostMulticlassClassifier::SetInitialWeights, "Warm start the next update from prior weights (weights, fixed_rho, rho)")
+        .def("set_redundancy_check", &LPBoostMulticlassClassifier::SetRedundancyCheck, "Reject duplicate (and dominated) weak learners, set before adding any")
+        .def("set_response_normalization", &LPBoostMulticlassClassifier::SetResponseNormalization, "Normalize the responses of each weak learner, set before adding any")
+        .def("set_solution_cache", &LPBoostMulticlassClassifier::SetSolutionCache, "Cache solved problems in a directory (directory, max_bytes), set before initialize_boosting")
+        .def("set_lp_scaling", &LPBoostMulticlassClassifier::SetLPScaling, "Clp scaling mode: 0 off, 1 equilibrium, 2 geometric, 3 automatic, -1 default")
+        .def("set_validation_set", &LPBoostMulticlassClassifier::SetValidationSet, "Track accuracy on a validation set (labels, threads) after each update")
+        .def("add_validation_response", &LPBoostMulticlassClassifier::AddValidationResponse, "Responses of a weak learner (id, response) on the validation set")
+        .def("set_barrier_options", &LPBoostMulticlassClassifier::SetBarrierOptions, "Cholesky threads and dense column limit of the barrier solver (threads, max_dense_columns)")
+        .def("set_solver_race", &LPBoostMulticlassClassifier::SetSolverRace, "Race dual simplex against barrier in each update (race, decisive_wins), Clp only")
+        .def("set_sample_screening", &LPBoostMulticlassClassifier::SetSampleScreening, "Relax the margin rows of samples beyond the margin (enable, margin_threshold), checked after each update")
+        .def("set_coarse_to_fine", &LPBoostMulticlassClassifier::SetCoarseToFine, "Start the first simplex update from stratified subsample solves (levels, fraction)")
+        .def("set_class_groups", &LPBoostMulticlassClassifier::SetClassGroups, "Share the weights within groups of classes (class_groups), set before adding weak learners")
+        .def("group_classes_by_confusion", &LPBoostMulticlassClassifier::GroupClassesByConfusion, "Group the classes most confused with each other (confusion, number_groups), for set_class_groups")
+        .staticmethod("group_classes_by_confusion")
+        .def("set_entropy_tolerance", &LPBoostMulticlassClassifier::SetEntropyTolerance, "Tolerance epsilon of the entropy regularized formulation, set before update")
+        .def("update",  &update_nogil, "Solve for the optimal blend of the weak learners, releases the GIL")
+        .def("solver_lp", &solver_lp, "Sizes and array addresses of the solver's LP, see lp_arrays()")
+        .def("set_solution", &LPBoostMulticlassClassifier::SetSolution, "Use an external solution (column_solution, row_price) of the solver's LP, returns its largest violation")
         .def("get_weights", &LPBoostMulticlassClassifier::ClassifierWeights, return_value_policy<copy_const_reference>())
-        .add_property("rho", &LPBoostMulticlassClassifier::Rho)
-        .add_property("gamma", &LPBoostMulticlassClassifier::Gamma)
+        .def("get_raw_weights", &LPBoostMulticlassClassifier::RawClassifierWeights, "Weights for the responses as given, without normalization")
+        .def("get_response_scales", &LPBoostMulticlassClassifier::ResponseScales, return_value_policy<copy_const_reference>())
+        .def("get_rho", &LPBoostMulticlassClassifier::Rho)
+        .def("get_gamma", &LPBoostMulticlassClassifier::Gamma)
+        .def("get_margin_distribution", &LPBoostMulticlassClassifier::MarginDistribution, return_value_policy<copy_const_reference>())
+        .def("get_validation", &LPBoostMulticlassClassifier::Validation, return_value_policy<copy_const_reference>())
+        .def("get_stats", &LPBoostMulticlassClassifier::Stats, return_value_policy<copy_const_reference>())
     ;
     
     
@@ -39,4 +39,341 @@ def noise_learning_test():
     c.update()
 
     assert(c.weights[0][0] - 1.0 <  1e-8)
-    assert(c.rho - 1.0 < 1e-8)
\ No newline at end of file
+    assert(c.rho - 1.0 < 1e-8)
+
+def async_update_test():
+
+    from mclp import LPBoostMulticlassClassifier
+
+    c = LPBoostMulticlassClassifier(3, 0.1)
+    c.add_multiclass_classifier([[1.0, 0.0, 0.0],
+                                 [0.0, 1.0, 0.0],
+                                 [0.0, 0.0, 1.0]])
+
+    future = c.update_async()
+    future.result()
+
+    # adding waits for a pending solve
+    c.update_async()
+    c.add_multiclass_classifier([[0.3, 0.3, 0.3],
+                                 [0.4, 0.4, 0.4],
+                                 [0.5, 0.5, 0.5]])
+    c.update()
+
+    assert(abs(c.weights[0][0] - 1.0) < 1e-8)
+    assert(abs(c.rho - 1.0) < 1e-8)
+
+    # so do the results of the last update
+    c.update_async()
+    assert(abs(c.rho - 1.0) < 1e-8)
+    assert(c.pending is None)
+    c.update_async()
+    assert(c.stats.solver_iterations >= 0)
+    assert(c.pending is None)
+
+def add_samples_test():
+
+    from mclp import LPBoostMulticlassClassifier
+
+    c = LPBoostMulticlassClassifier(3, 0.1, labels=[0, 1])
+    c.add_multiclass_classifier([[1.0, 0.0, 0.0],
+                                 [0.0, 1.0, 0.0]])
+    c.update()
+
+    # the third sample, with the response of the single weak learner on it
+    c.add_samples([2], [[[0.0, 0.0, 1.0]]])
+    c.update()
+
+    assert(abs(c.weights[0][0] - 1.0) < 1e-8)
+    assert(abs(c.rho - 1.0) < 1e-8)
+
+def validation_test():
+
+    from mclp import LPBoostMulticlassClassifier
+
+    c = LPBoostMulticlassClassifier(3, 0.1)
+    c.set_validation_set([2, 1], 2)
+    c.add_multiclass_classifier([[1.0, 0.0, 0.0],
+                                 [0.0, 1.0, 0.0],
+                                 [0.0, 0.0, 1.0]],
+                                validation_response=[[0.0, 0.2, 0.8],
+                                                     [0.6, 0.4, 0.0]])
+    c.update()
+
+    assert(abs(c.validation.accuracy - 0.5) < 1e-8)
+    assert(abs(c.validation.margins[0] - 0.6) < 1e-8)
+    assert(c.validation.learners_changed == 1)
+
+def dual_formulation_test():
+
+    from mclp import LPBoostMulticlassClassifier
+
+    responses = [[[1.0, 0.0, 0.0],
+                  [0.0, 1.0, 0.0],
+                  [0.0, 0.0, 1.0]],
+                 [[0.3, 0.3, 0.3],
+                  [0.4, 0.4, 0.4],
+                  [0.5, 0.5, 0.5]]]
+    primal = LPBoostMulticlassClassifier(3, 0.1)
+    dual = LPBoostMulticlassClassifier(3, 0.1, formulation="dual")
+    for response in responses:
+        primal.add_multiclass_classifier(response)
+        dual.add_multiclass_classifier(response)
+    primal.update()
+    dual.update()
+
+    assert(abs(primal.gamma - dual.gamma) < 1e-8)
+    assert(abs(primal.rho - dual.rho) < 1e-8)
+    assert(abs(dual.weights[0][0] - 1.0) < 1e-8)
+
+
+def entropy_formulation_test():
+
+    from mclp import LPBoostMulticlassClassifier
+
+    responses = [[[1.0, 0.0, 0.0],
+                  [0.0, 1.0, 0.0],
+                  [0.0, 0.0, 1.0]],
+                 [[0.3, 0.3, 0.3],
+                  [0.4, 0.4, 0.4],
+                  [0.5, 0.5, 0.5]]]
+    lp = LPBoostMulticlassClassifier(3, 0.5)
+    erlp = LPBoostMulticlassClassifier(3, 0.5, formulation="entropy",
+                                       entropy_epsilon=0.05)
+    for response in responses:
+        lp.add_multiclass_classifier(response)
+        erlp.add_multiclass_classifier(response)
+    lp.update()
+    erlp.update()
+
+    assert(erlp.gamma <= lp.gamma + 1e-8)
+    assert(erlp.gamma >= lp.gamma - 0.05)
+    assert(abs(sum(sum(row) for row in erlp.margin_distribution) - 1.0) < 1e-8)
+
+
+def normalization_test():
+
+    from mclp import LPBoostMulticlassClassifier
+
+    responses = [[[1.0, 0.0, 0.0],
+                  [0.0, 1.0, 0.0],
+                  [0.0, 0.0, 1.0]],
+                 [[30.0, 0.0, 0.0],
+                  [0.0, 40.0, 0.0],
+                  [50.0, 0.0, 0.0]]]
+    c = LPBoostMulticlassClassifier(3, 0.1, normalization="maxabs")
+    for response in responses:
+        c.add_multiclass_classifier(response)
+    c.update()
+
+    assert(abs(c.response_scales[1] - 1.0 / 50.0) < 1e-12)
+    for m in range(2):
+        assert(abs(c.raw_weights[0][m] -
+                   c.weights[0][m] * c.response_scales[m]) < 1e-12)
+
+
+def solution_cache_test():
+
+    import shutil
+    import tempfile
+    from mclp import LPBoostMulticlassClassifier
+
+    response = [[1.0, 0.0, 0.0],
+                [0.0, 1.0, 0.0],
+                [0.0, 0.0, 1.0]]
+    cache_dir = tempfile.mkdtemp()
+    try:
+        first = LPBoostMulticlassClassifier(3, 0.1, cache_dir=cache_dir)
+        first.add_multiclass_classifier(response)
+        first.update()
+        second = LPBoostMulticlassClassifier(3, 0.1, cache_dir=cache_dir)
+        second.add_multiclass_classifier(response)
+        second.update()
+
+        assert(first.stats.cache_hits == 0)
+        assert(second.stats.cache_hits == 1)
+        assert(abs(first.gamma - second.gamma) < 1e-12)
+    finally:
+        shutil.rmtree(cache_dir)
+
+
+def external_solution_test():
+
+    from mclp import LPBoostMulticlassClassifier
+
+    response = [[1.0, 0.0, 0.0],
+                [0.0, 1.0, 0.0],
+                [0.0, 0.0, 1.0]]
+    solved = LPBoostMulticlassClassifier(3, 0.1)
+    solved.add_multiclass_classifier(response)
+    solved.update()
+
+    c = LPBoostMulticlassClassifier(3, 0.1)
+    c.add_multiclass_classifier(response)
+    lp = c.lp_arrays()
+    assert(len(lp["objective"]) == 1 + 3 + 1)
+    assert(len(lp["row_lower"]) == 1 + 3 * 2)
+    assert(lp["objective"][0] == -1.0)
+    assert(not lp["values"].flags.writeable)
+
+    # [rho, xi_1, xi_2, xi_3, alpha], all samples at margin one
+    x = [solved.rho, 0.0, 0.0, 0.0, solved.weights[0][0]]
+    y = [0.0] + [1.0 / 6] * 6
+    assert(c.set_solution(x, y) < 1e-12)
+    assert(abs(c.gamma - solved.gamma) < 1e-8)
+    assert(list(c.weights[0]) == list(solved.weights[0]))
+
+    # the same matrix as scipy.sparse
+    A = c.lp_matrix()
+    assert(A.shape == (7, 5))
+    assert(A.nnz == len(lp["values"]))
+
+
+def strided_response_test():
+
+    import numpy
+    from mclp import LPBoostMulticlassClassifier
+
+    response = numpy.array([[0.9, 0.1, 0.0],
+                            [0.2, 0.7, 0.1],
+                            [0.1, 0.3, 0.6]])
+    nested = LPBoostMulticlassClassifier(3, 0.1)
+    nested.add_multiclass_classifier(response.tolist())
+    nested.update()
+
+    # row-major, column-major and single precision arrays are read in place
+    for array in (response, numpy.asfortranarray(response),
+                  response.astype(numpy.float32)):
+        c = LPBoostMulticlassClassifier(3, 0.1)
+        assert(c.add_multiclass_classifier(array) == 0)
+        c.update()
+        assert(abs(c.gamma - nested.gamma) < 1e-6)
+
+def reset_test():
+
+    from mclp import LPBoostMulticlassClassifier
+
+    c = LPBoostMulticlassClassifier(3, 0.1)
+    c.add_multiclass_classifier([[1.0, 0.0, 0.0],
+                                 [0.0, 1.0, 0.0],
+                                 [0.0, 0.0, 1.0]])
+    c.update()
+
+    # a second, two class job on the same object
+    c.reset([0, 1, 1], number_of_classes=2, nu=0.5)
+    assert(len(c.weights) == 0)
+    try:
+        c.update()
+        assert(False)
+    except RuntimeError:
+        pass    # no weak learners yet
+    c.add_multiclass_classifier([[1.0, 0.0],
+                                 [0.0, 1.0],
+                                 [0.0, 1.0]])
+    c.update()
+
+    fresh = LPBoostMulticlassClassifier(2, 0.5, labels=[0, 1, 1])
+    fresh.add_multiclass_classifier([[1.0, 0.0],
+                                     [0.0, 1.0],
+                                     [0.0, 1.0]])
+    fresh.update()
+    assert(abs(c.rho - fresh.rho) < 1e-8)
+    assert(abs(c.weights[0][0] - fresh.weights[0][0]) < 1e-8)
+
+def solver_race_test():
+
+    from mclp import LPBoostMulticlassClassifier
+
+    c = LPBoostMulticlassClassifier(3, 0.1, race_solvers=True)
+    c.add_multiclass_classifier([[1.0, 0.0, 0.0],
+                                 [0.0, 1.0, 0.0],
+                                 [0.0, 0.0, 1.0]])
+    c.update()
+
+    assert(abs(c.weights[0][0] - 1.0) < 1e-8)
+    assert(c.stats.race_simplex_wins + c.stats.race_barrier_wins == 1)
+
+
+def sample_screening_test():
+
+    from mclp import LPBoostMulticlassClassifier
+
+    labels = [n % 3 for n in range(12)]
+    screened = LPBoostMulticlassClassifier(3, 0.2, labels=labels,
+                                           screen_samples=True)
+    full = LPBoostMulticlassClassifier(3, 0.2, labels=labels)
+    for m in range(4):
+        # right on most samples first, then on the hard ones n % 4 == 0
+        response = []
+        for n in range(12):
+            right = (n % (m + 4) != 0) if m < 2 else (n % 4 == 0)
+            row = [0.0, 0.0, 0.0]
+            row[n % 3 if right else (n + 1) % 3] = 1.0
+            response.append(row)
+        screened.add_multiclass_classifier(response)
+        full.add_multiclass_classifier(response)
+        screened.update()
+        full.update()
+        assert(abs(screened.gamma - full.gamma) < 1e-6)
+        if m == 0:
+            assert(screened.stats.samples_screened > 0)
+
+    assert(screened.stats.relaxed_row_fraction ==
+           screened.stats.samples_screened / 12.0)
+
+
+def coarse_to_fine_test():
+
+    from mclp import LPBoostMulticlassClassifier
+
+    labels = [(n * 7) % 3 for n in range(30)]
+    coarse = LPBoostMulticlassClassifier(3, 0.2, labels=labels,
+                                         coarse_levels=2, coarse_fraction=0.2)
+    cold = LPBoostMulticlassClassifier(3, 0.2, labels=labels)
+    for m in range(4):
+        response = []
+        for n in range(30):
+            row = [0.0, 0.0, 0.0]
+            row[(labels[n] + (n % (m + 2) == 0)) % 3] = 1.0 + 0.1 * (n % 5)
+            response.append(row)
+        coarse.add_multiclass_classifier(response)
+        cold.add_multiclass_classifier(response)
+    coarse.update()
+    cold.update()
+
+    assert(abs(coarse.gamma - cold.gamma) < 1e-6)
+    assert(coarse.stats.coarse_iterations > 0)
+
+
+def class_groups_test():
+
+    from mclp import LPBoostMulticlassClassifier
+
+    labels = [n % 4 for n in range(24)]
+    groups = LPBoostMulticlassClassifier.group_classes_by_confusion(
+        [[8, 0, 4, 1], [0, 9, 1, 3], [5, 1, 7, 0], [1, 4, 0, 9]], 2)
+    assert(list(groups) == [0, 1, 0, 1])
+
+    grouped = LPBoostMulticlassClassifier(4, 0.5, labels=labels,
+                                          class_groups=[0, 1, 0, 1])
+    shared = LPBoostMulticlassClassifier(4, 0.5, labels=labels)
+    individual = LPBoostMulticlassClassifier(4, 0.5, labels=labels,
+                                             weight_sharing=False)
+    for m in range(5):
+        response = []
+        for n in range(24):
+            right = labels[n] in (m % 4, (m + 1) % 4) or n % 3 == 0
+            row = [0.0, 0.0, 0.0, 0.0]
+            row[(labels[n] if right else labels[n] + 1 + n % 3) % 4] = 1.0
+            response.append(row)
+        for c in (grouped, shared, individual):
+            c.add_multiclass_classifier(response)
+    for c in (grouped, shared, individual):
+        c.update()
+
+    assert(shared.gamma <= grouped.gamma + 1e-6)
+    assert(grouped.gamma <= individual.gamma + 1e-6)
+    weights = grouped.weights
+    assert(len(weights) == 4)
+    assert(list(weights[0]) == list(weights[2]))
+    assert(list(weights[1]) == list(weights[3]))
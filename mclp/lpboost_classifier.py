@@ -1,10 +1,33 @@
-from _mclp import LPBoostMulticlassClassifier_wrap
+from _mclp import LPBoostMulticlassClassifier_wrap, Formulation, ResponseNormalization
+from concurrent.futures import ThreadPoolExecutor
 import numpy
 
+try:
+    from scipy.sparse import issparse as is_sparse
+except ImportError:
+    def is_sparse(x):
+        return False
+
 # A Python layer to add syntactic sugar, error checking, etc. to the 
 # boost-wrapped object
 
 
+class _BorrowedArray(object):
+    """
+    A read-only numpy view on memory owned by the classifier; keeps the
+    classifier alive as long as the view.
+    """
+
+    def __init__(self, owner, address, length, typestr):
+        self.owner = owner
+        self.__array_interface__ = {
+            "shape": (length,),
+            "typestr": typestr,
+            "data": (address, True),
+            "version": 3,
+        }
+
+
 class LPBoostMulticlassClassifier (LPBoostMulticlassClassifier_wrap):
 
     
@@ -13,31 +36,360 @@ class LPBoostMulticlassClassifier (LPBoostMulticlassClassifier_wrap):
         self.number_of_classes = number_of_classes
         self.nu = nu
         self.weight_sharing = kwargs.get("weight_sharing", True)
+        # group of each class, the classes of a group share their weights,
+        # see SetClassGroups and group_classes_by_confusion
+        self.class_groups = kwargs.get("class_groups", None)
         self.labels = kwargs.get("labels", range(0, self.number_of_classes))
         if(self.labels.__class__ == numpy.ndarray):
             self.labels = self.labels.tolist()
         self.interior_point = kwargs.get("interior_point", False)
+        # Cholesky threads of the barrier solver, 0 for the default, and
+        # its dense column limit, see SetBarrierOptions.  The threads need
+        # -fopenmp or -DHAS_OPENBLAS in CHOLESKY_FLAGS when building
+        self.barrier_threads = kwargs.get("barrier_threads", 0)
+        self.max_dense_columns = kwargs.get("max_dense_columns", 300)
+        # race simplex against barrier in every update, until one method
+        # won race_decisive_wins in a row (0: always), see SetSolverRace
+        self.race_solvers = kwargs.get("race_solvers", False)
+        self.race_decisive_wins = kwargs.get("race_decisive_wins", 0)
+        # relax the rows of samples beyond the margin by
+        # screening_threshold, a heuristic checked after each update,
+        # primal formulation only, see SetSampleScreening
+        self.screen_samples = kwargs.get("screen_samples", False)
+        self.screening_threshold = kwargs.get("screening_threshold", 0.1)
+        # solve the first update on coarse_levels growing subsamples from
+        # coarse_fraction of each class first, see SetCoarseToFine
+        self.coarse_levels = kwargs.get("coarse_levels", 0)
+        self.coarse_fraction = kwargs.get("coarse_fraction", 0.1)
         self.solver = kwargs.get("solver", "clp")
+        # "primal", "dual" or "entropy", see Formulation in
+        # LPBoostMulticlassClassifier.h
+        self.formulation = kwargs.get("formulation", "primal")
+        self.entropy_epsilon = kwargs.get("entropy_epsilon", 0.01)
+        # "none", "maxabs" or "std", see ResponseNormalization
+        self.normalization = kwargs.get("normalization", "none")
+        # on-disk cache of solved problems, see SetSolutionCache
+        self.cache_dir = kwargs.get("cache_dir", None)
+        self.cache_size = kwargs.get("cache_size", 1 << 30)
+        self.redundancy_epsilon = kwargs.get("redundancy_epsilon", None)
+        self.drop_dominated = kwargs.get("drop_dominated", False)
         
         
+        # background solver thread and the pending update_async() future
+        self.executor = None
+        self.pending = None
+        
         LPBoostMulticlassClassifier_wrap.__init__(self, self.number_of_classes, self.nu, self.weight_sharing)
-        self.initialize_boosting(self.labels, self.interior_point, self.solver)
+        self.set_response_normalization(ResponseNormalization.names[self.normalization])
+        if self.redundancy_epsilon is not None:
+            self.set_redundancy_check(True, self.redundancy_epsilon, self.drop_dominated)
+        if self.cache_dir is not None:
+            self.set_solution_cache(self.cache_dir, self.cache_size)
+        if self.race_solvers:
+            self.set_solver_race(True, self.race_decisive_wins)
+        if self.screen_samples:
+            self.set_sample_screening(True, self.screening_threshold)
+        if self.coarse_levels > 0:
+            self.set_coarse_to_fine(self.coarse_levels, self.coarse_fraction)
+        if self.class_groups is not None:
+            self.set_class_groups(list(self.class_groups))
+        self.initialize_boosting(self.labels, self.interior_point, self.solver,
+                                 Formulation.names[self.formulation])
+        self.set_barrier_options(self.barrier_threads, self.max_dense_columns)
+        if self.formulation == "entropy":
+            self.set_entropy_tolerance(self.entropy_epsilon)
+
+    def reset(self, labels, **kwargs):
+        """
+        Start a new training job on this object, taking the constructor
+        keyword arguments number_of_classes, nu, weight_sharing,
+        class_groups, interior_point, solver, formulation,
+        entropy_epsilon, barrier_threads and max_dense_columns; the others
+        keep their values.  The LP solver and buffers are reused, cheaper
+        than a new object for many small problems.
+        """
+        self.wait()
+        for name in ("number_of_classes", "nu", "weight_sharing",
+                     "class_groups", "interior_point", "solver",
+                     "formulation", "entropy_epsilon", "barrier_threads",
+                     "max_dense_columns"):
+            if name in kwargs:
+                setattr(self, name, kwargs[name])
+        if(labels.__class__ == numpy.ndarray):
+            labels = labels.tolist()
+        self.labels = labels
+        LPBoostMulticlassClassifier_wrap.reset(self, self.number_of_classes,
+            self.nu, self.weight_sharing, self.labels, self.interior_point,
+            self.solver, Formulation.names[self.formulation])
+        if self.class_groups is not None:
+            self.set_class_groups(list(self.class_groups))
+        self.set_barrier_options(self.barrier_threads, self.max_dense_columns)
+        if self.formulation == "entropy":
+            self.set_entropy_tolerance(self.entropy_epsilon)
 
     @property
     def weights(self): 
+        self.wait()
         return self.get_weights()
 
-    def add_multiclass_classifier(self, classifier):
+    @property
+    def raw_weights(self):
+        """Weights for the responses as given, the same as weights
+        without normalization."""
+        self.wait()
+        return self.get_raw_weights()
+
+    # The results of the last update, read after a pending update_async()
+    # solve finished.
+
+    @property
+    def rho(self):
+        self.wait()
+        return self.get_rho()
+
+    @property
+    def gamma(self):
+        self.wait()
+        return self.get_gamma()
+
+    @property
+    def margin_distribution(self):
+        self.wait()
+        return self.get_margin_distribution()
+
+    @property
+    def response_scales(self):
+        self.wait()
+        return self.get_response_scales()
+
+    @property
+    def validation(self):
+        self.wait()
+        return self.get_validation()
+
+    @property
+    def stats(self):
+        self.wait()
+        return self.get_stats()
+
+    def update(self):
+        """
+        Solve for the optimal blend of the weak learners.  The GIL is
+        released while solving.  Raises RuntimeError when no weak learner
+        has been added yet or the LP solver fails.
+        """
+        self.wait()
+        LPBoostMulticlassClassifier_wrap.update(self)
+
+    def update_async(self):
+        """
+        Start update() on a background thread and return a
+        concurrent.futures.Future for it.  Weak learners can be trained
+        meanwhile; adding them, updating again or reading the weights, rho,
+        gamma, stats or validation waits for the pending solve to finish.
+        """
+        self.wait()
+        if self.executor is None:
+            self.executor = ThreadPoolExecutor(max_workers=1)
+        self.pending = self.executor.submit(LPBoostMulticlassClassifier_wrap.update, self)
+        return self.pending
+
+    def set_nu(self, nu):
+        """
+        Change nu of the problem, keeping its weak learners.  The next
+        update() continues from the last solution.
+        """
+        self.wait()
+        self.nu = nu
+        LPBoostMulticlassClassifier_wrap.set_nu(self, nu)
+
+    def set_initial_weights(self, weights, rho=None):
+        """
+        Warm start the next update() from the weights of a previous model,
+        in the layout of the weights property.  If rho is None, the best
+        margin for the weights is used.
+        """
+        self.wait()
+        if(weights.__class__ == numpy.ndarray):
+            weights = weights.tolist()
+        LPBoostMulticlassClassifier_wrap.set_initial_weights(self, weights,
+            rho is not None, 0.0 if rho is None else rho)
+
+    def add_samples(self, labels, responses):
+        """
+        Append samples to the problem without rebuilding it.  responses
+        holds, for every weak learner added so far in order, its (samples,
+        classes) response matrix on the new samples.  The next update()
+        continues from the previous solution.  Raises RuntimeError when the
+        problem would exceed the LP solver's row or element index range.
+        """
+        self.wait()
+        if(labels.__class__ == numpy.ndarray):
+            labels = labels.tolist()
+        formatted = []
+        for response in responses:
+            if is_sparse(response):
+                response = response.toarray()
+            if(response.__class__ == numpy.ndarray):
+                response = response.tolist()
+            formatted.append(response)
+        LPBoostMulticlassClassifier_wrap.add_samples(self, labels, formatted)
+        self.labels = list(self.labels) + list(labels)
+
+    def lp_arrays(self):
+        """
+        The LP held by the solver as a dict of read-only numpy arrays,
+        without copying:
+            minimize objective' x
+            subject to row_lower <= A x <= row_upper,
+                       column_lower <= x <= column_upper,
+        with A column-major in column_starts, column_lengths, row_indices
+        and values, see SolverLP() in LPBoostMulticlassClassifier.h.  With
+        the dual formulation this is the dual LP.  The arrays are only
+        valid until the next update() or change of the problem.
+        """
+        self.wait()
+        lp = self.solver_lp()
+        rows = lp["number_rows"]
+        columns = lp["number_columns"]
+        # native byte order typestrs, e.g. "<i4" and "<f8"
+        index = numpy.dtype("i%d" % lp["index_bytes"]).str
+        intc = numpy.dtype(numpy.intc).str
+        double = numpy.dtype(numpy.float64).str
+
+        def borrow(name, length, typestr):
+            if length == 0:
+                return numpy.zeros(0, typestr)
+            return numpy.asarray(_BorrowedArray(self, lp[name], length, typestr))
+
+        arrays = {"has_gaps": lp["has_gaps"]}
+        for name, length, typestr in (
+                ("column_starts", columns, index),
+                ("column_lengths", columns, intc),
+                ("row_indices", lp["number_elements"], intc),
+                ("values", lp["number_elements"], double),
+                ("column_lower", columns, double),
+                ("column_upper", columns, double),
+                ("objective", columns, double),
+                ("row_lower", rows, double),
+                ("row_upper", rows, double)):
+            arrays[name] = borrow(name, length, typestr)
+        return arrays
+
+    def lp_matrix(self):
+        """
+        The constraint matrix of lp_arrays() as a scipy.sparse.csc_matrix.
+        Its indices and data share the solver's memory; only indptr, one
+        entry per column, is copied.  When the solver's matrix has gaps
+        between columns, it is compacted into a copy.
+        """
+        from scipy.sparse import csc_matrix
+
+        lp = self.lp_arrays()
+        starts = lp["column_starts"]
+        lengths = lp["column_lengths"]
+        shape = (len(lp["row_lower"]), len(starts))
+        if not lp["has_gaps"]:
+            indptr = numpy.append(starts, len(lp["values"])).astype(starts.dtype)
+            return csc_matrix((lp["values"], lp["row_indices"], indptr),
+                              shape=shape, copy=False)
+        keep = numpy.concatenate([numpy.arange(s, s + l)
+                                  for s, l in zip(starts, lengths)] +
+                                 [numpy.zeros(0, int)])
+        indptr = numpy.concatenate([[0], numpy.cumsum(lengths)])
+        return csc_matrix((lp["values"][keep], lp["row_indices"][keep],
+                           indptr), shape=shape)
+
+    def set_solution(self, column_solution, row_price):
+        """
+        Use a solution of the lp_arrays() LP computed elsewhere in place of
+        update(): column_solution holds x, row_price the dual values of the
+        rows.  The weights, rho, gamma and margin distribution are taken
+        from it.  Returns the largest violation of the bounds and rows by
+        x, zero for a feasible solution.
+        """
+        self.wait()
+        if(column_solution.__class__ == numpy.ndarray):
+            column_solution = column_solution.tolist()
+        if(row_price.__class__ == numpy.ndarray):
+            row_price = row_price.tolist()
+        return LPBoostMulticlassClassifier_wrap.set_solution(self,
+            column_solution, row_price)
+
+    def wait(self):
+        """
+        Wait for a pending update_async() solve, re-raising its error.
+        """
+        if self.pending is not None:
+            pending = self.pending
+            self.pending = None
+            pending.result()
+
+    def set_validation_set(self, labels, threads=1):
+        """
+        Track held-out accuracy after each update().  Pass the responses of
+        each weak learner on the validation set to
+        add_multiclass_classifier; the results are in the validation
+        property (accuracy, margins, learners_changed, seconds).
+        """
+        self.wait()
+        if(labels.__class__ == numpy.ndarray):
+            labels = labels.tolist()
+        LPBoostMulticlassClassifier_wrap.set_validation_set(self, labels, threads)
+
+    def _strided(self, response):
+        """
+        Whether response is a (samples, classes) float32 or float64 array in
+        native byte order that the strided interface can read in place.
+        """
+        return (response.__class__ == numpy.ndarray and
+                response.ndim == 2 and
+                response.shape == (len(self.labels), self.number_of_classes) and
+                response.dtype in (numpy.float32, numpy.float64) and
+                response.dtype.isnative and
+                all(stride % response.dtype.itemsize == 0
+                    for stride in response.strides))
+
+    def add_multiclass_classifier(self, classifier, validation_response=None):
         """
         Add information about an additional weak learner to the queue of classifiers
-        to be blended.
+        to be blended.  Returns the learner's index in the weights; with
+        redundancy_epsilon set, a redundant learner gets the index of the
+        existing learner replacing it.  validation_response holds the
+        learner's responses on the set given to set_validation_set.
+        Raises RuntimeError when the problem would exceed the LP solver's
+        element index range.
         """
         
         formatted = classifier
+        self.wait()
         
-        if(formatted.__class__ == numpy.ndarray):
-            formatted = formatted.tolist()
+        if is_sparse(formatted):
+            # only the non-zero responses are passed on, see
+            # add_multiclass_classifier_sparse
+            formatted = formatted.tocsr()
+            formatted.eliminate_zeros()
+            learner_id = LPBoostMulticlassClassifier_wrap.add_multiclass_classifier_sparse(self,
+                formatted.indptr.tolist(), formatted.indices.tolist(), formatted.data.tolist())
+        elif self._strided(formatted):
+            # read in place, without converting to nested lists
+            itemsize = formatted.dtype.itemsize
+            learner_id = LPBoostMulticlassClassifier_wrap.add_multiclass_classifier_strided(self,
+                formatted.__array_interface__["data"][0], itemsize == 4,
+                formatted.strides[0] // itemsize, formatted.strides[1] // itemsize)
+        else:
+            if(formatted.__class__ == numpy.ndarray):
+                formatted = formatted.tolist()
+            
+            # TODO: check the size of the input
+            
+            learner_id = LPBoostMulticlassClassifier_wrap.add_multiclass_classifier(self, formatted)
         
-        # TODO: check the size of the input
+        if validation_response is not None:
+            if is_sparse(validation_response):
+                validation_response = validation_response.toarray()
+            if(validation_response.__class__ == numpy.ndarray):
+                validation_response = validation_response.tolist()
+            self.add_validation_response(learner_id, validation_response)
         
-        LPBoostMulticlassClassifier_wrap.add_multiclass_classifier(self, formatted)
+        return learner_id
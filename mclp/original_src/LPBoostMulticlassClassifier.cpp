@@ -4,10 +4,19 @@
  */
 
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
 #include <algorithm>
+#include <limits>
+#include <ctime>
 
 #include <assert.h>
 #include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
 
 #ifdef HAS_MOSEK
 #include <mosek.h>
@@ -15,8 +24,20 @@
 
 #include <CoinPackedMatrix.hpp>
 #include <CoinPackedVector.hpp>
+#include <CoinShallowPackedVector.hpp>
+#include <CoinWarmStartBasis.hpp>
 #include <OsiSolverParameters.hpp>
 #include <OsiClpSolverInterface.hpp>
+#include <ClpInterior.hpp>
+#include <ClpCholeskyBase.hpp>
+#include <ClpCholeskyDense.hpp>
+#include <ClpEventHandler.hpp>
+#ifdef HAS_CLP_CHOLMOD
+#include <ClpCholeskyUfl.hpp>
+#endif
+#ifdef HAS_CLP_MUMPS
+#include <ClpCholeskyMumps.hpp>
+#endif
 
 #ifdef HAS_MOSEK
 #include <OsiMskSolverInterface.hpp>
@@ -24,37 +45,277 @@
 
 //#include <OsiCpxSolverInterface.hpp>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#ifdef HAS_OPENBLAS
+extern "C" void openblas_set_num_threads(int num_threads);
+#endif
+
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
 #include "LPBoostMulticlassClassifier.h"
 
 namespace Boosting {
 
+// Dense (N,K) weak learner responses as read by AddDenseColumns: the
+// nested vectors of the original interface, or caller memory addressed by
+// element strides.
+class NestedResponse {
+public:
+	explicit NestedResponse(const std::vector<std::vector<double> >& response)
+		: response(response) {
+	}
+	double operator()(unsigned int n, int cl) const {
+		return (response[n][cl]);
+	}
+private:
+	const std::vector<std::vector<double> >& response;
+};
+
+template <typename T>
+class StridedResponse {
+public:
+	StridedResponse(const T* base, ptrdiff_t sample_stride,
+		ptrdiff_t class_stride)
+		: base(base), sample_stride(sample_stride),
+		class_stride(class_stride) {
+	}
+	double operator()(unsigned int n, int cl) const {
+		return (static_cast<double>(base[static_cast<ptrdiff_t>(n)
+			* sample_stride + cl * class_stride]));
+	}
+private:
+	const T* base;
+	ptrdiff_t sample_stride;
+	ptrdiff_t class_stride;
+};
+
+// File format of the solution cache entries
+static const char cache_magic[8] = { 'M', 'C', 'L', 'P', 'C', '2', 0, 0 };
+
+// FNV-1a hash of size bytes at data, continuing from hash.  A different
+// prime gives a second hash of the same data.
+static uint64_t HashBytes(uint64_t hash, const void* data, size_t size,
+	uint64_t prime = 1099511628211ull) {
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for (size_t bi = 0; bi < size; ++bi) {
+		hash ^= bytes[bi];
+		hash *= prime;
+	}
+	return (hash);
+}
+
+// Offset and prime of the second hash of the cache key chain
+static const uint64_t check_offset = 0x6c62272e07bb0142ull;
+static const uint64_t check_prime = 0x9e3779b97f4a7c15ull;
+
+// Scaling mode of a new ClpModel
+static const int clp_default_scaling = 3;
+
+// Idle Clp solvers of destroyed classifiers, see SetSolverPoolSize.
+class SolverPool {
+public:
+	SolverPool() : max_idle(0) {
+	}
+	boost::mutex mutex;
+	unsigned int max_idle;
+	std::vector<OsiSolverInterface*> idle;
+};
+
+// The pool is never destroyed, classifiers of static storage duration may
+// still return their solvers to it at exit.
+static SolverPool& SharedSolverPool() {
+	static SolverPool* pool = new SolverPool;
+	return (*pool);
+}
+
 LPBoostMulticlassClassifier::LPBoostMulticlassClassifier(
 	int number_classes, double nu, bool weight_sharing)
 	: initialized(false), number_classes(number_classes), nu(nu),
-		weight_sharing(weight_sharing), number_classifiers(0),
-		rho(0), gamma(0), use_interior_point(false) {
+		weight_sharing(weight_sharing), single_group(false),
+		number_classifiers(0),
+		rho(0), gamma(0), si(NULL), use_interior_point(false),
+		formulation(PrimalFormulation), entropy_epsilon(0.01),
+		matrix_elements(0),
+		warm_start_pending(false),
+		redundancy_check(false), redundancy_epsilon(0.0),
+		redundancy_dominated(false),
+		response_normalization(NoNormalization), lp_scaling(-1),
+		cache_max_bytes(0), cache_bytes(0), cache_scanned(false),
+		lp_has_basis(false),
+		barrier_max_dense_columns(300), solver_race(false),
+		race_decisive_wins(0), race_barrier_leads(false), race_streak(0),
+		sample_screening(false), screening_threshold(0.1),
+		coarse_levels(0), coarse_fraction(0.1),
+		validation_threads(1) {
 	assert(nu > 0.0);
 	assert(nu <= 1.0);
+	stats.classifiers_added = 0;
+	stats.classifiers_duplicate = 0;
+	stats.classifiers_dominated = 0;
+	stats.barrier_dense_columns = 0;
+	stats.solver_iterations = 0;
+	stats.cache_hits = 0;
+	stats.cache_warm_starts = 0;
+	stats.scratch_allocations = 0;
+	stats.race_simplex_wins = 0;
+	stats.race_barrier_wins = 0;
+	stats.race_skipped = 0;
+	stats.samples_screened = 0;
+	stats.samples_reinserted = 0;
+	stats.relaxed_row_fraction = 0.0;
+	stats.coarse_iterations = 0;
+	stats.barrier_threads_ignored = false;
+	validation.accuracy = 0.0;
+	validation.learners_changed = 0;
+	validation.seconds = 0.0;
 }
 
 LPBoostMulticlassClassifier::~LPBoostMulticlassClassifier() {
-	if (si != NULL)
-		delete si;
+	ReleaseSolver();
+}
+
+void LPBoostMulticlassClassifier::SetSolverPoolSize(unsigned int max_idle) {
+	SolverPool& pool = SharedSolverPool();
+	boost::mutex::scoped_lock lock(pool.mutex);
+	pool.max_idle = max_idle;
+	while (pool.idle.size() > max_idle) {
+		delete pool.idle.back();
+		pool.idle.pop_back();
+	}
+}
+
+void LPBoostMulticlassClassifier::ReleaseSolver() {
+	if (si == NULL)
+		return;
+
+	// Only Clp solvers are pooled, Mosek sets its options on creation.
+	// The problem stays loaded until InitializeBoosting replaces it.
+	if (solver_name == "clp") {
+		SolverPool& pool = SharedSolverPool();
+		boost::mutex::scoped_lock lock(pool.mutex);
+		if (pool.idle.size() < pool.max_idle) {
+			pool.idle.push_back(si);
+			si = NULL;
+			return;
+		}
+	}
+	delete si;
+	si = NULL;
+}
+
+LPBoostMulticlassClassifier::ScratchArena::ScratchArena()
+	: block(0), used(0), allocations(0) {
+}
+
+void LPBoostMulticlassClassifier::ScratchArena::Reserve(size_t bytes) {
+	size_t words = (bytes + sizeof(double) - 1) / sizeof(double);
+	Reset();
+	if (blocks.empty() || blocks[0].size() < words) {
+		blocks.clear();
+		blocks.push_back(std::vector<double>(words));
+	}
+}
+
+void LPBoostMulticlassClassifier::ScratchArena::Reset() {
+	// Merge the blocks of the last call, the next one fits into one.
+	if (blocks.size() > 1) {
+		size_t words = 0;
+		for (unsigned int bi = 0; bi < blocks.size(); ++bi)
+			words += blocks[bi].size();
+		blocks.clear();
+		blocks.push_back(std::vector<double>(words));
+		allocations += 1;
+	}
+	block = 0;
+	used = 0;
+}
+
+template <typename T>
+T* LPBoostMulticlassClassifier::ScratchArena::Allocate(size_t count) {
+	// In units of double, aligning all element types used.
+	size_t words = (count * sizeof(T) + sizeof(double) - 1) / sizeof(double);
+	while (block < blocks.size() && used + words > blocks[block].size()) {
+		block += 1;
+		used = 0;
+	}
+	if (block == blocks.size()) {
+		size_t size = words;
+		if (blocks.empty() == false)
+			size = std::max(words, 2 * blocks.back().size());
+		blocks.push_back(std::vector<double>(std::max<size_t>(size, 1)));
+		allocations += 1;
+	}
+	T* memory = reinterpret_cast<T*>(&blocks[block][used]);
+	used += words;
+	return (memory);
+}
+
+unsigned int LPBoostMulticlassClassifier::ScratchArena::TakeAllocations() {
+	unsigned int taken = allocations;
+	allocations = 0;
+	return (taken);
 }
 
 void LPBoostMulticlassClassifier::InitializeBoosting(
 	const std::vector<int>& labels, bool interior_point,
-	const std::string& solver) {
+	const std::string& solver, Formulation formulation) {
 	assert(*std::min_element(labels.begin(), labels.end()) >= 0);
 	assert(*std::max_element(labels.begin(), labels.end()) < number_classes);
 	sample_labels = labels;
+	this->formulation = formulation;
+
+	// The LP row and column indices are int, the element indices are
+	// CoinBigIndex.  Refuse problems which do not fit rather than silently
+	// wrapping around.
+	if (weight_sharing)
+		norm1_rows = 1;
+	else if (class_groups.empty())
+		norm1_rows = number_classes;
+	else
+		norm1_rows = *std::max_element(class_groups.begin(),
+			class_groups.end()) + 1;
+	uint64_t number_rows = norm1_rows
+		+ static_cast<uint64_t>(sample_labels.size()) * (number_classes - 1);
+	if (number_rows > static_cast<uint64_t>(std::numeric_limits<int>::max())) {
+		std::cerr << "Problem too large: " << number_rows << " constraint "
+			<< "rows exceed the LP solver's row index range." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	matrix_elements = MatrixElements(sample_labels.size(), number_classes,
+		0, weight_sharing);
+	if (matrix_elements > MaximumMatrixElements()) {
+		std::cerr << "Problem too large: " << matrix_elements
+			<< " constraint matrix elements exceed the LP solver's limit of "
+			<< MaximumMatrixElements() << "." << std::endl;
+		exit(EXIT_FAILURE);
+	}
 
-	// Initialize LP solver
+	// Initialize LP solver, reusing the Clp solver of the last problem
+	if (si != NULL && (solver_name != "clp" || solver != "clp"))
+		ReleaseSolver();
+	solver_name = solver;
 	if (solver == "cplex") {
 //		si = new OsiCpxSolverInterface;
 		assert(0);
 	} else if (solver == "clp") {
-		si = new OsiClpSolverInterface;
+		// A reused solver keeps its ClpSimplex, assignProblem below loads
+		// the new problem into it and drops the old basis.
+		SolverPool& pool = SharedSolverPool();
+		boost::mutex::scoped_lock lock(pool.mutex);
+		if (si != NULL) {
+			// the solver of the last problem
+		} else if (pool.idle.empty()) {
+			si = new OsiClpSolverInterface;
+		} else {
+			si = pool.idle.back();
+			pool.idle.pop_back();
+		}
 	} else if (solver == "mosek") {
 	#ifdef  HAS_MOSEK
 		OsiMskSolverInterface* mosek_si = new OsiMskSolverInterface;
@@ -89,8 +350,6 @@ void LPBoostMulticlassClassifier::InitializeBoosting(
 	 * matrix has column ordering, appending columns will be cheaper than
 	 * appending rows.
 	 */
-	CoinPackedMatrix* matrix = new CoinPackedMatrix(true, 0, 0);
-	matrix->setDimensions(0, 1 + sample_labels.size());
 
 	// rho unconstrained, xi >= 0 constraints
 	double* varLB = new double[1 + sample_labels.size()];
@@ -113,39 +372,15 @@ void LPBoostMulticlassClassifier::InitializeBoosting(
 	// Constraint structure, if weight sharing is used:
 	//      \sum_i \alpha_i = 1.
 	// If no weight sharing is used:
-	//      \sum_i A_{j,i} = 1,   for all j = 1, ..., K.
-	norm1_rows = 0;
-	if (weight_sharing) {
-		CoinPackedVector alpha_sum;
-		matrix->appendRow(alpha_sum);
-		norm1_rows = 1;
-	} else {
-		CoinPackedVector alpha_sum;
-		for (int cl = 0; cl < number_classes; ++cl)
-			matrix->appendRow(alpha_sum);
-		norm1_rows = number_classes;
-	}
-
-	// Add empty rows.  We need N (K-1) rows for the major constraint system.
-	// We use a row-ordered temporary matrix and reserve the correct amount of
-	// space so we can skip any reallocations.
-	CoinPackedMatrix margin_matrix(false, 0, 0);
-	margin_matrix.setDimensions(0, 1 + sample_labels.size());
-	margin_matrix.reserve(sample_labels.size() * (number_classes - 1),
-		2 * (sample_labels.size() * number_classes), false);
-	for (unsigned int n = 0; n < sample_labels.size(); ++n) {
-		CoinPackedVector margin_constraint;
-		margin_constraint.insert(0, -1.0);	// - rho
-		margin_constraint.insert(1 + n, 1.0);	// + xi_n
-		for (int y = 0; y < number_classes; ++y) {
-			if (y == sample_labels[n])
-				continue;
-			margin_matrix.appendRow(margin_constraint);
-		}
-	}
-	matrix->bottomAppendPackedMatrix(margin_matrix);
+	//      \sum_i A_{j,i} = 1,   for all j = 1, ..., K,
+	// with class groups for all j = 1, ..., G.
+	// These rows are empty until weak learners are added.  Below them are
+	// the N (K-1) margin rows
+	//      -\rho + \xi_n + (weak learner terms) >= 0.
+	unsigned int margin_rows = static_cast<unsigned int>(number_rows)
+		- norm1_rows;
+	CoinPackedMatrix* matrix = BuildInitialMatrix(margin_rows);
 
-	unsigned int margin_rows = sample_labels.size() * (number_classes - 1);
 	double* rowLB = new double[norm1_rows + margin_rows];
 	double* rowUB = new double[norm1_rows + margin_rows];
 	for (unsigned int n = 0; n < norm1_rows; ++n)
@@ -155,159 +390,2875 @@ void LPBoostMulticlassClassifier::InitializeBoosting(
 		rowUB[norm1_rows + n] = si->getInfinity();
 	}
 
-	// Set constraint matrix
-	si->assignProblem(matrix, varLB, varUB, objective, rowLB, rowUB);
+	if (formulation == DualFormulation) {
+		// The dual LP over the multipliers [beta_1, ..., beta_B, u] of the
+		// primal rows, with the transposed constraint matrix:
+		//   min -\sum_b beta_b
+		//   s.t.  -\sum_r u_r = -1              (rho)
+		//         \sum_{r of sample n} u_r <= D  (xi_n)
+		//         \sum_r a_{r,j} u_r + beta_b <= 0, added per weak learner
+		//   u >= 0, beta free.
+		// Its optimal value is gamma, the row prices are minus the primal
+		// variables.  BuildInitialMatrix already built the transpose.
+		double* dualLB = new double[norm1_rows + margin_rows];
+		double* dualUB = new double[norm1_rows + margin_rows];
+		double* dual_objective = new double[norm1_rows + margin_rows];
+		for (unsigned int r = 0; r < norm1_rows + margin_rows; ++r) {
+			bool norm1 = (r < norm1_rows);
+			dualLB[r] = norm1 ? -si->getInfinity() : 0.0;
+			dualUB[r] = si->getInfinity();
+			dual_objective[r] = norm1 ? -1.0 : 0.0;
+		}
+		double* dual_rowLB = new double[1 + sample_labels.size()];
+		double* dual_rowUB = new double[1 + sample_labels.size()];
+		dual_rowLB[0] = dual_rowUB[0] = -1.0;
+		for (unsigned int n = 0; n < sample_labels.size(); ++n) {
+			dual_rowLB[1 + n] = -si->getInfinity();
+			dual_rowUB[1 + n] = slack_penalty;
+		}
+		delete[] varLB;
+		delete[] varUB;
+		delete[] objective;
+		delete[] rowLB;
+		delete[] rowUB;
+		si->assignProblem(matrix, dualLB, dualUB, dual_objective,
+			dual_rowLB, dual_rowUB);
+	} else {
+		// Set constraint matrix
+		si->assignProblem(matrix, varLB, varUB, objective, rowLB, rowUB);
+	}
 	si->setObjSense(1);	// minimize \gamma
 
-	// Use interior-point
-	if (solver == "clp" && interior_point) {
-		std::cout << "Using barrier solver" << std::endl;
+	// Use interior-point, Update() solves it with SolveBarrier, these are
+	// the options of any other initialSolve().  Set for every problem, a
+	// reused Clp solver has those of its last one.
+	if (solver == "clp") {
 		ClpSolve lp_options;
-		// Don't do crossover to a feasible basis.
-		lp_options.setSolveType(ClpSolve::useBarrierNoCross);
-		//lp_options.setPresolveType(ClpSolve::presolveOn);
-		lp_options.setPresolveType(ClpSolve::presolveOff);
-		lp_options.setSpecialOption(6, 1);
-		dynamic_cast<OsiClpSolverInterface*>(si)->setSolveOptions(lp_options);
+		if (interior_point) {
+			std::cout << "Using barrier solver" << std::endl;
+			// Don't do crossover to a feasible basis.
+			lp_options.setSolveType(ClpSolve::useBarrierNoCross);
+			//lp_options.setPresolveType(ClpSolve::presolveOn);
+			lp_options.setPresolveType(ClpSolve::presolveOff);
+			lp_options.setSpecialOption(6, 1);
+			// No SIGINT handler, it is process-global and not safe with
+			// several classifiers solving in different threads.
+			lp_options.setSpecialOption(2, 1);
+		}
+		OsiClpSolverInterface* clp_si =
+			dynamic_cast<OsiClpSolverInterface*>(si);
+		clp_si->setSolveOptions(lp_options);
+		clp_si->getModelPtr()->scaling(lp_scaling >= 0 ? lp_scaling :
+			clp_default_scaling);
 	}
 	use_interior_point = interior_point;
+	warm_start_pending = false;
+
+	xi_columns.resize(sample_labels.size());
+	for (unsigned int n = 0; n < sample_labels.size(); ++n)
+		xi_columns[n] = 1 + n;
+	number_classifiers = 0;
+	rho = 0;
+	gamma = 0;
+	alpha_columns.clear();
+	response_scales.clear();
+	classifier_weights.clear();
+	expanded_weights.clear();
+	margin_distribution.clear();
+
+	redundancy_scratch.assign(norm1_rows + margin_rows, 0.0);
+	column_hashes.clear();
+	class_samples.assign(number_classes, 0);
+	for (unsigned int n = 0; n < sample_labels.size(); ++n)
+		class_samples[sample_labels[n]] += 1;
+	ReserveScratch();
+
+	// The cache key chain starts from the labels.
+	cache_chain.assign(1, HashBytes(14695981039346656037ull,
+		&sample_labels[0], sample_labels.size() * sizeof(int)));
+	cache_check_chain.assign(1, HashBytes(check_offset, &sample_labels[0],
+		sample_labels.size() * sizeof(int), check_prime));
+	lp_has_basis = false;
+	race_barrier_leads = false;
+	race_streak = 0;
+	sample_screened.assign(sample_labels.size(), false);
+	stats.samples_screened = 0;
+	stats.relaxed_row_fraction = 0.0;
+
+	// Weak learner ids start over, keep only the validation labels.
+	if (validation_labels.empty() == false)
+		SetValidationSet(validation_labels, validation_threads);
 
 	initialized = true;
 }
 
-void LPBoostMulticlassClassifier::AddMulticlassClassifier(
+void LPBoostMulticlassClassifier::Reset(int number_classes, double nu,
+	bool weight_sharing, const std::vector<int>& labels,
+	bool interior_point, const std::string& solver,
+	Formulation formulation) {
+	assert(nu > 0.0);
+	assert(nu <= 1.0);
+	this->number_classes = number_classes;
+	this->nu = nu;
+	this->weight_sharing = weight_sharing;
+	class_groups.clear();
+	single_group = false;
+	initialized = false;
+
+	stats.classifiers_added = 0;
+	stats.classifiers_duplicate = 0;
+	stats.classifiers_dominated = 0;
+	stats.barrier_dense_columns = 0;
+	stats.solver_iterations = 0;
+	stats.cache_hits = 0;
+	stats.cache_warm_starts = 0;
+	stats.scratch_allocations = 0;
+	stats.race_simplex_wins = 0;
+	stats.race_barrier_wins = 0;
+	stats.race_skipped = 0;
+	stats.samples_screened = 0;
+	stats.samples_reinserted = 0;
+	stats.relaxed_row_fraction = 0.0;
+	stats.coarse_iterations = 0;
+
+	validation_labels.clear();
+	validation_responses.clear();
+	validation_registered.clear();
+	validation_weights.clear();
+	validation_scores.clear();
+	validation.accuracy = 0.0;
+	validation.margins.clear();
+	validation.learners_changed = 0;
+	validation.seconds = 0.0;
+
+	// The arena, scratch columns and solver keep their memory.
+	InitializeBoosting(labels, interior_point, solver, formulation);
+}
+
+unsigned int LPBoostMulticlassClassifier::AddMulticlassClassifier(
 	const std::vector<std::vector<double> >& response) {
 	assert(initialized);
 	assert(response.size() == sample_labels.size());
 	assert(response[0].size() == static_cast<unsigned int>(number_classes));
 
-	if (weight_sharing) {
-		// Add one alpha, hence one column.
-		// There are (norm1_rows + N*(K-1)) rows.
-		CoinPackedVector col;
+	return (AddDenseColumns(NestedResponse(response)));
+}
 
-		// First, the one-norm constraint
-		col.insert(0, 1.0);
+template <typename T>
+unsigned int LPBoostMulticlassClassifier::AddMulticlassClassifier(
+	const T* response, ptrdiff_t sample_stride, ptrdiff_t class_stride) {
+	assert(initialized);
+	assert(response != NULL);
 
-		// Second, the margin constraints
-		unsigned int idx = norm1_rows;
-		for (unsigned int n = 0; n < sample_labels.size(); ++n) {
-			for (int cl = 0; cl < number_classes; ++cl) {
-				if (cl == sample_labels[n])
+	return (AddDenseColumns(StridedResponse<T>(response, sample_stride,
+		class_stride)));
+}
+
+template unsigned int LPBoostMulticlassClassifier::AddMulticlassClassifier(
+	const float* response, ptrdiff_t sample_stride, ptrdiff_t class_stride);
+template unsigned int LPBoostMulticlassClassifier::AddMulticlassClassifier(
+	const double* response, ptrdiff_t sample_stride, ptrdiff_t class_stride);
+
+template <typename Response>
+unsigned int LPBoostMulticlassClassifier::AddDenseColumns(
+	const Response& response) {
+	// Only the non-zero margin coefficients are stored, the constraint
+	// matrix is sparse for abstaining and one-hot weak learners.
+	int** indices;
+	double** values;
+	int* counts;
+	BeginScratchColumns(indices, values, counts);
+
+	// Kernels for common class counts, with the loops over the classes of
+	// constant trip count.
+	switch (number_classes) {
+	case 2:
+		MarginColumns<2>(response, indices, values, counts);
+		break;
+	case 3:
+		MarginColumns<3>(response, indices, values, counts);
+		break;
+	case 4:
+		MarginColumns<4>(response, indices, values, counts);
+		break;
+	case 5:
+		MarginColumns<5>(response, indices, values, counts);
+		break;
+	case 6:
+		MarginColumns<6>(response, indices, values, counts);
+		break;
+	case 8:
+		MarginColumns<8>(response, indices, values, counts);
+		break;
+	case 10:
+		MarginColumns<10>(response, indices, values, counts);
+		break;
+	case 16:
+		MarginColumns<16>(response, indices, values, counts);
+		break;
+	case 20:
+		MarginColumns<20>(response, indices, values, counts);
+		break;
+	case 32:
+		MarginColumns<32>(response, indices, values, counts);
+		break;
+	default:
+		MarginColumns<0>(response, indices, values, counts);
+		break;
+	}
+
+	return (AddScratchColumns(indices, values, counts));
+}
+
+template <int Classes, typename Response>
+void LPBoostMulticlassClassifier::MarginColumns(const Response& response,
+	int* const* indices, double* const* values, int* counts) {
+	// Classes is the number of classes if fixed at compile time, 0 else.
+	// Each coefficient is written, but only counted when non-zero, which
+	// needs room for one more element in each column.
+	const int K = (Classes > 0) ? Classes : number_classes;
+	double fixed_resp[Classes > 0 ? Classes : 1];
+	double* resp = (Classes > 0) ? fixed_resp
+		: scratch_arena.Allocate<double>(K);
+
+	int row = norm1_rows;	// first margin row of sample n
+	for (unsigned int n = 0; n < sample_labels.size(); ++n) {
+		int y = sample_labels[n];
+		for (int cl = 0; cl < K; ++cl)
+			resp[cl] = response(n, cl);
+		double resp_y = resp[y];
+
+		// The K-1 margin rows of the sample skip class y
+		if (weight_sharing) {
+			// H_{y_n,.}(x_n)' \alpha - H_{cl,.}(x_n)' \alpha
+			//    - \rho + \xi_n >= 0
+			for (int cl = 0; cl < K; ++cl)
+				resp[cl] = resp_y - resp[cl];
+			int* col_indices = indices[0];
+			double* col_values = values[0];
+			int count = counts[0];
+			for (int cl = 0; cl < y; ++cl) {
+				col_indices[count] = row + cl;
+				col_values[count] = resp[cl];
+				count += (resp[cl] != 0.0);
+			}
+			for (int cl = y + 1; cl < K; ++cl) {
+				col_indices[count] = row + cl - 1;
+				col_values[count] = resp[cl];
+				count += (resp[cl] != 0.0);
+			}
+			counts[0] = count;
+		} else if (class_groups.empty() == false) {
+			// H_{y_n,.}(x_n)' A_{.,g(y_n)} - H_{cl,.}(x_n)' A_{.,g(cl)}
+			//     - \rho + \xi_n >= 0, one column if g(y_n) = g(cl)
+			int gy = class_groups[y];
+			for (int cl = 0; cl < K; ++cl) {
+				if (cl == y)
 					continue;
+				int margin_row = row + (cl < y ? cl : cl - 1);
+				int gc = class_groups[cl];
+				indices[gy][counts[gy]] = margin_row;
+				if (gc == gy) {
+					values[gy][counts[gy]] = resp_y - resp[cl];
+					counts[gy] += (resp_y != resp[cl]);
+				} else {
+					values[gy][counts[gy]] = resp_y;
+					counts[gy] += (resp_y != 0.0);
+					indices[gc][counts[gc]] = margin_row;
+					values[gc][counts[gc]] = -resp[cl];
+					counts[gc] += (resp[cl] != 0.0);
+				}
+			}
+		} else {
+			// H_{y_n,.}(x_n)' A_{.,y_n} - H_{cl,.}(x_n)' A_{.,cl}
+			//     - \rho + \xi_n >= 0
+			if (resp_y != 0.0) {
+				int* col_indices = indices[y] + counts[y];
+				double* col_values = values[y] + counts[y];
+				for (int ri = 0; ri < K - 1; ++ri) {
+					col_indices[ri] = row + ri;
+					col_values[ri] = resp_y;
+				}
+				counts[y] += K - 1;
+			}
+			for (int cl = 0; cl < y; ++cl) {
+				indices[cl][counts[cl]] = row + cl;
+				values[cl][counts[cl]] = -resp[cl];
+				counts[cl] += (resp[cl] != 0.0);
+			}
+			for (int cl = y + 1; cl < K; ++cl) {
+				indices[cl][counts[cl]] = row + cl - 1;
+				values[cl][counts[cl]] = -resp[cl];
+				counts[cl] += (resp[cl] != 0.0);
+			}
+		}
+		row += K - 1;
+	}
+}
+
+unsigned int LPBoostMulticlassClassifier::AddMulticlassClassifierSparse(
+	const std::vector<unsigned int>& sample_start,
+	const std::vector<int>& classes, const std::vector<double>& values) {
+	assert(initialized);
+	assert(sample_start.size() == sample_labels.size() + 1);
+	assert(classes.size() == values.size());
+	assert(sample_start[sample_labels.size()] == classes.size());
 
-				// H_{y_n,.}(x_n)' \alpha - H_{cl,.}(x_n)' \alpha
-				//    - \rho + \xi_n >= 0
-				col.insert(idx, response[n][sample_labels[n]]
-					- response[n][cl]);
-				idx += 1;
+	// A class listed twice for a sample would enter its margin rows twice
+	// and overrun the columns, its values are summed instead.
+	scratch_arena.Reset();
+	int* class_entry = scratch_arena.Allocate<int>(number_classes);
+	std::fill(class_entry, class_entry + number_classes, -1);
+	bool duplicates = false;
+	for (unsigned int n = 0; n < sample_labels.size(); ++n) {
+		for (unsigned int ei = sample_start[n]; ei < sample_start[n + 1]; ++ei) {
+			assert(classes[ei] >= 0 && classes[ei] < number_classes);
+			if (class_entry[classes[ei]] >= static_cast<int>(sample_start[n]))
+				duplicates = true;
+			class_entry[classes[ei]] = ei;
+		}
+	}
+	if (duplicates) {
+		std::vector<unsigned int> merged_start(1, 0);
+		std::vector<int> merged_classes;
+		std::vector<double> merged_values;
+		std::fill(class_entry, class_entry + number_classes, -1);
+		for (unsigned int n = 0; n < sample_labels.size(); ++n) {
+			for (unsigned int ei = sample_start[n];
+				ei < sample_start[n + 1]; ++ei) {
+				int cl = classes[ei];
+				if (class_entry[cl] >= static_cast<int>(merged_start[n])) {
+					merged_values[class_entry[cl]] += values[ei];
+				} else {
+					class_entry[cl] = merged_classes.size();
+					merged_classes.push_back(cl);
+					merged_values.push_back(values[ei]);
+				}
 			}
+			merged_start.push_back(merged_classes.size());
 		}
-		si->addCol(col, 0.0, si->getInfinity(), 0.0);
-	} else {
-		/* [rho, xi, A_{1,1}, ..., A_{1,K},
-		 *  A_{2,1}, ..., A_{2,K}, A_{M,1}, ..., A_{M,K}]
-		 * where A_{j,i} is the i'th class weight for the j'th weak learner.
-		 */
-		CoinPackedVector cols[number_classes];
+		return (AddMulticlassClassifierSparse(merged_start, merged_classes,
+			merged_values));
+	}
 
-		// One-norm constraints
-		for (int cl = 0; cl < number_classes; ++cl)
-			cols[cl].insert(cl, 1.0);	// ... + A_{M,cl} = 1.
+	int** indices;
+	double** column_values;
+	int* counts;
+	BeginScratchColumns(indices, column_values, counts);
+
+	// Dense response of the current sample, only the entries listed in
+	// classes are non-zero and they are reset after each sample.
+	double* resp = scratch_arena.Allocate<double>(number_classes);
+	std::fill(resp, resp + number_classes, 0.0);
+
+	if (weight_sharing) {
+		int* col_indices = indices[0];
+		double* col_values = column_values[0];
+		for (unsigned int n = 0; n < sample_labels.size(); ++n) {
+			int y = sample_labels[n];
+			for (unsigned int ei = sample_start[n];
+				ei < sample_start[n + 1]; ++ei) {
+				assert(classes[ei] >= 0 && classes[ei] < number_classes);
+				resp[classes[ei]] = values[ei];
+			}
+
+			// If the true class response is zero, only the listed classes
+			// have a non-zero margin coefficient, otherwise all K-1 rows of
+			// the sample might.
+			if (resp[y] != 0.0) {
+				for (int cl = 0; cl < number_classes; ++cl) {
+					if (cl != y && resp[y] != resp[cl]) {
+						col_indices[counts[0]] = MarginRow(n, cl);
+						col_values[counts[0]++] = resp[y] - resp[cl];
+					}
+				}
+			} else {
+				for (unsigned int ei = sample_start[n];
+					ei < sample_start[n + 1]; ++ei) {
+					if (classes[ei] != y && values[ei] != 0.0) {
+						col_indices[counts[0]] = MarginRow(n, classes[ei]);
+						col_values[counts[0]++] = -values[ei];
+					}
+				}
+			}
 
-		// Margin constraints
-		unsigned int idx = norm1_rows;
+			for (unsigned int ei = sample_start[n];
+				ei < sample_start[n + 1]; ++ei)
+				resp[classes[ei]] = 0.0;
+		}
+	} else if (class_groups.empty() == false) {
 		for (unsigned int n = 0; n < sample_labels.size(); ++n) {
+			int y = sample_labels[n];
+			for (unsigned int ei = sample_start[n];
+				ei < sample_start[n + 1]; ++ei) {
+				assert(classes[ei] >= 0 && classes[ei] < number_classes);
+				resp[classes[ei]] = values[ei];
+			}
+
+			// A_{.,g(y_n)} enters every margin row of the sample unless the
+			// true class response is zero, A_{.,g(cl)} of another group only
+			// the row of cl.
+			int gy = class_groups[y];
 			for (int cl = 0; cl < number_classes; ++cl) {
-				if (cl == sample_labels[n])
+				if (cl == y)
 					continue;
+				int gc = class_groups[cl];
+				if (gc == gy && resp[y] != resp[cl]) {
+					indices[gy][counts[gy]] = MarginRow(n, cl);
+					column_values[gy][counts[gy]++] = resp[y] - resp[cl];
+				} else if (gc != gy) {
+					if (resp[y] != 0.0) {
+						indices[gy][counts[gy]] = MarginRow(n, cl);
+						column_values[gy][counts[gy]++] = resp[y];
+					}
+					if (resp[cl] != 0.0) {
+						indices[gc][counts[gc]] = MarginRow(n, cl);
+						column_values[gc][counts[gc]++] = -resp[cl];
+					}
+				}
+			}
 
-				// H_{y_n,.}(x_n)' A_{.,y_n} - H_{cl,.}(x_n)' A_{.,cl}
-				//     - \rho + \xi_n >= 0
-				cols[sample_labels[n]].insert(idx, response[n][sample_labels[n]]);
-				cols[cl].insert(idx, -response[n][cl]);
-				idx += 1;
+			for (unsigned int ei = sample_start[n];
+				ei < sample_start[n + 1]; ++ei)
+				resp[classes[ei]] = 0.0;
+		}
+	} else {
+		for (unsigned int n = 0; n < sample_labels.size(); ++n) {
+			int y = sample_labels[n];
+			double resp_y = 0.0;
+			for (unsigned int ei = sample_start[n];
+				ei < sample_start[n + 1]; ++ei) {
+				assert(classes[ei] >= 0 && classes[ei] < number_classes);
+				if (classes[ei] == y)
+					resp_y = values[ei];
+			}
+
+			// A_{.,y_n} enters every margin row of the sample, A_{.,cl} only
+			// its own row.
+			if (resp_y != 0.0) {
+				for (int cl = 0; cl < number_classes; ++cl) {
+					if (cl != y) {
+						indices[y][counts[y]] = MarginRow(n, cl);
+						column_values[y][counts[y]++] = resp_y;
+					}
+				}
+			}
+			for (unsigned int ei = sample_start[n];
+				ei < sample_start[n + 1]; ++ei) {
+				int cl = classes[ei];
+				if (cl != y && values[ei] != 0.0) {
+					indices[cl][counts[cl]] = MarginRow(n, cl);
+					column_values[cl][counts[cl]++] = -values[ei];
+				}
 			}
 		}
-		double colLB[number_classes];
-		double colUB[number_classes];
-		double col_obj[number_classes];
+	}
+	return (AddScratchColumns(indices, column_values, counts));
+}
+
+unsigned int LPBoostMulticlassClassifier::ColumnCapacity(
+	unsigned int ci) const {
+	unsigned int number_samples = sample_labels.size();
+	if (weight_sharing) {
+		// Column of alpha: one-norm row, then all N (K-1) margin rows
+		return (1 + number_samples * (number_classes - 1));
+	}
+	if (class_groups.empty() == false) {
+		// Column of A_{.,g}: one-norm row, the K-1 margin rows of each
+		// sample of the group's classes, the rows of the group's classes of
+		// every other sample
+		unsigned int group_samples = 0;
+		unsigned int group_classes = 0;
 		for (int cl = 0; cl < number_classes; ++cl) {
-			colLB[cl] = 0.0;	// A_{M,cl} >= 0
-			colUB[cl] = si->getInfinity();
-			col_obj[cl] = 0.0;
+			if (class_groups[cl] == static_cast<int>(ci)) {
+				group_samples += class_samples[cl];
+				group_classes += 1;
+			}
 		}
+		return (1 + group_samples * (number_classes - 1)
+			+ (number_samples - group_samples) * group_classes);
+	}
+	// Column of A_{.,ci}: one-norm row, the K-1 margin rows of each sample
+	// of class ci and one row of every other sample
+	return (1 + number_samples + class_samples[ci] * (number_classes - 2));
+}
 
-		CoinPackedVectorBase* cols_p[number_classes];
-		for (int cl = 0; cl < number_classes; ++cl)
-			cols_p[cl] = &cols[cl];
-		si->addCols(number_classes, cols_p, colLB, colUB, col_obj);
+void LPBoostMulticlassClassifier::ReserveScratch() {
+	// Everything the adding of one weak learner needs, such that after the
+	// first learners no more allocations are made.
+	scratch_columns.resize(norm1_rows, CoinPackedVector(false));
+	size_t bytes = 0;
+	for (unsigned int ci = 0; ci < norm1_rows; ++ci) {
+		unsigned int capacity = ColumnCapacity(ci);
+		scratch_columns[ci].reserve(capacity);
+		bytes += (capacity + 1) * (sizeof(int) + sizeof(double))
+			+ 2 * sizeof(double);
 	}
-	number_classifiers += 1;
+	// Column pointers and counts, a response, the classes of a sparse one
+	// and the addCols arguments
+	bytes += norm1_rows * (2 * sizeof(void*) + sizeof(int))
+		+ 5 * number_classes * sizeof(double)
+		+ number_classes * sizeof(int) + 16 * sizeof(double);
+	scratch_arena.Reserve(bytes);
 }
 
-void LPBoostMulticlassClassifier::Update() {
-	assert(initialized);
+void LPBoostMulticlassClassifier::BeginScratchColumns(int**& indices,
+	double**& values, int*& counts) {
+	// Room for one more element than the column can hold, see
+	// MarginColumns.
+	scratch_arena.Reset();
+	indices = scratch_arena.Allocate<int*>(norm1_rows);
+	values = scratch_arena.Allocate<double*>(norm1_rows);
+	counts = scratch_arena.Allocate<int>(norm1_rows);
+	for (unsigned int ci = 0; ci < norm1_rows; ++ci) {
+		unsigned int capacity = ColumnCapacity(ci) + 1;
+		indices[ci] = scratch_arena.Allocate<int>(capacity);
+		values[ci] = scratch_arena.Allocate<double>(capacity);
+		indices[ci][0] = ci;	// ... = 1.
+		values[ci][0] = 1.0;
+		counts[ci] = 1;
+	}
+}
 
-	//si->writeMps ("toughone", "mps", si->getObjSense());
+unsigned int LPBoostMulticlassClassifier::AddScratchColumns(
+	int* const* indices, double* const* values, const int* counts) {
+	for (unsigned int ci = 0; ci < norm1_rows; ++ci) {
+		int capacity = scratch_columns[ci].capacity();
+		scratch_columns[ci].setVector(counts[ci], indices[ci], values[ci],
+			false);
+		if (scratch_columns[ci].capacity() != capacity)
+			stats.scratch_allocations += 2;	// indices and elements
+	}
+	unsigned int learner_id = AddLearnerColumns(&scratch_columns[0]);
+	stats.scratch_allocations += scratch_arena.TakeAllocations();
 
-	//si->messageHandler()->setLogLevel(0);	// no verbosity
-	if (use_interior_point)
-		si->initialSolve();	// Complete initial solve.
-	else
-		si->resolve();	// Warm-start solving (we only add constraints)
-
-	if (si->isProvenOptimal() == false) {
-		std::cerr << "Linear Program Solver failed." << std::endl;
-		std::cerr << "Problem: " << si->getNumCols() << " variables, "
-			<< si->getNumRows() << " rows." << std::endl;
-		si->writeMps("LP-CRASH", "mps", si->getObjSense());
-		std::cerr << "Written problem to file \"LP-CRASH.MPS\" for analysis."
+	return (learner_id);
+}
+
+unsigned int LPBoostMulticlassClassifier::PrimalRows() const {
+	return (formulation == DualFormulation ?
+		si->getNumCols() : si->getNumRows());
+}
+
+unsigned int LPBoostMulticlassClassifier::PrimalColumns() const {
+	return (formulation == DualFormulation ?
+		si->getNumRows() : si->getNumCols());
+}
+
+const CoinPackedMatrix*
+LPBoostMulticlassClassifier::PrimalMatrixByColumn() const {
+	return (formulation == DualFormulation ?
+		si->getMatrixByRow() : si->getMatrixByCol());
+}
+
+unsigned int LPBoostMulticlassClassifier::MarginRow(unsigned int n,
+	int cl) const {
+	// The K-1 margin rows of sample n skip its true class y_n.
+	return (norm1_rows + n * (number_classes - 1)
+		+ (cl < sample_labels[n] ? cl : cl - 1));
+}
+
+CoinPackedMatrix* LPBoostMulticlassClassifier::BuildInitialMatrix(
+	unsigned int margin_rows) const {
+	// The rho and xi parts of the margin rows: -1 for rho in every margin
+	// row, +1 for xi_n in the K-1 rows of sample n.  These are written
+	// column-major in one pass into arrays allocated once and handed over
+	// to the matrix, in the primal as the columns rho, xi_1, ..., xi_N, in
+	// the dual as the columns of the transposed matrix, two elements per
+	// margin row.
+	unsigned int number_samples = sample_labels.size();
+	unsigned int number_rows = norm1_rows + margin_rows;
+	CoinBigIndex number_elements = 2 * static_cast<CoinBigIndex>(margin_rows);
+	double* elements = new double[number_elements];
+	int* indices = new int[number_elements];
+	CoinBigIndex* starts;
+	int* lengths;
+	int major;
+	int minor;
+	if (formulation == DualFormulation) {
+		major = number_rows;
+		minor = 1 + number_samples;
+		starts = new CoinBigIndex[major + 1];
+		lengths = new int[major];
+		for (unsigned int ri = 0; ri < norm1_rows; ++ri) {
+			starts[ri] = 0;
+			lengths[ri] = 0;
+		}
+		for (unsigned int ri = 0; ri < margin_rows; ++ri) {
+			CoinBigIndex start = 2 * static_cast<CoinBigIndex>(ri);
+			starts[norm1_rows + ri] = start;
+			lengths[norm1_rows + ri] = 2;
+			indices[start] = 0;
+			elements[start] = -1.0;	// - rho
+			indices[start + 1] = 1 + ri / (number_classes - 1);
+			elements[start + 1] = 1.0;	// + xi_n
+		}
+	} else {
+		major = 1 + number_samples;
+		minor = number_rows;
+		starts = new CoinBigIndex[major + 1];
+		lengths = new int[major];
+		starts[0] = 0;
+		lengths[0] = margin_rows;
+		for (unsigned int ri = 0; ri < margin_rows; ++ri) {
+			indices[ri] = norm1_rows + ri;
+			elements[ri] = -1.0;	// - rho
+		}
+		for (unsigned int n = 0; n < number_samples; ++n) {
+			// The margin rows of sample n follow each other
+			unsigned int first_row = norm1_rows + n * (number_classes - 1);
+			CoinBigIndex start = margin_rows + first_row - norm1_rows;
+			starts[1 + n] = start;
+			lengths[1 + n] = number_classes - 1;
+			for (int ei = 0; ei < number_classes - 1; ++ei) {
+				indices[start + ei] = first_row + ei;
+				elements[start + ei] = 1.0;	// + xi_n
+			}
+		}
+	}
+	starts[major] = number_elements;
+
+	CoinPackedMatrix* matrix = new CoinPackedMatrix();
+	matrix->assignMatrix(true, minor, major, number_elements, elements,
+		indices, starts, lengths);
+	return (matrix);
+}
+
+unsigned int LPBoostMulticlassClassifier::AddLearnerColumns(
+	CoinPackedVector* cols) {
+	stats.classifiers_added += 1;
+
+	// Normalize the margin coefficients, the norm-1 rows stay one.  Before
+	// the redundancy check, learners differing in scale only are duplicates.
+	double scale = 1.0;
+	if (response_normalization != NoNormalization) {
+		double max_abs = 0.0;
+		double sum = 0.0;
+		double sum_squares = 0.0;
+		for (unsigned int ci = 0; ci < norm1_rows; ++ci) {
+			const int* indices = cols[ci].getIndices();
+			const double* elements = cols[ci].getElements();
+			for (int ei = 0; ei < cols[ci].getNumElements(); ++ei) {
+				if (indices[ei] < static_cast<int>(norm1_rows))
+					continue;
+				max_abs = std::max(max_abs, fabs(elements[ei]));
+				sum += elements[ei];
+				sum_squares += elements[ei] * elements[ei];
+			}
+		}
+		if (response_normalization == MaxAbsNormalization) {
+			if (max_abs > 0.0)
+				scale = 1.0 / max_abs;
+		} else {
+			// Over all margin rows, the ones not stored are zero
+			double count = static_cast<double>(norm1_rows)
+				* (PrimalRows() - norm1_rows);
+			double mean = sum / count;
+			double variance = sum_squares / count - mean * mean;
+			if (variance > 0.0)
+				scale = 1.0 / sqrt(variance);
+		}
+		for (unsigned int ci = 0; ci < norm1_rows; ++ci) {
+			const int* indices = cols[ci].getIndices();
+			double* elements = cols[ci].getElements();
+			for (int ei = 0; ei < cols[ci].getNumElements(); ++ei) {
+				if (indices[ei] >= static_cast<int>(norm1_rows))
+					elements[ei] *= scale;
+			}
+		}
+	}
+
+	// Check whether the new weak learner is redundant.  Candidates for
+	// duplicates are found through the hash of the quantized column,
+	// dominating learners require a scan over all learners.
+	uint64_t hash = 0;
+	if (redundancy_check) {
+		hash = ColumnHash(cols);
+		std::pair<std::multimap<uint64_t, unsigned int>::const_iterator,
+			std::multimap<uint64_t, unsigned int>::const_iterator> range =
+			column_hashes.equal_range(hash);
+		for (std::multimap<uint64_t, unsigned int>::const_iterator
+			ci = range.first; ci != range.second; ++ci) {
+			if (ColumnsMatch(cols, ci->second, false)) {
+				stats.classifiers_duplicate += 1;
+				return (ci->second);
+			}
+		}
+		if (redundancy_dominated) {
+			for (unsigned int m = 0; m < number_classifiers; ++m) {
+				if (ColumnsMatch(cols, m, true)) {
+					stats.classifiers_dominated += 1;
+					return (m);
+				}
+			}
+		}
+	}
+
+	uint64_t col_elements = 0;
+	for (unsigned int ci = 0; ci < norm1_rows; ++ci)
+		col_elements += cols[ci].getNumElements();
+	if (matrix_elements + col_elements > MaximumMatrixElements()) {
+		std::cerr << "Problem too large: adding weak learner "
+			<< number_classifiers << " exceeds the LP solver's limit of "
+			<< MaximumMatrixElements() << " constraint matrix elements."
 			<< std::endl;
-		std::cerr << "         problem sense: "
-			<< si->getObjSense() << std::endl;
-		std::cerr << "STATUS:  numerical difficulties: "
-			<< (si->isAbandoned() ? "YES" : "no") << std::endl;
-		std::cerr << "STATUS:       primal infeasible: "
-			<< (si->isProvenPrimalInfeasible() ? "YES" : "no") << std::endl;
-		std::cerr << "STATUS:         dual infeasible: "
-			<< (si->isProvenDualInfeasible() ? "YES" : "no") << std::endl;
-		std::cerr << "STATUS: iteration limit reached: "
-			<< (si->isIterationLimitReached() ? "YES" : "no") << std::endl;
-		assert(0);
-		return;
+		exit(EXIT_FAILURE);
 	}
+	matrix_elements += col_elements;
 
-	const double* primal = si->getColSolution();
-	rho = primal[0];
-	gamma = -si->getObjValue();	// rho - D \sum_i \xi_i
-	if (weight_sharing) {
-		classifier_weights.resize(1);
-		classifier_weights[0].resize(number_classifiers);
-		std::copy(primal + 1 + sample_labels.size(),
-			primal + 1 + sample_labels.size() + number_classifiers,
-			classifier_weights[0].begin());
+	alpha_columns.push_back(PrimalColumns());
+	if (formulation == DualFormulation) {
+		// Cutting planes \sum_r a_{r,j} u_r + beta_b <= 0
+		for (unsigned int ci = 0; ci < norm1_rows; ++ci)
+			si->addRow(cols[ci], -si->getInfinity(), 0.0);
+	} else if (norm1_rows == 1) {
+		si->addCol(cols[0], 0.0, si->getInfinity(), 0.0);
 	} else {
-		// [rho, xi, A_{1,1}, ..., A_{1,K}, o o o, A_{M,1}, ..., A_{M,K}]
-		// where A_{j,i} is the i'th class weight for the j'th weak learner.
-		classifier_weights.resize(number_classes);
-		for (int cl1 = 0; cl1 < number_classes; ++cl1) {
-			classifier_weights[cl1].resize(number_classifiers);
-			for (unsigned int m = 0; m < number_classifiers; ++m) {
-				classifier_weights[cl1][m] = primal[1 + sample_labels.size()
-					+ m * number_classes + cl1];
+		double* colLB = scratch_arena.Allocate<double>(norm1_rows);
+		double* colUB = scratch_arena.Allocate<double>(norm1_rows);
+		double* col_obj = scratch_arena.Allocate<double>(norm1_rows);
+		CoinPackedVectorBase** cols_p =
+			scratch_arena.Allocate<CoinPackedVectorBase*>(norm1_rows);
+		for (unsigned int ci = 0; ci < norm1_rows; ++ci) {
+			colLB[ci] = 0.0;	// A_{M,ci} >= 0
+			colUB[ci] = si->getInfinity();
+			col_obj[ci] = 0.0;
+			cols_p[ci] = &cols[ci];
+		}
+		si->addCols(norm1_rows, cols_p, colLB, colUB, col_obj);
+	}
+
+	if (redundancy_check)
+		column_hashes.insert(std::make_pair(hash, number_classifiers));
+	response_scales.push_back(scale);
+	uint64_t chain_hash = cache_chain.back();
+	uint64_t check_hash = cache_check_chain.back();
+	for (unsigned int ci = 0; ci < norm1_rows; ++ci) {
+		int number_elements = cols[ci].getNumElements();
+		chain_hash = HashBytes(chain_hash, &number_elements, sizeof(int));
+		chain_hash = HashBytes(chain_hash, cols[ci].getIndices(),
+			number_elements * sizeof(int));
+		chain_hash = HashBytes(chain_hash, cols[ci].getElements(),
+			number_elements * sizeof(double));
+		check_hash = HashBytes(check_hash, &number_elements, sizeof(int),
+			check_prime);
+		check_hash = HashBytes(check_hash, cols[ci].getIndices(),
+			number_elements * sizeof(int), check_prime);
+		check_hash = HashBytes(check_hash, cols[ci].getElements(),
+			number_elements * sizeof(double), check_prime);
+	}
+	cache_chain.push_back(chain_hash);
+	cache_check_chain.push_back(check_hash);
+	number_classifiers += 1;
+
+	return (number_classifiers - 1);
+}
+
+uint64_t LPBoostMulticlassClassifier::ColumnHash(
+	const CoinPackedVector* cols) const {
+	// Sum of mixed (row, quantized value) hashes, independent of the order
+	// of the elements.  Coefficients quantized to zero are skipped, such
+	// that near-zero and absent elements hash alike.  Two columns within
+	// epsilon might still fall into neighbouring quantization cells, so
+	// near duplicates can be missed, but are never wrongly merged.
+	uint64_t hash = 0;
+	for (unsigned int ci = 0; ci < norm1_rows; ++ci) {
+		const int* indices = cols[ci].getIndices();
+		const double* elements = cols[ci].getElements();
+		for (int ei = 0; ei < cols[ci].getNumElements(); ++ei) {
+			uint64_t quant = 0;
+			if (redundancy_epsilon > 0.0) {
+				quant = static_cast<uint64_t>(static_cast<int64_t>(
+					floor(elements[ei] / redundancy_epsilon + 0.5)));
+			} else if (elements[ei] != 0.0) {
+				memcpy(&quant, &elements[ei], sizeof(quant));
 			}
+			if (quant == 0)
+				continue;
+
+			// splitmix64 finalizer
+			uint64_t z = (static_cast<uint64_t>(indices[ei])
+				* 0x9e3779b97f4a7c15ULL) ^ quant
+				^ (static_cast<uint64_t>(ci) << 56);
+			z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+			hash += z ^ (z >> 31);
 		}
 	}
+	return (hash);
 }
 
-void LPBoostMulticlassClassifier::WriteMPS(const std::string& mpsfile) const {
-	si->writeMps(mpsfile.c_str(), "mps", si->getObjSense());
+bool LPBoostMulticlassClassifier::ColumnsMatch(
+	const CoinPackedVector* cols, unsigned int m, bool dominated) const {
+	const CoinPackedMatrix* matrix = PrimalMatrixByColumn();
+	unsigned int col_start = AlphaColumn(m);
+
+	// Compare in the dense scratch column, the element order of the new and
+	// the stored column may differ.
+	bool match = true;
+	for (unsigned int ci = 0; match && ci < norm1_rows; ++ci) {
+		const int* indices = cols[ci].getIndices();
+		const double* elements = cols[ci].getElements();
+		for (int ei = 0; ei < cols[ci].getNumElements(); ++ei)
+			redundancy_scratch[indices[ei]] = elements[ei];
+
+		// Stored column: new <= stored (dominated) or |new - stored| <= eps
+		CoinShallowPackedVector stored = matrix->getVector(col_start + ci);
+		for (int ei = 0; match && ei < stored.getNumElements(); ++ei) {
+			double diff = redundancy_scratch[stored.getIndices()[ei]]
+				- stored.getElements()[ei];
+			match = dominated ? (diff <= redundancy_epsilon) :
+				(fabs(diff) <= redundancy_epsilon);
+			redundancy_scratch[stored.getIndices()[ei]] = 0.0;
+		}
+		// New elements not present in the stored column
+		for (int ei = 0; ei < cols[ci].getNumElements(); ++ei) {
+			double diff = redundancy_scratch[indices[ei]];
+			if (match) {
+				match = dominated ? (diff <= redundancy_epsilon) :
+					(fabs(diff) <= redundancy_epsilon);
+			}
+			redundancy_scratch[indices[ei]] = 0.0;
+		}
+	}
+	return (match);
 }
 
-const std::vector<std::vector<double> >&
-LPBoostMulticlassClassifier::ClassifierWeights() const {
-	return (classifier_weights);
+void LPBoostMulticlassClassifier::SetResponseNormalization(
+	ResponseNormalization normalization) {
+	assert(number_classifiers == 0);
+	response_normalization = normalization;
+}
+
+const std::vector<double>&
+LPBoostMulticlassClassifier::ResponseScales() const {
+	return (response_scales);
+}
+
+std::vector<std::vector<double> >
+LPBoostMulticlassClassifier::RawClassifierWeights() const {
+	std::vector<std::vector<double> > raw_weights(ClassifierWeights());
+	for (unsigned int ci = 0; ci < raw_weights.size(); ++ci) {
+		for (unsigned int m = 0; m < raw_weights[ci].size(); ++m)
+			raw_weights[ci][m] *= response_scales[m];
+	}
+	return (raw_weights);
+}
+
+void LPBoostMulticlassClassifier::SetLPScaling(int mode) {
+	assert(mode >= -1 && mode <= 3);
+	lp_scaling = mode;
+}
+
+void LPBoostMulticlassClassifier::SetRedundancyCheck(bool enable,
+	double epsilon, bool check_dominated) {
+	assert(epsilon >= 0.0);
+	assert(number_classifiers == 0);
+	redundancy_check = enable;
+	redundancy_epsilon = epsilon;
+	redundancy_dominated = check_dominated;
+}
+
+uint64_t LPBoostMulticlassClassifier::MatrixElements(
+	uint64_t number_samples, int number_classes,
+	uint64_t number_learners, bool weight_sharing) {
+	uint64_t margin_rows = number_samples * (number_classes - 1);
+
+	// rho and xi enter every margin row.  With weight sharing each dense
+	// learner has one column with all margin rows, otherwise K columns
+	// with two elements per margin row, for A_{.,y_n} and A_{.,cl}.
+	uint64_t elements = 2 * margin_rows;
+	if (weight_sharing)
+		elements += number_learners * (1 + margin_rows);
+	else
+		elements += number_learners * (number_classes + 2 * margin_rows);
+
+	return (elements);
+}
+
+uint64_t LPBoostMulticlassClassifier::MaximumMatrixElements() {
+	return (static_cast<uint64_t>(std::numeric_limits<CoinBigIndex>::max()));
+}
+
+bool LPBoostMulticlassClassifier::FitsSolver(uint64_t number_samples,
+	int number_classes, uint64_t number_learners, bool weight_sharing) {
+	// At most number_classes norm rows, as without class groups
+	uint64_t number_rows = number_samples * (number_classes - 1)
+		+ (weight_sharing ? 1 : number_classes);
+	if (number_rows > static_cast<uint64_t>(std::numeric_limits<int>::max()))
+		return (false);
+	return (MatrixElements(number_samples, number_classes, number_learners,
+		weight_sharing) <= MaximumMatrixElements());
+}
+
+bool LPBoostMulticlassClassifier::CanInitialize(
+	uint64_t number_samples) const {
+	return (FitsSolver(number_samples, number_classes, 0, weight_sharing));
+}
+
+bool LPBoostMulticlassClassifier::CanAdd(uint64_t added_samples,
+	uint64_t added_learners) const {
+	assert(initialized);
+	uint64_t number_rows = PrimalRows() + added_samples * (number_classes - 1);
+	if (number_rows > static_cast<uint64_t>(std::numeric_limits<int>::max()))
+		return (false);
+
+	// The elements stored so far, and the dense count of the added ones
+	uint64_t number_samples = sample_labels.size();
+	uint64_t added_elements = MatrixElements(number_samples + added_samples,
+		number_classes, number_classifiers + added_learners, weight_sharing)
+		- MatrixElements(number_samples, number_classes, number_classifiers,
+		weight_sharing);
+	return (matrix_elements + added_elements <= MaximumMatrixElements());
+}
+
+void LPBoostMulticlassClassifier::AddSamples(const std::vector<int>& labels,
+	const std::vector<std::vector<std::vector<double> > >& responses) {
+	assert(initialized);
+	assert(responses.size() == number_classifiers);
+	assert(*std::min_element(labels.begin(), labels.end()) >= 0);
+	assert(*std::max_element(labels.begin(), labels.end()) < number_classes);
+
+	unsigned int first_sample = sample_labels.size();
+	uint64_t number_rows = PrimalRows()
+		+ static_cast<uint64_t>(labels.size()) * (number_classes - 1);
+	if (number_rows > static_cast<uint64_t>(std::numeric_limits<int>::max())) {
+		std::cerr << "Problem too large: " << number_rows << " constraint "
+			<< "rows exceed the LP solver's row index range." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	sample_labels.insert(sample_labels.end(), labels.begin(), labels.end());
+
+	// The xi columns go after the existing alpha columns, the margin rows of
+	// the new samples after the existing rows, such that MarginRow holds.
+	CoinPackedVector empty_col;
+	for (unsigned int n = first_sample; n < sample_labels.size(); ++n) {
+		xi_columns.push_back(PrimalColumns());
+		if (formulation == DualFormulation)
+			si->addRow(empty_col, -si->getInfinity(), 0.0);
+		else
+			si->addCol(empty_col, 0.0, si->getInfinity(), 0.0);
+	}
+
+	std::vector<CoinPackedVector> margin_constraints;
+	margin_constraints.reserve(labels.size() * (number_classes - 1));
+	for (unsigned int n = first_sample; n < sample_labels.size(); ++n) {
+		int y = sample_labels[n];
+		for (int cl = 0; cl < number_classes; ++cl) {
+			if (cl == y)
+				continue;
+
+			margin_constraints.push_back(CoinPackedVector());
+			CoinPackedVector& row = margin_constraints.back();
+			row.insert(0, -1.0);	// - rho
+			row.insert(XiColumn(n), 1.0);	// + xi_n
+			for (unsigned int m = 0; m < number_classifiers; ++m) {
+				const std::vector<double>& resp =
+					responses[m][n - first_sample];
+				assert(resp.size() == static_cast<unsigned int>(number_classes));
+				double scale = response_scales[m];
+				if (weight_sharing) {
+					if (resp[y] != resp[cl]) {
+						row.insert(AlphaColumn(m),
+							scale * (resp[y] - resp[cl]));
+					}
+				} else if (class_groups.empty() == false) {
+					int gy = class_groups[y];
+					int gc = class_groups[cl];
+					if (gy == gc && resp[y] != resp[cl]) {
+						row.insert(AlphaColumn(m) + gy,
+							scale * (resp[y] - resp[cl]));
+					} else if (gy != gc) {
+						if (resp[y] != 0.0)
+							row.insert(AlphaColumn(m) + gy, scale * resp[y]);
+						if (resp[cl] != 0.0)
+							row.insert(AlphaColumn(m) + gc, -scale * resp[cl]);
+					}
+				} else {
+					if (resp[y] != 0.0)
+						row.insert(AlphaColumn(m) + y, scale * resp[y]);
+					if (resp[cl] != 0.0)
+						row.insert(AlphaColumn(m) + cl, -scale * resp[cl]);
+				}
+			}
+			matrix_elements += row.getNumElements();
+		}
+	}
+	if (matrix_elements > MaximumMatrixElements()) {
+		std::cerr << "Problem too large: adding samples exceeds the LP "
+			<< "solver's limit of " << MaximumMatrixElements()
+			<< " constraint matrix elements." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	// Problems with fewer weak learners are no longer prefixes of this one.
+	uint64_t chain_hash = HashBytes(cache_chain.back(), &labels[0],
+		labels.size() * sizeof(int));
+	uint64_t check_hash = HashBytes(cache_check_chain.back(), &labels[0],
+		labels.size() * sizeof(int), check_prime);
+	for (unsigned int ri = 0; ri < margin_constraints.size(); ++ri) {
+		const CoinPackedVector& row = margin_constraints[ri];
+		chain_hash = HashBytes(chain_hash, row.getIndices(),
+			row.getNumElements() * sizeof(int));
+		chain_hash = HashBytes(chain_hash, row.getElements(),
+			row.getNumElements() * sizeof(double));
+		check_hash = HashBytes(check_hash, row.getIndices(),
+			row.getNumElements() * sizeof(int), check_prime);
+		check_hash = HashBytes(check_hash, row.getElements(),
+			row.getNumElements() * sizeof(double), check_prime);
+	}
+	cache_chain.assign(number_classifiers + 1, 0);
+	cache_chain.back() = chain_hash;
+	cache_check_chain.assign(number_classifiers + 1, 0);
+	cache_check_chain.back() = check_hash;
+
+	std::vector<CoinPackedVectorBase*> rows_p(margin_constraints.size());
+	std::vector<double> rowLB(margin_constraints.size(), 0.0);
+	std::vector<double> rowUB(margin_constraints.size(), si->getInfinity());
+	for (unsigned int ri = 0; ri < margin_constraints.size(); ++ri)
+		rows_p[ri] = &margin_constraints[ri];
+	if (margin_constraints.empty() == false &&
+		formulation == DualFormulation) {
+		// Multipliers u >= 0 of the new margin rows
+		std::vector<double> objective(margin_constraints.size(), 0.0);
+		si->addCols(margin_constraints.size(), &rows_p[0], &rowLB[0],
+			&rowUB[0], &objective[0]);
+	} else if (margin_constraints.empty() == false) {
+		si->addRows(margin_constraints.size(), &rows_p[0], &rowLB[0],
+			&rowUB[0]);
+	}
+
+	// New slack penalty for all samples
+	SetSlackPenalty();
+	sample_screened.resize(sample_labels.size(), false);
+	stats.relaxed_row_fraction = static_cast<double>(stats.samples_screened)
+		/ sample_labels.size();
+
+	// Column buffers for the larger problem
+	for (unsigned int n = 0; n < labels.size(); ++n)
+		class_samples[labels[n]] += 1;
+	ReserveScratch();
+
+	// The stored learner columns grew, rehash them.
+	redundancy_scratch.assign(PrimalRows(), 0.0);
+	if (redundancy_check) {
+		column_hashes.clear();
+		const CoinPackedMatrix* matrix = PrimalMatrixByColumn();
+		std::vector<CoinPackedVector> cols(norm1_rows);
+		for (unsigned int m = 0; m < number_classifiers; ++m) {
+			for (unsigned int ci = 0; ci < norm1_rows; ++ci) {
+				CoinShallowPackedVector col =
+					matrix->getVector(AlphaColumn(m) + ci);
+				cols[ci].setVector(col.getNumElements(), col.getIndices(),
+					col.getElements(), false);
+			}
+			column_hashes.insert(std::make_pair(ColumnHash(&cols[0]), m));
+		}
+	}
+
+	// The basis is kept, the new rows enter with basic slacks and the next
+	// simplex Update() continues with dual simplex from it.
+	warm_start_pending = false;
+}
+
+void LPBoostMulticlassClassifier::SetNu(double nu) {
+	assert(initialized);
+	assert(nu > 0.0);
+	assert(nu <= 1.0);
+	this->nu = nu;
+	SetSlackPenalty();
+}
+
+void LPBoostMulticlassClassifier::SetSlackPenalty() {
+	// D = 1 / (nu N), the cap on the sample weights in the dual
+	// formulation.  The entropy regularized solve reads nu itself.
+	double slack_penalty = 1.0 /
+		(nu * static_cast<double>(sample_labels.size()));
+	for (unsigned int n = 0; n < sample_labels.size(); ++n) {
+		if (formulation == DualFormulation)
+			si->setRowUpper(XiColumn(n), slack_penalty);
+		else
+			si->setObjCoeff(XiColumn(n), slack_penalty);
+	}
+}
+
+void LPBoostMulticlassClassifier::SetInitialWeights(
+	const std::vector<std::vector<double> >& weights, bool fixed_rho,
+	double initial_rho) {
+	assert(initialized);
+	if (weights.size() == static_cast<unsigned int>(number_classes) &&
+		norm1_rows < weights.size()) {
+		// One weight vector per class, as ClassifierWeights() with class
+		// groups: each group takes that of its first class.
+		std::vector<std::vector<double> > group_weights(norm1_rows);
+		for (int cl = number_classes - 1; cl >= 0; --cl) {
+			group_weights[class_groups.empty() ? 0 : class_groups[cl]] =
+				weights[cl];
+		}
+		SetInitialWeights(group_weights, fixed_rho, initial_rho);
+		return;
+	}
+	assert(weights.size() == norm1_rows);
+	if (formulation == EntropyRegularizedFormulation) {
+		// The Frank-Wolfe solve starts from the current weights.
+		classifier_weights = weights;
+		ExpandClassifierWeights();
+		return;
+	}
+	if (formulation == DualFormulation) {
+		std::cout << "Warm start from weights is only supported for the "
+			<< "primal formulation." << std::endl;
+		return;
+	}
+
+	// The feasible point below has xi > 0 for some samples.
+	for (unsigned int n = 0; n < sample_screened.size(); ++n) {
+		if (sample_screened[n])
+			SetSampleScreened(n, false);
+	}
+
+	// Scale the weights to the norm-1 constraints, weak learners added
+	// after the weights were obtained start at zero.
+	std::vector<std::vector<double> > alpha(norm1_rows,
+		std::vector<double>(number_classifiers, 0.0));
+	for (unsigned int ci = 0; ci < norm1_rows; ++ci) {
+		assert(weights[ci].size() <= number_classifiers);
+		double weight_sum = 0.0;
+		for (unsigned int m = 0; m < weights[ci].size(); ++m) {
+			assert(weights[ci][m] >= 0.0);
+			weight_sum += weights[ci][m];
+		}
+		for (unsigned int m = 0; m < number_classifiers; ++m) {
+			if (weight_sum > 0.0) {
+				alpha[ci][m] = (m < weights[ci].size()) ?
+					(weights[ci][m] / weight_sum) : 0.0;
+			} else {
+				alpha[ci][m] = 1.0 / number_classifiers;
+			}
+		}
+	}
+
+	// Feasible primal point: xi_n = max(0, rho - min_cl margin_{n,cl}), with
+	// the optimal rho for these weights unless given.
+	std::vector<double> margins;
+	SampleMargins(alpha, margins);
+	double rho_init = fixed_rho ? initial_rho : OptimalRho(margins);
+
+	std::vector<double> primal(PrimalColumns(), 0.0);
+	primal[0] = rho_init;
+	for (unsigned int n = 0; n < sample_labels.size(); ++n)
+		primal[XiColumn(n)] = std::max(0.0, rho_init - margins[n]);
+	for (unsigned int m = 0; m < number_classifiers; ++m) {
+		for (unsigned int ci = 0; ci < norm1_rows; ++ci)
+			primal[AlphaColumn(m) + ci] = alpha[ci][m];
+	}
+	si->setColSolution(&primal[0]);
+
+	if (use_interior_point) {
+		std::cout << "Warm start ignored, the barrier solver always "
+			<< "starts from scratch." << std::endl;
+	} else if (SetPointBasis(primal) == false) {
+		std::cout << "Warm start ignored, the solver does not take a "
+			<< "starting basis." << std::endl;
+	} else {
+		warm_start_pending = true;
+	}
+}
+
+bool LPBoostMulticlassClassifier::SetPointBasis(
+	const std::vector<double>& primal) {
+	const double tolerance = 1e-9;
+	unsigned int number_rows = si->getNumRows();
+	std::vector<double> activity(number_rows, 0.0);
+	si->getMatrixByCol()->times(&primal[0], &activity[0]);
+	const double* row_lower = si->getRowLower();
+	const double* row_upper = si->getRowUpper();
+
+	// Columns off zero are basic, rho whatever its value, rows with slack
+	// are basic and the tight ones at their bound.
+	CoinWarmStartBasis basis;
+	basis.setSize(si->getNumCols(), number_rows);
+	unsigned int number_basic = 0;
+	std::vector<std::pair<double, int> > alpha_basic;
+	for (int ci = 0; ci < si->getNumCols(); ++ci) {
+		if (ci == 0 || primal[ci] > tolerance) {
+			basis.setStructStatus(ci, CoinWarmStartBasis::basic);
+			number_basic += 1;
+			if (ci >= static_cast<int>(AlphaColumn(0)))
+				alpha_basic.push_back(std::make_pair(primal[ci], ci));
+		} else {
+			basis.setStructStatus(ci, CoinWarmStartBasis::atLowerBound);
+		}
+	}
+	std::vector<bool> tight(number_rows, false);
+	for (unsigned int ri = 0; ri < number_rows; ++ri) {
+		if (activity[ri] <= row_lower[ri] + tolerance) {
+			basis.setArtifStatus(ri, CoinWarmStartBasis::atLowerBound);
+			tight[ri] = true;
+		} else if (activity[ri] >= row_upper[ri] - tolerance) {
+			basis.setArtifStatus(ri, CoinWarmStartBasis::atUpperBound);
+			tight[ri] = true;
+		} else {
+			basis.setArtifStatus(ri, CoinWarmStartBasis::basic);
+			number_basic += 1;
+		}
+	}
+
+	// Fewer basics than rows: the point is a degenerate vertex, make
+	// tight margin rows basic at zero, except the tightest of each sample
+	// with basic xi_n, which determines it.
+	for (unsigned int n = 0; n < sample_labels.size() &&
+		number_basic < number_rows; ++n) {
+		bool keep = (primal[XiColumn(n)] > tolerance);
+		for (int cl = 0; cl < number_classes &&
+			number_basic < number_rows; ++cl) {
+			if (cl == sample_labels[n] || tight[MarginRow(n, cl)] == false)
+				continue;
+			if (keep) {
+				keep = false;
+				continue;
+			}
+			basis.setArtifStatus(MarginRow(n, cl), CoinWarmStartBasis::basic);
+			number_basic += 1;
+		}
+	}
+	// More basics than rows: the point is not a vertex, the smallest
+	// weights go nonbasic and the primal simplex repairs the rest.
+	std::sort(alpha_basic.begin(), alpha_basic.end());
+	for (unsigned int ai = 0; ai < alpha_basic.size() &&
+		number_basic > number_rows; ++ai) {
+		basis.setStructStatus(alpha_basic[ai].second,
+			CoinWarmStartBasis::atLowerBound);
+		number_basic -= 1;
+	}
+	return (si->setWarmStart(&basis));
+}
+
+void LPBoostMulticlassClassifier::SampleMargins(
+	const std::vector<std::vector<double> >& alpha,
+	std::vector<double>& margins) const {
+	// Margin of each constraint row, H_{y_n,.}(x_n)' alpha - H_{cl,.}(x_n)'
+	// alpha, then the minimum over the K-1 rows of each sample.
+	const CoinPackedMatrix* matrix = PrimalMatrixByColumn();
+	std::vector<double> row_margins(PrimalRows(), 0.0);
+	for (unsigned int m = 0; m < number_classifiers; ++m) {
+		for (unsigned int ci = 0; ci < norm1_rows; ++ci) {
+			if (alpha[ci][m] == 0.0)
+				continue;
+			CoinShallowPackedVector col =
+				matrix->getVector(AlphaColumn(m) + ci);
+			for (int ei = 0; ei < col.getNumElements(); ++ei) {
+				row_margins[col.getIndices()[ei]] +=
+					alpha[ci][m] * col.getElements()[ei];
+			}
+		}
+	}
+
+	margins.resize(sample_labels.size());
+	for (unsigned int n = 0; n < sample_labels.size(); ++n) {
+		unsigned int row = MarginRow(n, sample_labels[n] == 0 ? 1 : 0);
+		margins[n] = *std::min_element(row_margins.begin() + row,
+			row_margins.begin() + row + number_classes - 1);
+	}
+}
+
+double LPBoostMulticlassClassifier::OptimalRho(
+	const std::vector<double>& margins) const {
+	// -rho + D sum_n max(0, rho - margin_n) has slope -1 + D |{n: margin_n
+	// < rho}|, it is minimized at the ceil(nu N)'th smallest margin.
+	std::vector<double> sorted_margins(margins);
+	unsigned int k = static_cast<unsigned int>(ceil(nu * margins.size()));
+	k = std::min(std::max(k, 1u), static_cast<unsigned int>(margins.size()));
+	std::nth_element(sorted_margins.begin(), sorted_margins.begin() + (k - 1),
+		sorted_margins.end());
+	return (sorted_margins[k - 1]);
+}
+
+unsigned int LPBoostMulticlassClassifier::XiColumn(unsigned int n) const {
+	return (xi_columns[n]);
+}
+
+unsigned int LPBoostMulticlassClassifier::AlphaColumn(unsigned int m) const {
+	// [rho, xi, alpha_1, ..., alpha_M] or [rho, xi, A_{1,1}, ..., A_{M,K}],
+	// followed by the xi and alpha columns of samples and weak learners
+	// added later.
+	return (alpha_columns[m]);
+}
+
+const LPBoostMulticlassClassifier::Statistics&
+LPBoostMulticlassClassifier::Stats() const {
+	return (stats);
+}
+
+bool LPBoostMulticlassClassifier::Update() {
+	assert(initialized);
+
+	if (number_classifiers == 0) {
+		// Without columns the margin rows cannot be satisfied.
+		std::cerr << "No weak learners to solve for." << std::endl;
+		return (false);
+	}
+
+	if (cache_directory.empty() == false && RestoreCachedSolution()) {
+		if (validation_labels.empty() == false)
+			UpdateValidation();
+		return (true);
+	}
+
+	if (formulation == EntropyRegularizedFormulation) {
+		if (cache_directory.empty() == false && classifier_weights.empty())
+			WarmStartFromCache();
+		UpdateEntropyRegularized();
+		if (cache_directory.empty() == false)
+			WriteCacheEntry(CacheKey(number_classifiers));
+		if (validation_labels.empty() == false)
+			UpdateValidation();
+		return (true);
+	}
+
+	//si->writeMps ("toughone", "mps", si->getObjSense());
+
+	//si->messageHandler()->setLogLevel(0);	// no verbosity
+	OsiClpSolverInterface* clp_si = dynamic_cast<OsiClpSolverInterface*>(si);
+	if (clp_si != NULL && lp_scaling >= 0)
+		clp_si->getModelPtr()->scaling(lp_scaling);
+	unsigned int cache_warm_starts = stats.cache_warm_starts;
+	if (cache_directory.empty() == false && lp_has_basis == false &&
+		use_interior_point == false && warm_start_pending == false)
+		WarmStartFromCache();
+	bool barrier = use_interior_point;
+	bool race = (solver_race && clp_si != NULL && warm_start_pending == false);
+	if (race && race_decisive_wins > 0 && race_streak >= race_decisive_wins) {
+		// One method keeps winning, solve with it alone.
+		race = false;
+		barrier = race_barrier_leads;
+	} else if (race && abandoned_race.expired() == false) {
+		// The barrier of the last race still runs, which the simplex won.
+		race = false;
+		barrier = false;
+		stats.race_skipped += 1;
+	}
+	if (coarse_levels > 0 && lp_has_basis == false && barrier == false &&
+		race == false && warm_start_pending == false &&
+		formulation == PrimalFormulation && number_classifiers > 0 &&
+		stats.cache_warm_starts == cache_warm_starts) {
+		// The dual simplex below continues from the last level.
+		SolveCoarseToFine();
+	}
+	OsiSolverInterface* solved = si;
+	boost::shared_ptr<SolverRace> race_state;
+	if (race) {
+		solved = RaceSolvers(clp_si, race_state);
+		barrier = (solved != si);
+		if (barrier)
+			stats.race_barrier_wins += 1;
+		else
+			stats.race_simplex_wins += 1;
+		if (barrier == race_barrier_leads) {
+			race_streak += 1;
+		} else {
+			race_barrier_leads = barrier;
+			race_streak = 1;
+		}
+	} else if (barrier && clp_si != NULL) {
+		SolveBarrier(clp_si);	// Complete initial solve.
+	} else if (barrier) {
+		si->initialSolve();
+	} else if (warm_start_pending) {
+		// Primal simplex from the basis SetInitialWeights set around its
+		// feasible point.
+		bool dual_hint;
+		OsiHintStrength dual_strength;
+		si->getHintParam(OsiDoDualInResolve, dual_hint, dual_strength);
+		si->setHintParam(OsiDoDualInResolve, false, OsiHintDo);
+		si->resolve();
+		si->setHintParam(OsiDoDualInResolve, dual_hint, dual_strength);
+	} else {
+		// Warm-start solving: new weak learners add columns, new samples add
+		// rows (dual simplex from the previous basis).
+		si->resolve();
+	}
+	warm_start_pending = false;
+	stats.solver_iterations = solved->getIterationCount();
+
+	if (solved->isProvenOptimal() == false) {
+		ReportSolverFailure();
+		return (false);
+	}
+
+	ExtractSolution(solved->getColSolution(), solved->getRowPrice(),
+		solved->getObjValue());
+	if (solved != si) {
+		// The stopped simplex left si with a basis to continue from, but
+		// the solution is the barrier's.
+		si->setColSolution(solved->getColSolution());
+		si->setRowPrice(solved->getRowPrice());
+	}
+	lp_has_basis = (barrier == false);
+
+	if (sample_screening && formulation == PrimalFormulation) {
+		// Solve again until no screened sample is violated, the solution
+		// is then one of the full problem.
+		while (ReinsertViolatedSamples() > 0) {
+			// Dual simplex, after the barrier from the slack basis.
+			si->resolve();
+			stats.solver_iterations += si->getIterationCount();
+			if (si->isProvenOptimal() == false) {
+				ReportSolverFailure();
+				return (false);
+			}
+			ExtractSolution(si->getColSolution(), si->getRowPrice(),
+				si->getObjValue());
+			lp_has_basis = true;
+		}
+		ScreenSamples();
+	}
+
+	if (cache_directory.empty() == false)
+		WriteCacheEntry(CacheKey(number_classifiers));
+	if (validation_labels.empty() == false)
+		UpdateValidation();
+	return (true);
+}
+
+void LPBoostMulticlassClassifier::ReportSolverFailure() const {
+	std::cerr << "Linear Program Solver failed." << std::endl;
+	std::cerr << "Problem: " << si->getNumCols() << " variables, "
+		<< si->getNumRows() << " rows." << std::endl;
+	si->writeMps("LP-CRASH", "mps", si->getObjSense());
+	std::cerr << "Written problem to file \"LP-CRASH.MPS\" for analysis."
+		<< std::endl;
+	std::cerr << "         problem sense: "
+		<< si->getObjSense() << std::endl;
+	std::cerr << "STATUS:  numerical difficulties: "
+		<< (si->isAbandoned() ? "YES" : "no") << std::endl;
+	std::cerr << "STATUS:       primal infeasible: "
+		<< (si->isProvenPrimalInfeasible() ? "YES" : "no") << std::endl;
+	std::cerr << "STATUS:         dual infeasible: "
+		<< (si->isProvenDualInfeasible() ? "YES" : "no") << std::endl;
+	std::cerr << "STATUS: iteration limit reached: "
+		<< (si->isIterationLimitReached() ? "YES" : "no") << std::endl;
+}
+
+void LPBoostMulticlassClassifier::ExtractSolution(
+	const double* column_solution, const double* row_price,
+	double objective_value) {
+	const double* primal = column_solution;
+	std::vector<double> dual_prices;
+	if (formulation == DualFormulation) {
+		// The primal variables are the negated row prices.
+		dual_prices.resize(si->getNumRows());
+		for (unsigned int ri = 0; ri < dual_prices.size(); ++ri)
+			dual_prices[ri] = -row_price[ri];
+		primal = &dual_prices[0];
+		gamma = objective_value;	// -\sum_b beta_b
+	} else {
+		gamma = -objective_value;	// rho - D \sum_i \xi_i
+	}
+	rho = primal[0];
+	if (weight_sharing) {
+		classifier_weights.resize(1);
+		classifier_weights[0].resize(number_classifiers);
+		for (unsigned int m = 0; m < number_classifiers; ++m)
+			classifier_weights[0][m] = primal[AlphaColumn(m)];
+	} else {
+		// [rho, xi, A_{1,1}, ..., A_{1,K}, o o o, A_{M,1}, ..., A_{M,K}]
+		// where A_{j,i} is the i'th class weight for the j'th weak learner,
+		// or of the i'th group of G with class groups.
+		classifier_weights.resize(norm1_rows);
+		for (unsigned int cl1 = 0; cl1 < norm1_rows; ++cl1) {
+			classifier_weights[cl1].resize(number_classifiers);
+			for (unsigned int m = 0; m < number_classifiers; ++m)
+				classifier_weights[cl1][m] = primal[AlphaColumn(m) + cl1];
+		}
+	}
+	ExpandClassifierWeights();
+
+	// The margin distribution are the row prices of the margin rows, the
+	// variables u of the dual formulation.
+	SetMarginDistribution(formulation == DualFormulation ?
+		column_solution : row_price, 0);
+}
+
+LPBoostMulticlassClassifier::LPData
+LPBoostMulticlassClassifier::SolverLP() const {
+	assert(initialized);
+	const CoinPackedMatrix* matrix = si->getMatrixByCol();
+	LPData lp;
+	lp.number_rows = si->getNumRows();
+	lp.number_columns = si->getNumCols();
+	lp.has_gaps = matrix->hasGaps();
+	lp.column_starts = matrix->getVectorStarts();
+	lp.column_lengths = matrix->getVectorLengths();
+	lp.row_indices = matrix->getIndices();
+	lp.values = matrix->getElements();
+	lp.column_lower = si->getColLower();
+	lp.column_upper = si->getColUpper();
+	lp.objective = si->getObjCoefficients();
+	lp.row_lower = si->getRowLower();
+	lp.row_upper = si->getRowUpper();
+
+	// With gaps, the arrays extend to the end of the last column stored.
+	lp.number_elements = 0;
+	for (int ci = 0; ci < lp.number_columns; ++ci) {
+		lp.number_elements = std::max(lp.number_elements,
+			lp.column_starts[ci] + lp.column_lengths[ci]);
+	}
+	return (lp);
+}
+
+double LPBoostMulticlassClassifier::SetSolution(
+	const std::vector<double>& column_solution,
+	const std::vector<double>& row_price) {
+	assert(initialized);
+	assert(formulation != EntropyRegularizedFormulation);
+	if (column_solution.size() != static_cast<unsigned int>(si->getNumCols()) ||
+		row_price.size() != static_cast<unsigned int>(si->getNumRows()) ||
+		column_solution.empty() || row_price.empty()) {
+		std::cerr << "Solution of " << column_solution.size() << " columns and "
+			<< row_price.size() << " row prices does not fit the LP of "
+			<< si->getNumCols() << " columns and " << si->getNumRows()
+			<< " rows." << std::endl;
+		return (std::numeric_limits<double>::infinity());
+	}
+
+	// Largest violation of the column bounds and rows, and the objective
+	const double* column_lower = si->getColLower();
+	const double* column_upper = si->getColUpper();
+	const double* objective = si->getObjCoefficients();
+	const CoinPackedMatrix* matrix = si->getMatrixByCol();
+	std::vector<double> activity(si->getNumRows(), 0.0);
+	double violation = 0.0;
+	double objective_value = 0.0;
+	for (int ci = 0; ci < si->getNumCols(); ++ci) {
+		double x = column_solution[ci];
+		violation = std::max(violation, column_lower[ci] - x);
+		violation = std::max(violation, x - column_upper[ci]);
+		objective_value += objective[ci] * x;
+		CoinShallowPackedVector col = matrix->getVector(ci);
+		for (int ei = 0; ei < col.getNumElements(); ++ei)
+			activity[col.getIndices()[ei]] += col.getElements()[ei] * x;
+	}
+	const double* row_lower = si->getRowLower();
+	const double* row_upper = si->getRowUpper();
+	for (int ri = 0; ri < si->getNumRows(); ++ri) {
+		violation = std::max(violation, row_lower[ri] - activity[ri]);
+		violation = std::max(violation, activity[ri] - row_upper[ri]);
+	}
+
+	si->setColSolution(&column_solution[0]);
+	si->setRowPrice(&row_price[0]);
+	ExtractSolution(&column_solution[0], &row_price[0], objective_value);
+	warm_start_pending = false;
+	stats.solver_iterations = 0;
+	if (validation_labels.empty() == false)
+		UpdateValidation();
+
+	return (violation);
+}
+
+void LPBoostMulticlassClassifier::SetSolutionCache(
+	const std::string& directory, uint64_t max_bytes) {
+	cache_directory = directory;
+	cache_max_bytes = max_bytes;
+	cache_scanned = false;
+	if (directory.empty())
+		return;
+
+	try {
+		boost::filesystem::create_directories(
+			boost::filesystem::path(directory));
+	} catch (const boost::filesystem::filesystem_error& error) {
+		std::cerr << "Solution cache disabled, cannot create \""
+			<< directory << "\": " << error.what() << std::endl;
+		cache_directory.clear();
+	}
+}
+
+std::string LPBoostMulticlassClassifier::CacheKey(
+	unsigned int number_learners) const {
+	if (cache_chain[number_learners] == 0)
+		return (std::string());	// unknown after AddSamples
+
+	// The options as they are, the labels and weak learners by their two
+	// hashes.
+	int options[5] = { number_classes, weight_sharing ? 1 : 0,
+		static_cast<int>(formulation), use_interior_point ? 1 : 0,
+		lp_scaling };
+	std::string key;
+	key.append(reinterpret_cast<const char*>(&cache_chain[number_learners]),
+		sizeof(uint64_t));
+	key.append(reinterpret_cast<const char*>(
+		&cache_check_chain[number_learners]), sizeof(uint64_t));
+	key.append(reinterpret_cast<const char*>(&nu), sizeof(nu));
+	key.append(reinterpret_cast<const char*>(options), sizeof(options));
+	if (formulation == EntropyRegularizedFormulation) {
+		key.append(reinterpret_cast<const char*>(&entropy_epsilon),
+			sizeof(entropy_epsilon));
+	}
+	if (class_groups.empty() == false) {
+		key.append(reinterpret_cast<const char*>(&class_groups[0]),
+			class_groups.size() * sizeof(int));
+	}
+	key.append(solver_name);
+
+	return (key);
+}
+
+std::string LPBoostMulticlassClassifier::CachePath(
+	const std::string& key) const {
+	std::ostringstream name;
+	name << std::hex << std::setw(16) << std::setfill('0')
+		<< HashBytes(14695981039346656037ull, key.data(), key.size())
+		<< ".mclp";
+	return ((boost::filesystem::path(cache_directory) / name.str()).string());
+}
+
+bool LPBoostMulticlassClassifier::ReadCacheEntry(const std::string& key,
+	CacheEntry& entry) const {
+	std::ifstream in(CachePath(key).c_str(), std::ios::binary);
+	if (in.fail())
+		return (false);
+
+	// Entries of other keys with the same file name are misses.  Only the
+	// hashes of the responses are in the key, a problem colliding in both
+	// with a cached one would take its solution.
+	char magic[8];
+	uint32_t key_size = 0;
+	in.read(magic, sizeof(magic));
+	in.read(reinterpret_cast<char*>(&key_size), sizeof(key_size));
+	if (in.fail() || memcmp(magic, cache_magic, sizeof(magic)) != 0 ||
+		key_size != key.size())
+		return (false);
+	std::string stored_key(key_size, 0);
+	in.read(&stored_key[0], key_size);
+	uint32_t dims[5];
+	in.read(reinterpret_cast<char*>(dims), sizeof(dims));
+	if (in.fail() || stored_key != key || dims[0] != norm1_rows ||
+		dims[2] == 0 || dims[2] != PrimalRows() - norm1_rows)
+		return (false);
+
+	entry.number_classifiers = dims[1];
+	in.read(reinterpret_cast<char*>(&entry.rho), sizeof(double));
+	in.read(reinterpret_cast<char*>(&entry.gamma), sizeof(double));
+	entry.weights.resize(norm1_rows);
+	for (unsigned int ci = 0; ci < norm1_rows; ++ci) {
+		entry.weights[ci].resize(entry.number_classifiers);
+		if (entry.number_classifiers > 0) {
+			in.read(reinterpret_cast<char*>(&entry.weights[ci][0]),
+				entry.number_classifiers * sizeof(double));
+		}
+	}
+	entry.distribution.resize(dims[2]);
+	in.read(reinterpret_cast<char*>(&entry.distribution[0]),
+		dims[2] * sizeof(double));
+	entry.structural_status.resize(dims[3]);
+	entry.artificial_status.resize(dims[4]);
+	if (dims[3] > 0)
+		in.read(&entry.structural_status[0], dims[3]);
+	if (dims[4] > 0)
+		in.read(&entry.artificial_status[0], dims[4]);
+
+	return (in.fail() == false);
+}
+
+void LPBoostMulticlassClassifier::WriteCacheEntry(const std::string& key) {
+	if (key.empty())
+		return;
+
+	std::vector<char> structural_status;
+	std::vector<char> artificial_status;
+	if (lp_has_basis) {
+		CoinWarmStart* warm_start = si->getWarmStart();
+		CoinWarmStartBasis* basis =
+			dynamic_cast<CoinWarmStartBasis*>(warm_start);
+		if (basis != NULL) {
+			structural_status.resize(basis->getNumStructural());
+			for (int vi = 0; vi < basis->getNumStructural(); ++vi)
+				structural_status[vi] = basis->getStructStatus(vi);
+			artificial_status.resize(basis->getNumArtificial());
+			for (int vi = 0; vi < basis->getNumArtificial(); ++vi)
+				artificial_status[vi] = basis->getArtifStatus(vi);
+		}
+		delete warm_start;
+	}
+
+	// Written under a name private to the process and thread and renamed,
+	// concurrent runs and classifiers on the same cache only ever see
+	// complete entries.
+	std::string path = CachePath(key);
+	std::ostringstream temp_path;
+	temp_path << path << ".tmp" << getpid() << "-"
+		<< boost::this_thread::get_id();
+	std::ofstream out(temp_path.str().c_str(), std::ios::binary);
+	uint32_t dims[5] = { norm1_rows, number_classifiers,
+		PrimalRows() - norm1_rows,
+		static_cast<uint32_t>(structural_status.size()),
+		static_cast<uint32_t>(artificial_status.size()) };
+	uint32_t key_size = key.size();
+	out.write(cache_magic, sizeof(cache_magic));
+	out.write(reinterpret_cast<const char*>(&key_size), sizeof(key_size));
+	out.write(key.data(), key.size());
+	out.write(reinterpret_cast<const char*>(dims), sizeof(dims));
+	out.write(reinterpret_cast<const char*>(&rho), sizeof(double));
+	out.write(reinterpret_cast<const char*>(&gamma), sizeof(double));
+	for (unsigned int ci = 0; ci < norm1_rows; ++ci) {
+		if (number_classifiers > 0) {
+			out.write(reinterpret_cast<const char*>(&classifier_weights[ci][0]),
+				number_classifiers * sizeof(double));
+		}
+	}
+	for (unsigned int n = 0; n < sample_labels.size(); ++n) {
+		for (int cl = 0; cl < number_classes; ++cl) {
+			if (cl != sample_labels[n]) {
+				out.write(reinterpret_cast<const char*>(
+					&margin_distribution[n][cl]), sizeof(double));
+			}
+		}
+	}
+	if (structural_status.empty() == false)
+		out.write(&structural_status[0], structural_status.size());
+	if (artificial_status.empty() == false)
+		out.write(&artificial_status[0], artificial_status.size());
+	uint64_t entry_bytes = out.tellp();
+	out.close();
+	if (out.fail() ||
+		rename(temp_path.str().c_str(), path.c_str()) != 0) {
+		std::cerr << "Failed to write solution cache entry \"" << path
+			<< "\"." << std::endl;
+		remove(temp_path.str().c_str());
+		return;
+	}
+
+	// The directory is scanned when the entries known to be written since
+	// the last scan take the cache beyond its size, those of concurrent
+	// runs are found then.
+	cache_bytes += entry_bytes;
+	if (cache_scanned == false || cache_bytes > cache_max_bytes) {
+		cache_bytes = EvictCache(path);
+		cache_scanned = true;
+	}
+}
+
+bool LPBoostMulticlassClassifier::RestoreCachedSolution() {
+	std::string key = CacheKey(number_classifiers);
+	CacheEntry entry;
+	if (key.empty() || ReadCacheEntry(key, entry) == false ||
+		entry.number_classifiers != number_classifiers)
+		return (false);
+
+	classifier_weights = entry.weights;
+	ExpandClassifierWeights();
+	rho = entry.rho;
+	gamma = entry.gamma;
+	SetMarginDistribution(&entry.distribution[0], norm1_rows);
+	if (SetCachedBasis(entry))
+		lp_has_basis = true;
+	warm_start_pending = false;
+	stats.cache_hits += 1;
+	stats.solver_iterations = 0;
+
+	// Recently used entries are evicted last.
+	try {
+		boost::filesystem::last_write_time(
+			boost::filesystem::path(CachePath(key)), std::time(0));
+	} catch (const boost::filesystem::filesystem_error&) {
+		// evicted concurrently, the solution is already read
+	}
+	return (true);
+}
+
+void LPBoostMulticlassClassifier::WarmStartFromCache() {
+	// The longest cached problem this one extends by further weak learners
+	for (unsigned int m = number_classifiers; m-- > 1; ) {
+		std::string key = CacheKey(m);
+		if (key.empty())
+			return;
+
+		CacheEntry entry;
+		if (ReadCacheEntry(key, entry) == false)
+			continue;
+		if (formulation == EntropyRegularizedFormulation) {
+			// Frank-Wolfe starts from the weights, new learners at zero
+			classifier_weights = entry.weights;
+			ExpandClassifierWeights();
+		} else if (SetCachedBasis(entry) == false) {
+			continue;
+		}
+		stats.cache_warm_starts += 1;
+		return;
+	}
+}
+
+bool LPBoostMulticlassClassifier::SetCachedBasis(const CacheEntry& entry) {
+	if (entry.structural_status.empty() ||
+		formulation == EntropyRegularizedFormulation || use_interior_point)
+		return (false);
+
+	// Weak learners added since are nonbasic at zero: new columns at their
+	// lower bound, new rows of the dual formulation with basic slacks.
+	CoinWarmStartBasis basis;
+	basis.setSize(si->getNumCols(), si->getNumRows());
+	for (int vi = 0; vi < si->getNumCols(); ++vi) {
+		basis.setStructStatus(vi, vi < static_cast<int>(
+			entry.structural_status.size()) ? static_cast<
+			CoinWarmStartBasis::Status>(entry.structural_status[vi]) :
+			CoinWarmStartBasis::atLowerBound);
+	}
+	for (int vi = 0; vi < si->getNumRows(); ++vi) {
+		basis.setArtifStatus(vi, vi < static_cast<int>(
+			entry.artificial_status.size()) ? static_cast<
+			CoinWarmStartBasis::Status>(entry.artificial_status[vi]) :
+			CoinWarmStartBasis::basic);
+	}
+	return (si->setWarmStart(&basis));
+}
+
+uint64_t LPBoostMulticlassClassifier::EvictCache(
+	const std::string& keep_path) const {
+	namespace fs = boost::filesystem;
+
+	// Least recently written or used entries first.  The modification
+	// times are in seconds, keep_path, just written, may tie with others.
+	std::vector<std::pair<std::time_t, std::pair<uint64_t, std::string> > >
+		entries;
+	uint64_t total_bytes = 0;
+	try {
+		fs::directory_iterator end;
+		for (fs::directory_iterator it(cache_directory); it != end; ++it) {
+			std::string path = it->path().string();
+			if (path.size() < 5 ||
+				path.compare(path.size() - 5, 5, ".mclp") != 0)
+				continue;
+			uint64_t bytes = fs::file_size(it->path());
+			entries.push_back(std::make_pair(fs::last_write_time(it->path()),
+				std::make_pair(bytes, path)));
+			total_bytes += bytes;
+		}
+		std::sort(entries.begin(), entries.end());
+		for (unsigned int ei = 0; ei < entries.size() &&
+			total_bytes > cache_max_bytes; ++ei) {
+			if (entries[ei].second.second == keep_path)
+				continue;
+			fs::remove(fs::path(entries[ei].second.second));
+			total_bytes -= entries[ei].second.first;
+		}
+	} catch (const fs::filesystem_error& error) {
+		// Another run evicting the same entries
+		std::cerr << "Solution cache eviction: " << error.what() << std::endl;
+	}
+	return (total_bytes);
+}
+
+void LPBoostMulticlassClassifier::SetBarrierOptions(unsigned int threads,
+	unsigned int max_dense_columns) {
+	barrier_max_dense_columns = max_dense_columns;
+
+	// The multithreaded backends take their threads from OpenMP or the
+	// BLAS, settings of the whole process.
+	stats.barrier_threads_ignored = false;
+	if (threads > 0) {
+#ifdef _OPENMP
+		omp_set_num_threads(threads);
+#endif
+#ifdef HAS_OPENBLAS
+		openblas_set_num_threads(threads);
+#endif
+#if !defined(_OPENMP) && !defined(HAS_OPENBLAS)
+		std::cerr << "Barrier threads ignored: built without -fopenmp or "
+			<< "-DHAS_OPENBLAS, see CHOLESKY_FLAGS." << std::endl;
+		stats.barrier_threads_ignored = true;
+#endif
+	}
+}
+
+void LPBoostMulticlassClassifier::SetSolverRace(bool race,
+	unsigned int decisive_wins) {
+	solver_race = race;
+	race_decisive_wins = decisive_wins;
+	race_streak = 0;
+}
+
+// A solver race, shared with its barrier thread, which outlives the
+// Update() that started it when the simplex wins.  Owns the copy of the
+// problem the barrier solves.
+class SolverRace {
+public:
+	enum Method { None, Simplex, Barrier };
+	explicit SolverRace(OsiClpSolverInterface* barrier_si)
+		: barrier_si(barrier_si), dense_columns(0), winner(None) {
+	}
+	~SolverRace() {
+		delete barrier_si;
+	}
+	// The first proven optimal solve wins.
+	void Finish(Method method) {
+		boost::mutex::scoped_lock lock(mutex);
+		if (winner == None)
+			winner = method;
+	}
+	Method Winner() {
+		boost::mutex::scoped_lock lock(mutex);
+		return (winner);
+	}
+
+	OsiClpSolverInterface* barrier_si;
+	unsigned int dense_columns;	// Of the barrier solve, once joined
+private:
+	boost::mutex mutex;
+	Method winner;
+};
+
+// Stops the simplex solve of the race at the end of an iteration once the
+// barrier has won.
+class RaceEventHandler : public ClpEventHandler {
+public:
+	explicit RaceEventHandler(SolverRace* race) : race(race) {
+	}
+	virtual int event(Event whichEvent) {
+		if (whichEvent != endOfIteration)
+			return (-1);
+		return (race->Winner() == SolverRace::Barrier ? 0 : -1);
+	}
+	virtual ClpEventHandler* clone() const {
+		return (new RaceEventHandler(*this));
+	}
+private:
+	SolverRace* race;
+};
+
+// The barrier of a race, holding a share of it until done.
+static void RunBarrierRacer(boost::function0<unsigned int> solve,
+	boost::shared_ptr<SolverRace> race) {
+	race->dense_columns = solve();
+	if (race->barrier_si->isProvenOptimal())
+		race->Finish(SolverRace::Barrier);
+}
+
+OsiSolverInterface* LPBoostMulticlassClassifier::RaceSolvers(
+	OsiClpSolverInterface* clp_si, boost::shared_ptr<SolverRace>& race) {
+	race.reset(new SolverRace(
+		dynamic_cast<OsiClpSolverInterface*>(clp_si->clone())));
+	ClpSimplex* model = clp_si->getModelPtr();
+	ClpEventHandler* previous_handler = model->eventHandler()->clone();
+	RaceEventHandler simplex_stop(race.get());
+	model->passInEventHandler(&simplex_stop);
+
+	// Barrier on the copy in a second thread, dual simplex from the last
+	// basis here.
+	boost::thread barrier_thread(RunBarrierRacer,
+		boost::function0<unsigned int>(boost::bind(
+			&LPBoostMulticlassClassifier::RunBarrier, race->barrier_si,
+			formulation, number_classes, barrier_max_dense_columns)),
+		race);
+	si->resolve();
+	if (si->isProvenOptimal())
+		race->Finish(SolverRace::Simplex);
+
+	model->passInEventHandler(previous_handler);
+	delete previous_handler;
+	if (race->Winner() == SolverRace::Simplex) {
+		// ClpInterior does not poll the event handler, the barrier cannot
+		// be stopped.  It finishes on its own and frees its copy.
+		barrier_thread.detach();
+		abandoned_race = race;
+		race.reset();
+		return (si);
+	}
+
+	// The barrier won and stopped the simplex, or the simplex failed.
+	barrier_thread.join();
+	if (race->Winner() != SolverRace::Barrier)
+		return (si);
+	stats.barrier_dense_columns = race->dense_columns;
+	return (race->barrier_si);
+}
+
+void LPBoostMulticlassClassifier::SolveBarrier(OsiClpSolverInterface* clp_si) {
+	stats.barrier_dense_columns = RunBarrier(clp_si, formulation,
+		number_classes, barrier_max_dense_columns);
+}
+
+unsigned int LPBoostMulticlassClassifier::RunBarrier(
+	OsiClpSolverInterface* clp_si, Formulation formulation,
+	int number_classes, unsigned int max_dense_columns) {
+	// The rho column and the alpha columns of weak learners responding on
+	// most samples touch nearly every margin row, and fill in the normal
+	// matrix A D A' completely.  Without them it is block diagonal, one
+	// K-1 block per sample from its xi column, and they enter as a low rank
+	// correction.  That pays off while there are few of them, beyond
+	// max_dense_columns the normal matrix is factored as dense.
+	int dense_threshold = 2 * (number_classes - 1);
+	unsigned int dense_columns = 0;
+	if (formulation == PrimalFormulation) {
+		// Of clp_si, the copy of a race while si is in use.
+		const int* lengths = clp_si->getMatrixByCol()->getVectorLengths();
+		for (int ci = 0; ci < clp_si->getNumCols(); ++ci) {
+			if (lengths[ci] > dense_threshold)
+				dense_columns += 1;
+		}
+	}
+
+	ClpCholeskyBase* cholesky = NULL;
+	if (formulation == DualFormulation) {
+		// The normal matrix of the dual is an arrowhead, the rho and
+		// learner rows bordering the xi diagonal, which the sparse
+		// ordering handles.
+		cholesky = new ClpCholeskyBase();
+	} else if (dense_columns <= max_dense_columns) {
+		cholesky = new ClpCholeskyBase(dense_threshold);
+	} else {
+#if defined(HAS_CLP_CHOLMOD)
+		cholesky = new ClpCholeskyUfl();	// supernodal
+#elif defined(HAS_CLP_MUMPS)
+		cholesky = new ClpCholeskyMumps();
+#else
+		cholesky = new ClpCholeskyDense();
+#endif
+		dense_columns = 0;
+	}
+
+	// Barrier without crossover to a basis, no presolve.
+	ClpSimplex* model = clp_si->getModelPtr();
+	ClpInterior barrier;
+	barrier.borrowModel(*model);
+	barrier.setCholesky(cholesky);	// owned by barrier
+	barrier.primalDual();
+	barrier.returnModel(*model);
+	return (dense_columns);
+}
+
+void LPBoostMulticlassClassifier::SetSampleScreening(bool enable,
+	double margin_threshold) {
+	assert(margin_threshold >= 0.0);
+	sample_screening = enable;
+	screening_threshold = margin_threshold;
+	if (enable == false) {
+		for (unsigned int n = 0; n < sample_screened.size(); ++n) {
+			if (sample_screened[n])
+				SetSampleScreened(n, false);
+		}
+	}
+}
+
+void LPBoostMulticlassClassifier::ScreenSamples() {
+	// For a feasible x and any optimal dual u*, the primal objective
+	// exceeds the optimum by at least sum_r u*_r s_r(x), so a row of
+	// slack s_r has u*_r <= gap / s_r.  Bounded below a tolerance, not at
+	// zero, and only for the current LP: Update checks the screened
+	// samples after each later solve.  The dual objective is the sum of
+	// the prices of the norm-1 rows, the margin rows have bound zero.
+	const double* row_price = si->getRowPrice();
+	double dual_objective = 0.0;
+	for (unsigned int ri = 0; ri < norm1_rows; ++ri)
+		dual_objective += row_price[ri];
+	double gap = std::max(0.0, -gamma - dual_objective);
+
+	// Dual weights below this fraction of D count as zero.
+	const double dual_tolerance = 1e-6 / (nu * sample_labels.size());
+
+	std::vector<double> activity;
+	RowActivities(activity);
+	const double* column_solution = si->getColSolution();
+	for (unsigned int n = 0; n < sample_labels.size(); ++n) {
+		if (sample_screened[n])
+			continue;
+
+		// Margin minus rho, the slack of the rows without xi_n
+		unsigned int first_row = MarginRow(n, sample_labels[n] == 0 ? 1 : 0);
+		double xi = column_solution[XiColumn(n)];
+		double slack = si->getInfinity();
+		bool weighted = false;
+		for (int ri = 0; ri < number_classes - 1; ++ri) {
+			slack = std::min(slack, activity[first_row + ri] - xi);
+			weighted |= (row_price[first_row + ri] > dual_tolerance);
+		}
+		if (weighted || slack < screening_threshold ||
+			gap > dual_tolerance * slack)
+			continue;
+
+		SetSampleScreened(n, true);
+	}
+	stats.relaxed_row_fraction = static_cast<double>(stats.samples_screened)
+		/ sample_labels.size();
+}
+
+unsigned int LPBoostMulticlassClassifier::ReinsertViolatedSamples() {
+	if (stats.samples_screened == 0)
+		return (0);
+
+	// Within the primal feasibility tolerance of Clp
+	const double tolerance = 1e-7;
+	std::vector<double> activity;
+	RowActivities(activity);
+	unsigned int reinserted = 0;
+	for (unsigned int n = 0; n < sample_labels.size(); ++n) {
+		if (sample_screened[n] == false)
+			continue;
+
+		unsigned int first_row = MarginRow(n, sample_labels[n] == 0 ? 1 : 0);
+		double slack = *std::min_element(activity.begin() + first_row,
+			activity.begin() + first_row + number_classes - 1);
+		if (slack >= -tolerance)
+			continue;
+
+		SetSampleScreened(n, false);
+		stats.samples_reinserted += 1;
+		reinserted += 1;
+	}
+	stats.relaxed_row_fraction = static_cast<double>(stats.samples_screened)
+		/ sample_labels.size();
+	return (reinserted);
+}
+
+void LPBoostMulticlassClassifier::SetSampleScreened(unsigned int n,
+	bool screened) {
+	assert(sample_screened[n] != screened);
+	sample_screened[n] = screened;
+	unsigned int first_row = MarginRow(n, sample_labels[n] == 0 ? 1 : 0);
+	for (int ri = 0; ri < number_classes - 1; ++ri)
+		si->setRowLower(first_row + ri, screened ? -si->getInfinity() : 0.0);
+	si->setColUpper(XiColumn(n), screened ? 0.0 : si->getInfinity());
+	if (screened)
+		stats.samples_screened += 1;
+	else
+		stats.samples_screened -= 1;
+}
+
+void LPBoostMulticlassClassifier::SetCoarseToFine(unsigned int levels,
+	double fraction) {
+	assert(fraction > 0.0 && fraction < 1.0);
+	coarse_levels = levels;
+	coarse_fraction = fraction;
+}
+
+bool LPBoostMulticlassClassifier::SolveCoarseToFine() {
+	// The basis of the last level over the rows and columns of si, the
+	// rows of samples not yet included with basic slacks, their xi at zero.
+	std::vector<CoinWarmStartBasis::Status> structural_status(
+		si->getNumCols(), CoinWarmStartBasis::atLowerBound);
+	std::vector<CoinWarmStartBasis::Status> artificial_status(
+		si->getNumRows(), CoinWarmStartBasis::basic);
+	std::vector<double> primal(si->getNumCols(), 0.0);
+	stats.coarse_iterations = 0;
+
+	std::vector<unsigned int> samples;
+	std::vector<int> rows;
+	std::vector<int> columns;
+	bool solved = false;
+	for (unsigned int level = 0; level < coarse_levels; ++level) {
+		// fraction^((levels - level) / levels), one for the full problem
+		double fraction = pow(coarse_fraction, static_cast<double>(
+			coarse_levels - level) / coarse_levels);
+		CoarseSamples(fraction, samples);
+		if (samples.size() == sample_labels.size())
+			break;
+
+		OsiSolverInterface* coarse = CoarseProblem(samples, rows, columns);
+		if (solved) {
+			CoinWarmStartBasis basis;
+			basis.setSize(columns.size(), rows.size());
+			for (unsigned int ci = 0; ci < columns.size(); ++ci)
+				basis.setStructStatus(ci, structural_status[columns[ci]]);
+			for (unsigned int ri = 0; ri < rows.size(); ++ri)
+				basis.setArtifStatus(ri, artificial_status[rows[ri]]);
+			coarse->setWarmStart(&basis);
+			coarse->resolve();
+		} else {
+			coarse->initialSolve();
+		}
+		stats.coarse_iterations += coarse->getIterationCount();
+		if (coarse->isProvenOptimal() == false) {
+			delete coarse;
+			return (false);
+		}
+		solved = true;
+
+		CoinWarmStartBasis* basis =
+			dynamic_cast<CoinWarmStartBasis*>(coarse->getWarmStart());
+		if (basis != NULL) {
+			for (unsigned int ci = 0; ci < columns.size(); ++ci)
+				structural_status[columns[ci]] = basis->getStructStatus(ci);
+			for (unsigned int ri = 0; ri < rows.size(); ++ri)
+				artificial_status[rows[ri]] = basis->getArtifStatus(ri);
+		}
+		delete basis;
+		const double* column_solution = coarse->getColSolution();
+		for (unsigned int ci = 0; ci < columns.size(); ++ci)
+			primal[columns[ci]] = column_solution[ci];
+		delete coarse;
+	}
+	if (solved == false)
+		return (false);
+
+	// Lift rho and the weights, with xi_n = max(0, rho - min_cl
+	// margin_{n,cl}) of all samples.
+	std::vector<std::vector<double> > alpha(norm1_rows,
+		std::vector<double>(number_classifiers));
+	for (unsigned int m = 0; m < number_classifiers; ++m) {
+		for (unsigned int ci = 0; ci < norm1_rows; ++ci)
+			alpha[ci][m] = primal[AlphaColumn(m) + ci];
+	}
+	std::vector<double> margins;
+	SampleMargins(alpha, margins);
+	for (unsigned int n = 0; n < sample_labels.size(); ++n)
+		primal[XiColumn(n)] = std::max(0.0, primal[0] - margins[n]);
+	si->setColSolution(&primal[0]);
+
+	CoinWarmStartBasis basis;
+	basis.setSize(si->getNumCols(), si->getNumRows());
+	for (int ci = 0; ci < si->getNumCols(); ++ci)
+		basis.setStructStatus(ci, structural_status[ci]);
+	for (int ri = 0; ri < si->getNumRows(); ++ri)
+		basis.setArtifStatus(ri, artificial_status[ri]);
+	return (si->setWarmStart(&basis));
+}
+
+void LPBoostMulticlassClassifier::CoarseSamples(double fraction,
+	std::vector<unsigned int>& samples) const {
+	// Each class in a fixed pseudo-random order, such that the samples of
+	// a level include those of all smaller levels.
+	std::vector<std::vector<std::pair<uint64_t, unsigned int> > >
+		class_order(number_classes);
+	for (unsigned int n = 0; n < sample_labels.size(); ++n) {
+		class_order[sample_labels[n]].push_back(std::make_pair(
+			HashBytes(14695981039346656037ull, &n, sizeof(n)), n));
+	}
+	samples.clear();
+	for (int cl = 0; cl < number_classes; ++cl) {
+		std::sort(class_order[cl].begin(), class_order[cl].end());
+		unsigned int count = static_cast<unsigned int>(
+			ceil(fraction * class_order[cl].size()));
+		for (unsigned int ci = 0; ci < count; ++ci)
+			samples.push_back(class_order[cl][ci].second);
+	}
+	std::sort(samples.begin(), samples.end());
+}
+
+OsiSolverInterface* LPBoostMulticlassClassifier::CoarseProblem(
+	const std::vector<unsigned int>& samples, std::vector<int>& rows,
+	std::vector<int>& columns) const {
+	// Rows: the norm-1 rows, then the margin rows of the samples.
+	// Columns: rho, the xi of the samples, then all weight columns.
+	rows.clear();
+	for (unsigned int ri = 0; ri < norm1_rows; ++ri)
+		rows.push_back(ri);
+	columns.assign(1, 0);
+	for (unsigned int sn = 0; sn < samples.size(); ++sn) {
+		unsigned int n = samples[sn];
+		unsigned int first_row = MarginRow(n, sample_labels[n] == 0 ? 1 : 0);
+		for (int ri = 0; ri < number_classes - 1; ++ri)
+			rows.push_back(first_row + ri);
+		columns.push_back(XiColumn(n));
+	}
+	std::vector<bool> xi_column(si->getNumCols(), false);
+	for (unsigned int n = 0; n < sample_labels.size(); ++n)
+		xi_column[XiColumn(n)] = true;
+	for (int ci = 1; ci < si->getNumCols(); ++ci) {
+		if (xi_column[ci] == false)
+			columns.push_back(ci);
+	}
+	std::vector<int> row_map(si->getNumRows(), -1);
+	for (unsigned int ri = 0; ri < rows.size(); ++ri)
+		row_map[rows[ri]] = ri;
+
+	const CoinPackedMatrix* matrix = si->getMatrixByCol();
+	CoinBigIndex number_elements = 0;
+	for (unsigned int ci = 0; ci < columns.size(); ++ci) {
+		CoinShallowPackedVector col = matrix->getVector(columns[ci]);
+		for (int ei = 0; ei < col.getNumElements(); ++ei)
+			number_elements += (row_map[col.getIndices()[ei]] >= 0);
+	}
+	double* elements = new double[number_elements];
+	int* indices = new int[number_elements];
+	CoinBigIndex* starts = new CoinBigIndex[columns.size() + 1];
+	int* lengths = new int[columns.size()];
+	double* column_lower = new double[columns.size()];
+	double* column_upper = new double[columns.size()];
+	double* objective = new double[columns.size()];
+	CoinBigIndex element = 0;
+	for (unsigned int ci = 0; ci < columns.size(); ++ci) {
+		CoinShallowPackedVector col = matrix->getVector(columns[ci]);
+		starts[ci] = element;
+		for (int ei = 0; ei < col.getNumElements(); ++ei) {
+			int row = row_map[col.getIndices()[ei]];
+			if (row < 0)
+				continue;
+			indices[element] = row;
+			elements[element++] = col.getElements()[ei];
+		}
+		lengths[ci] = element - starts[ci];
+		column_lower[ci] = si->getColLower()[columns[ci]];
+		column_upper[ci] = si->getColUpper()[columns[ci]];
+		objective[ci] = si->getObjCoefficients()[columns[ci]];
+	}
+	starts[columns.size()] = number_elements;
+
+	// The slack penalty of the subsample, D = 1 / (nu N_coarse)
+	double slack_penalty = 1.0 / (nu * static_cast<double>(samples.size()));
+	for (unsigned int ci = 1; ci <= samples.size(); ++ci)
+		objective[ci] = slack_penalty;
+
+	double* row_lower = new double[rows.size()];
+	double* row_upper = new double[rows.size()];
+	for (unsigned int ri = 0; ri < rows.size(); ++ri) {
+		row_lower[ri] = si->getRowLower()[rows[ri]];
+		row_upper[ri] = si->getRowUpper()[rows[ri]];
+	}
+
+	CoinPackedMatrix* coarse_matrix = new CoinPackedMatrix();
+	coarse_matrix->assignMatrix(true, rows.size(), columns.size(),
+		number_elements, elements, indices, starts, lengths);
+	OsiSolverInterface* coarse = si->clone(false);
+	coarse->assignProblem(coarse_matrix, column_lower, column_upper,
+		objective, row_lower, row_upper);
+	coarse->setObjSense(1);
+	OsiClpSolverInterface* clp_coarse =
+		dynamic_cast<OsiClpSolverInterface*>(coarse);
+	if (clp_coarse != NULL && lp_scaling >= 0)
+		clp_coarse->getModelPtr()->scaling(lp_scaling);
+	return (coarse);
+}
+
+void LPBoostMulticlassClassifier::SetClassGroups(
+	const std::vector<int>& class_groups) {
+	assert(class_groups.size() == static_cast<unsigned int>(number_classes));
+	assert(number_classifiers == 0);
+
+	// Number the groups by first appearance
+	std::map<int, int> group_ids;
+	std::vector<int> groups(number_classes);
+	for (int cl = 0; cl < number_classes; ++cl) {
+		if (group_ids.count(class_groups[cl]) == 0) {
+			int id = group_ids.size();
+			group_ids[class_groups[cl]] = id;
+		}
+		groups[cl] = group_ids[class_groups[cl]];
+	}
+
+	// One group is weight sharing, K groups no weight sharing.
+	weight_sharing = (group_ids.size() == 1);
+	single_group = weight_sharing;
+	this->class_groups.clear();
+	if (group_ids.size() > 1 &&
+		group_ids.size() < static_cast<unsigned int>(number_classes))
+		this->class_groups = groups;
+
+	// The norm-1 rows and columns per weak learner changed.
+	if (initialized) {
+		std::vector<int> labels(sample_labels);
+		std::string solver(solver_name);
+		InitializeBoosting(labels, use_interior_point, solver, formulation);
+	}
+}
+
+std::vector<int> LPBoostMulticlassClassifier::GroupClassesByConfusion(
+	const std::vector<std::vector<double> >& confusion,
+	unsigned int number_groups) {
+	unsigned int number_classes = confusion.size();
+	assert(number_groups >= 1 && number_groups <= number_classes);
+
+	// Symmetric confusion rate of two classes, the fraction of the samples
+	// of each predicted as the other.
+	std::vector<double> class_total(number_classes, 0.0);
+	for (unsigned int a = 0; a < number_classes; ++a) {
+		assert(confusion[a].size() == number_classes);
+		for (unsigned int b = 0; b < number_classes; ++b)
+			class_total[a] += confusion[a][b];
+	}
+	std::vector<std::vector<double> > rate(number_classes,
+		std::vector<double>(number_classes, 0.0));
+	for (unsigned int a = 0; a < number_classes; ++a) {
+		for (unsigned int b = 0; b < number_classes; ++b) {
+			if (a != b && class_total[a] > 0.0)
+				rate[a][b] += confusion[a][b] / class_total[a];
+			if (a != b && class_total[b] > 0.0)
+				rate[a][b] += confusion[b][a] / class_total[b];
+		}
+	}
+
+	// Average linkage: merge the two groups with the largest mean rate over
+	// their class pairs, until number_groups remain.  Merging into the
+	// lower group keeps the groups ordered by their first class.
+	std::vector<std::vector<unsigned int> > groups(number_classes);
+	for (unsigned int a = 0; a < number_classes; ++a)
+		groups[a].push_back(a);
+	while (groups.size() > number_groups) {
+		unsigned int best_g = 0;
+		unsigned int best_h = 1;
+		double best_linkage = -1.0;
+		for (unsigned int g = 0; g < groups.size(); ++g) {
+			for (unsigned int h = g + 1; h < groups.size(); ++h) {
+				double linkage = 0.0;
+				for (unsigned int ai = 0; ai < groups[g].size(); ++ai) {
+					for (unsigned int bi = 0; bi < groups[h].size(); ++bi)
+						linkage += rate[groups[g][ai]][groups[h][bi]];
+				}
+				linkage /= groups[g].size() * groups[h].size();
+				if (linkage > best_linkage) {
+					best_linkage = linkage;
+					best_g = g;
+					best_h = h;
+				}
+			}
+		}
+		groups[best_g].insert(groups[best_g].end(), groups[best_h].begin(),
+			groups[best_h].end());
+		groups.erase(groups.begin() + best_h);
+	}
+
+	std::vector<int> class_groups(number_classes);
+	for (unsigned int g = 0; g < groups.size(); ++g) {
+		for (unsigned int ai = 0; ai < groups[g].size(); ++ai)
+			class_groups[groups[g][ai]] = g;
+	}
+	return (class_groups);
+}
+
+void LPBoostMulticlassClassifier::RowActivities(
+	std::vector<double>& activity) const {
+	// The row activities of si are stale after a barrier solution was
+	// copied in, compute them from the column solution.
+	const double* column_solution = si->getColSolution();
+	const CoinPackedMatrix* matrix = si->getMatrixByCol();
+	activity.assign(si->getNumRows(), 0.0);
+	for (int ci = 0; ci < si->getNumCols(); ++ci) {
+		double x = column_solution[ci];
+		if (x == 0.0)
+			continue;
+		CoinShallowPackedVector col = matrix->getVector(ci);
+		for (int ei = 0; ei < col.getNumElements(); ++ei)
+			activity[col.getIndices()[ei]] += col.getElements()[ei] * x;
+	}
+}
+
+const std::vector<std::vector<double> >&
+LPBoostMulticlassClassifier::MarginDistribution() const {
+	return (margin_distribution);
+}
+
+void LPBoostMulticlassClassifier::SetMarginDistribution(
+	const double* weights, unsigned int first_row) {
+	margin_distribution.resize(sample_labels.size());
+	for (unsigned int n = 0; n < sample_labels.size(); ++n) {
+		margin_distribution[n].assign(number_classes, 0.0);
+		for (int cl = 0; cl < number_classes; ++cl) {
+			if (cl == sample_labels[n])
+				continue;
+			// Clamp round-off of the solver below zero
+			margin_distribution[n][cl] =
+				std::max(0.0, weights[MarginRow(n, cl) - first_row]);
+		}
+	}
+}
+
+void LPBoostMulticlassClassifier::SetEntropyTolerance(double epsilon) {
+	assert(epsilon > 0.0);
+	entropy_epsilon = epsilon;
+}
+
+unsigned int LPBoostMulticlassClassifier::EntropyIterationBound(
+	unsigned int number_samples, double nu, double epsilon) {
+	return (static_cast<unsigned int>(ceil(32.0 / (epsilon * epsilon)
+		* log(number_samples / nu))));
+}
+
+void LPBoostMulticlassClassifier::UpdateEntropyRegularized() {
+	unsigned int number_rows = PrimalRows() - norm1_rows;
+	unsigned int number_columns = number_classifiers * norm1_rows;
+	double eta = std::max(0.5, 2.0 / entropy_epsilon
+		* log(sample_labels.size() / nu));
+
+	// Margin rows of the weak learner columns j = m * norm1_rows + ci, in
+	// compressed column format.
+	const CoinPackedMatrix* matrix = PrimalMatrixByColumn();
+	std::vector<unsigned int> col_start(number_columns + 1, 0);
+	std::vector<unsigned int> col_rows;
+	std::vector<double> col_values;
+	col_rows.reserve(matrix->getNumElements());
+	col_values.reserve(matrix->getNumElements());
+	for (unsigned int m = 0; m < number_classifiers; ++m) {
+		for (unsigned int ci = 0; ci < norm1_rows; ++ci) {
+			CoinShallowPackedVector col = matrix->getVector(AlphaColumn(m) + ci);
+			for (int ei = 0; ei < col.getNumElements(); ++ei) {
+				if (col.getIndices()[ei] < static_cast<int>(norm1_rows))
+					continue;	// the |alpha|_1 = 1 row
+				col_rows.push_back(col.getIndices()[ei] - norm1_rows);
+				col_values.push_back(col.getElements()[ei]);
+			}
+			col_start[m * norm1_rows + ci + 1] = col_rows.size();
+		}
+	}
+
+	// Start from the previous weights, weak learners added since at zero.
+	// Otherwise, or without any previous weight, uniform.
+	std::vector<double> alpha(number_columns, 0.0);
+	for (unsigned int ci = 0; ci < norm1_rows; ++ci) {
+		double weight_sum = 0.0;
+		if (classifier_weights.size() == norm1_rows) {
+			for (unsigned int m = 0; m < classifier_weights[ci].size() &&
+				m < number_classifiers; ++m) {
+				weight_sum += std::max(0.0, classifier_weights[ci][m]);
+			}
+		}
+		for (unsigned int m = 0; m < number_classifiers; ++m) {
+			if (weight_sum > 0.0) {
+				alpha[m * norm1_rows + ci] =
+					(m < classifier_weights[ci].size()) ? std::max(0.0,
+					classifier_weights[ci][m]) / weight_sum : 0.0;
+			} else {
+				alpha[m * norm1_rows + ci] = 1.0 / number_classifiers;
+			}
+		}
+	}
+
+	// z = A alpha, the margins of all constraint rows
+	std::vector<double> z(number_rows, 0.0);
+	for (unsigned int j = 0; j < number_columns; ++j) {
+		if (alpha[j] == 0.0)
+			continue;
+		for (unsigned int ei = col_start[j]; ei < col_start[j + 1]; ++ei)
+			z[col_rows[ei]] += alpha[j] * col_values[ei];
+	}
+
+	// Maximize the concave f(alpha) = min_d d' A alpha + 1/eta KL(d), whose
+	// gradient A' d(alpha) holds the edges of the weak learners.  Frank-Wolfe
+	// moves towards the best weak learner of each simplex, the duality gap
+	// bounds the distance to the optimum.
+	const unsigned int max_iterations = 10000;
+	std::vector<double> d;
+	std::vector<double> edges(number_columns);
+	std::vector<unsigned int> best(norm1_rows);
+	std::vector<double> dz(number_rows);
+	std::vector<double> z_step(number_rows);
+	std::vector<double> d_step;
+	unsigned int iteration = 0;
+	for (; iteration < max_iterations; ++iteration) {
+		EntropyDistribution(z, eta, d);
+		for (unsigned int j = 0; j < number_columns; ++j) {
+			edges[j] = 0.0;
+			for (unsigned int ei = col_start[j]; ei < col_start[j + 1]; ++ei)
+				edges[j] += d[col_rows[ei]] * col_values[ei];
+		}
+		double gap = 0.0;
+		for (unsigned int ci = 0; ci < norm1_rows; ++ci) {
+			best[ci] = ci;
+			double current_edge = 0.0;
+			for (unsigned int j = ci; j < number_columns; j += norm1_rows) {
+				if (edges[j] > edges[best[ci]])
+					best[ci] = j;
+				current_edge += alpha[j] * edges[j];
+			}
+			gap += edges[best[ci]] - current_edge;
+		}
+		if (gap <= 0.5 * entropy_epsilon)
+			break;
+
+		// Direction towards the vertex s of the best learners, A s - z.
+		for (unsigned int r = 0; r < number_rows; ++r)
+			dz[r] = -z[r];
+		for (unsigned int ci = 0; ci < norm1_rows; ++ci) {
+			unsigned int j = best[ci];
+			for (unsigned int ei = col_start[j]; ei < col_start[j + 1]; ++ei)
+				dz[col_rows[ei]] += col_values[ei];
+		}
+
+		// Line search on the decreasing derivative d(z + step dz)' dz.
+		double step_low = 0.0;
+		double step_high = 1.0;
+		for (unsigned int bisect = 0; bisect < 30; ++bisect) {
+			double step = (bisect == 0) ? 1.0 : 0.5 * (step_low + step_high);
+			for (unsigned int r = 0; r < number_rows; ++r)
+				z_step[r] = z[r] + step * dz[r];
+			EntropyDistribution(z_step, eta, d_step);
+			double derivative = 0.0;
+			for (unsigned int r = 0; r < number_rows; ++r)
+				derivative += d_step[r] * dz[r];
+			if (derivative >= 0.0) {
+				step_low = step;
+				if (bisect == 0)
+					break;	// full step
+			} else {
+				step_high = step;
+			}
+		}
+		double step = step_low;
+		if (step == 0.0)
+			step = 0.5 * step_high;	// guarantee progress
+
+		for (unsigned int j = 0; j < number_columns; ++j)
+			alpha[j] *= 1.0 - step;
+		for (unsigned int ci = 0; ci < norm1_rows; ++ci)
+			alpha[best[ci]] += step;
+		for (unsigned int r = 0; r < number_rows; ++r)
+			z[r] += step * dz[r];
+	}
+	stats.solver_iterations = iteration;
+	if (iteration == max_iterations) {
+		std::cerr << "Entropy regularized solve stopped after "
+			<< max_iterations << " iterations, before reaching tolerance "
+			<< (0.5 * entropy_epsilon) << "." << std::endl;
+		EntropyDistribution(z, eta, d);
+	}
+
+	classifier_weights.resize(norm1_rows);
+	for (unsigned int ci = 0; ci < norm1_rows; ++ci) {
+		classifier_weights[ci].resize(number_classifiers);
+		for (unsigned int m = 0; m < number_classifiers; ++m)
+			classifier_weights[ci][m] = alpha[m * norm1_rows + ci];
+	}
+	ExpandClassifierWeights();
+	SetMarginDistribution(&d[0], norm1_rows);
+
+	// Soft margin of the weights: the optimal rho and its objective
+	// rho - D \sum_n max(0, rho - margin_n).
+	std::vector<double> margins;
+	SampleMargins(classifier_weights, margins);
+	rho = OptimalRho(margins);
+	double slack_penalty = 1.0 /
+		(nu * static_cast<double>(sample_labels.size()));
+	gamma = rho;
+	for (unsigned int n = 0; n < margins.size(); ++n)
+		gamma -= slack_penalty * std::max(0.0, rho - margins[n]);
+}
+
+void LPBoostMulticlassClassifier::EntropyDistribution(
+	const std::vector<double>& z, double eta, std::vector<double>& d) const {
+	unsigned int number_samples = sample_labels.size();
+	unsigned int rows_per_sample = number_classes - 1;
+	double log_cap = log(1.0 / (nu * static_cast<double>(number_samples)));
+	double cap = exp(log_cap);
+
+	// Unconstrained, d_r is proportional to exp(-eta z_r).  Within a sample
+	// that stays so with the cap D on the sample's total; the masses of the
+	// samples follow by capping the heaviest ones at D and sharing the rest
+	// proportionally.  All in the log domain, eta z easily underflows.
+	std::vector<std::pair<double, unsigned int> > log_mass(number_samples);
+	for (unsigned int n = 0; n < number_samples; ++n) {
+		const double* zn = &z[n * rows_per_sample];
+		double max_exponent = -eta * zn[0];
+		for (unsigned int ri = 1; ri < rows_per_sample; ++ri)
+			max_exponent = std::max(max_exponent, -eta * zn[ri]);
+		double sum = 0.0;
+		for (unsigned int ri = 0; ri < rows_per_sample; ++ri)
+			sum += exp(-eta * zn[ri] - max_exponent);
+		log_mass[n] = std::make_pair(max_exponent + log(sum), n);
+	}
+	std::vector<std::pair<double, unsigned int> > order(log_mass);
+	std::sort(order.begin(), order.end());
+	std::reverse(order.begin(), order.end());
+
+	// suffix[k]: log of the total mass of the samples order[k..N-1]
+	std::vector<double> suffix(number_samples + 1);
+	suffix[number_samples] = -std::numeric_limits<double>::infinity();
+	for (unsigned int k = number_samples; k-- > 0; ) {
+		double a = order[k].first;
+		double b = suffix[k + 1];
+		suffix[k] = (b == -std::numeric_limits<double>::infinity()) ? a :
+			std::max(a, b) + log1p(exp(-fabs(a - b)));
+	}
+	unsigned int capped = 0;
+	double log_scale = -std::numeric_limits<double>::infinity();
+	while (capped < number_samples) {
+		double remaining = 1.0 - capped * cap;
+		if (remaining <= 0.0) {
+			log_scale = -std::numeric_limits<double>::infinity();
+			break;
+		}
+		log_scale = log(remaining) - suffix[capped];
+		if (order[capped].first + log_scale <= log_cap)
+			break;
+		capped += 1;
+	}
+
+	d.resize(z.size());
+	for (unsigned int k = 0; k < number_samples; ++k) {
+		unsigned int n = order[k].second;
+		double log_sample_mass = (k < capped) ? log_cap :
+			log_mass[n].first + log_scale;
+		const double* zn = &z[n * rows_per_sample];
+		double* dn = &d[n * rows_per_sample];
+		for (unsigned int ri = 0; ri < rows_per_sample; ++ri) {
+			dn[ri] = exp(log_sample_mass - eta * zn[ri]
+				- log_mass[n].first);
+		}
+	}
+}
+
+void LPBoostMulticlassClassifier::SetValidationSet(
+	const std::vector<int>& labels, unsigned int threads) {
+	assert(labels.empty() == false);
+	assert(*std::min_element(labels.begin(), labels.end()) >= 0);
+	assert(*std::max_element(labels.begin(), labels.end()) < number_classes);
+	assert(threads >= 1);
+
+	validation_labels = labels;
+	validation_threads = threads;
+	validation_responses.clear();
+	validation_registered.clear();
+	validation_weights.clear();
+	validation_scores.assign(labels.size() * number_classes, 0.0);
+	validation.accuracy = 0.0;
+	validation.margins.assign(labels.size(), 0.0);
+	validation.learners_changed = 0;
+	validation.seconds = 0.0;
+}
+
+void LPBoostMulticlassClassifier::AddValidationResponse(
+	unsigned int learner_id,
+	const std::vector<std::vector<double> >& response) {
+	assert(validation_labels.empty() == false);
+	assert(response.size() == validation_labels.size());
+
+	// Redundant weak learners map to an existing id, keep the first.
+	if (learner_id < validation_registered.size() &&
+		validation_registered[learner_id])
+		return;
+
+	size_t learner_size = validation_labels.size() * number_classes;
+	if (learner_id >= validation_registered.size()) {
+		validation_registered.resize(learner_id + 1, false);
+		validation_responses.resize((learner_id + 1) * learner_size, 0.0);
+	}
+	// Scored with the classifier weights, hence in the normalized scale
+	assert(learner_id < response_scales.size());
+	double scale = response_scales[learner_id];
+	double* dest = &validation_responses[learner_id * learner_size];
+	for (unsigned int n = 0; n < validation_labels.size(); ++n) {
+		assert(response[n].size() == static_cast<unsigned int>(number_classes));
+		for (int cl = 0; cl < number_classes; ++cl)
+			dest[n * number_classes + cl] = scale * response[n][cl];
+	}
+	validation_registered[learner_id] = true;
+}
+
+const LPBoostMulticlassClassifier::ValidationResult&
+LPBoostMulticlassClassifier::Validation() const {
+	return (validation);
+}
+
+void LPBoostMulticlassClassifier::UpdateValidation() {
+	boost::posix_time::ptime start =
+		boost::posix_time::microsec_clock::universal_time();
+
+	// Weight changes of the weak learners with a validation response; the
+	// scores hold the weights of the previous update, zero for new ones.
+	validation_weights.resize(classifier_weights.size());
+	std::vector<ValidationDelta> deltas;
+	for (unsigned int ci = 0; ci < classifier_weights.size(); ++ci) {
+		validation_weights[ci].resize(number_classifiers, 0.0);
+		for (unsigned int m = 0; m < number_classifiers; ++m) {
+			if (m >= validation_registered.size() ||
+				validation_registered[m] == false)
+				continue;
+			double delta = classifier_weights[ci][m] - validation_weights[ci][m];
+			if (delta == 0.0)
+				continue;
+			ValidationDelta vd;
+			vd.m = m;
+			vd.ci = ci;
+			vd.delta = delta;
+			deltas.push_back(vd);
+			validation_weights[ci][m] = classifier_weights[ci][m];
+		}
+	}
+
+	// Each thread takes a contiguous block of samples.
+	unsigned int number_samples = validation_labels.size();
+	unsigned int threads = std::min(validation_threads, number_samples);
+	std::vector<unsigned int> correct(threads, 0);
+	if (threads == 1) {
+		ValidationWorker(&deltas, 0, number_samples, &correct[0]);
+	} else {
+		boost::thread_group workers;
+		for (unsigned int ti = 0; ti < threads; ++ti) {
+			workers.create_thread(boost::bind(
+				&LPBoostMulticlassClassifier::ValidationWorker, this, &deltas,
+				(ti * number_samples) / threads,
+				((ti + 1) * number_samples) / threads, &correct[ti]));
+		}
+		workers.join_all();
+	}
+
+	unsigned int correct_total = 0;
+	for (unsigned int ti = 0; ti < threads; ++ti)
+		correct_total += correct[ti];
+	validation.accuracy = static_cast<double>(correct_total) / number_samples;
+	validation.learners_changed = deltas.size();
+	validation.seconds = (boost::posix_time::microsec_clock::universal_time()
+		- start).total_microseconds() * 1e-6;
+}
+
+void LPBoostMulticlassClassifier::ValidationWorker(
+	const std::vector<ValidationDelta>* deltas,
+	unsigned int n_begin, unsigned int n_end, unsigned int* correct) {
+	size_t learner_size = validation_labels.size() * number_classes;
+	for (unsigned int di = 0; di < deltas->size(); ++di) {
+		const ValidationDelta& vd = (*deltas)[di];
+		const double* resp = &validation_responses[vd.m * learner_size];
+		if (weight_sharing) {
+			// score_{n,cl} += delta h_{cl}(x_n)
+			for (size_t ei = n_begin * number_classes;
+				ei < n_end * number_classes; ++ei)
+				validation_scores[ei] += vd.delta * resp[ei];
+		} else if (class_groups.empty() == false) {
+			// score_{n,cl} += delta_g h_{cl}(x_n), for the classes of group g
+			for (int cl = 0; cl < number_classes; ++cl) {
+				if (class_groups[cl] != static_cast<int>(vd.ci))
+					continue;
+				for (size_t ei = n_begin * number_classes + cl;
+					ei < n_end * number_classes; ei += number_classes)
+					validation_scores[ei] += vd.delta * resp[ei];
+			}
+		} else {
+			// score_{n,ci} += delta_ci h_{ci}(x_n)
+			for (size_t ei = n_begin * number_classes + vd.ci;
+				ei < n_end * number_classes; ei += number_classes)
+				validation_scores[ei] += vd.delta * resp[ei];
+		}
+	}
+
+	unsigned int correct_count = 0;
+	for (unsigned int n = n_begin; n < n_end; ++n) {
+		const double* score = &validation_scores[n * number_classes];
+		int y = validation_labels[n];
+		double best_other = -std::numeric_limits<double>::infinity();
+		for (int cl = 0; cl < number_classes; ++cl) {
+			if (cl != y)
+				best_other = std::max(best_other, score[cl]);
+		}
+		validation.margins[n] = score[y] - best_other;
+		if (validation.margins[n] > 0.0)
+			correct_count += 1;
+	}
+	*correct = correct_count;
+}
+
+void LPBoostMulticlassClassifier::WriteMPS(const std::string& mpsfile) const {
+	si->writeMps(mpsfile.c_str(), "mps", si->getObjSense());
+}
+
+const std::vector<std::vector<double> >&
+LPBoostMulticlassClassifier::ClassifierWeights() const {
+	if ((class_groups.empty() && single_group == false) ||
+		classifier_weights.empty())
+		return (classifier_weights);
+	return (expanded_weights);
+}
+
+void LPBoostMulticlassClassifier::ExpandClassifierWeights() {
+	if ((class_groups.empty() && single_group == false) ||
+		classifier_weights.empty()) {
+		expanded_weights.clear();
+		return;
+	}
+
+	// One weight vector per class, that of its group
+	expanded_weights.resize(number_classes);
+	for (int cl = 0; cl < number_classes; ++cl) {
+		expanded_weights[cl] =
+			classifier_weights[class_groups.empty() ? 0 : class_groups[cl]];
+	}
 }
 
 double LPBoostMulticlassClassifier::Rho() const {
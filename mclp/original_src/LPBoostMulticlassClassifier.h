@@ -8,11 +8,25 @@
 
 #include <vector>
 #include <string>
+#include <map>
+#include <deque>
+
+#include <stdint.h>
+#include <stddef.h>
 
 #include <OsiSolverInterface.hpp>
+#include <CoinPackedVector.hpp>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+
+class CoinPackedMatrix;
+class OsiClpSolverInterface;
 
 namespace Boosting {
 
+class SolverRace;
+
 class LPBoostMulticlassClassifier {
 public:
 	/* number_classes: Number of classes in the multiclass problem.
@@ -24,23 +38,368 @@ public:
 		bool weight_sharing = true);
 	~LPBoostMulticlassClassifier();
 
+	/* The LP solved by Update().
+	 *
+	 * PrimalFormulation: the weights are the LP variables, with one margin
+	 *    constraint per sample and wrong class, N (K-1) rows.
+	 * DualFormulation: the weights of the margin constraints, a
+	 *    distribution over the samples, are the LP variables, with one
+	 *    constraint per weak learner weight.  Smaller for N (K-1) much
+	 *    larger than the number of weights, and a new weak learner adds a
+	 *    cutting plane row, resolved by dual simplex from the last basis.
+	 *
+	 * Both give the same ClassifierWeights(), Rho() and Gamma(), in the dual
+	 * formulation from the multipliers of its rows.
+	 *
+	 * EntropyRegularizedFormulation: ERLPBoost.  The distribution over the
+	 *    margin constraints is regularized by its relative entropy to the
+	 *    uniform distribution, weighted 1/eta with
+	 *    eta = max(1/2, 2/epsilon ln(N/nu)), see SetEntropyTolerance.  The
+	 *    distribution then moves smoothly as weak learners are added instead
+	 *    of jumping between LP vertices, and boosting is within epsilon of
+	 *    the optimal soft margin after at most EntropyIterationBound weak
+	 *    learners.  Solved by Frank-Wolfe over the weight simplices to
+	 *    accuracy epsilon/2, the LP only stores the constraint columns.
+	 *    Rho() and Gamma() are the soft margin of the weights found.
+	 */
+	enum Formulation {
+		PrimalFormulation,
+		DualFormulation,
+		EntropyRegularizedFormulation
+	};
+
 	/* labels: (N,1) vector of class id, 0 <= labels[i] < number_classes.
 	 * interior_point: If true, we use the interior-point solver of Clp in
 	 *   order to produce central solutions.  If false, we use the simplex
 	 *   solver.
+	 * formulation: LP formulation to solve, see Formulation.
 	 */
 	void InitializeBoosting(const std::vector<int>& labels,
 		bool interior_point = false,
-		const std::string& solver = "clp");
+		const std::string& solver = "clp",
+		Formulation formulation = PrimalFormulation);
+
+	/* Start a new training job on this instance, as if newly constructed
+	 * with number_classes, nu and weight_sharing and initialized with
+	 * InitializeBoosting.  The weak learners, validation set and statistics
+	 * are dropped, the Set* options are kept except for the class groups,
+	 * replaced by weight_sharing.  The Clp solver is kept and the new
+	 * problem loaded into it, and the scratch buffers are reused, so that
+	 * a long-lived process training many small problems does not pay their
+	 * setup for every job.
+	 */
+	void Reset(int number_classes, double nu, bool weight_sharing,
+		const std::vector<int>& labels,
+		bool interior_point = false,
+		const std::string& solver = "clp",
+		Formulation formulation = PrimalFormulation);
 
 	/* response: N vector of number_classes responses
+	 *
+	 * Returns the id of the weak learner, its index in the classifier
+	 * weights.  If the learner is rejected as redundant (see
+	 * SetRedundancyCheck), the id of the existing learner replacing it is
+	 * returned instead.
 	 */
-	void AddMulticlassClassifier(
+	unsigned int AddMulticlassClassifier(
 		const std::vector<std::vector<double> >& response);
 
-	/* (Re-)solve the LPBoost multiclass problem
+	/* Dense (N,K) response read in place from caller memory: the response
+	 *    of sample n to class cl is
+	 *    response[n * sample_stride + cl * class_stride], strides counted in
+	 *    elements.  Row-major arrays have strides (K, 1), column-major ones
+	 *    (1, N).  Instantiated for float and double.
+	 * The margin columns are built straight from this memory, no copy of
+	 * the response is made.
+	 */
+	template <typename T>
+	unsigned int AddMulticlassClassifier(const T* response,
+		ptrdiff_t sample_stride, ptrdiff_t class_stride);
+
+	/* Sparse (N,K) response in compressed row format: the non-zero
+	 *    responses of sample n are values[sample_start[n]] to
+	 *    values[sample_start[n+1]-1] for the classes given in classes, all
+	 *    other responses are zero.  sample_start has N+1 elements.  A
+	 *    class listed more than once for a sample has the sum of its
+	 *    values.
+	 * Only non-zero margin coefficients are added to the LP, so one-hot and
+	 * abstaining weak learners produce a much sparser constraint matrix.
+	 */
+	unsigned int AddMulticlassClassifierSparse(
+		const std::vector<unsigned int>& sample_start,
+		const std::vector<int>& classes, const std::vector<double>& values);
+
+	/* Append samples to the current problem, without rebuilding it.
+	 *
+	 * labels: (N',1) vector of class ids of the new samples.
+	 * responses: for every weak learner id added so far, the N' vector of
+	 *    number_classes responses on the new samples.
+	 *
+	 * Adds a xi variable and K-1 margin constraints per sample and updates
+	 * the slack penalty 1/(nu N) to the new N.  The next simplex Update()
+	 * continues from the previous basis.
+	 */
+	void AddSamples(const std::vector<int>& labels,
+		const std::vector<std::vector<std::vector<double> > >& responses);
+
+	/* Per weak learner normalization of the responses, set before adding
+	 * weak learners.  Responses on very different scales (probabilities,
+	 * SVM scores, vote counts) make the LP badly scaled, costing simplex
+	 * iterations and barrier accuracy.
+	 *
+	 * NoNormalization: the responses are used as given (default).
+	 * MaxAbsNormalization: the margin coefficients of the weak learner,
+	 *    h_y - h_k with weight sharing and the responses h_k without, are
+	 *    scaled to at most one in magnitude.
+	 * MarginStdNormalization: they are scaled to unit standard deviation
+	 *    over all margin rows.
+	 *
+	 * The scale of each weak learner is fixed when it is added and also
+	 * applied to its responses passed to AddSamples and
+	 * AddValidationResponse.  ClassifierWeights() and SetInitialWeights
+	 * are in the normalized scale, see RawClassifierWeights.
+	 */
+	enum ResponseNormalization {
+		NoNormalization,
+		MaxAbsNormalization,
+		MarginStdNormalization
+	};
+	void SetResponseNormalization(ResponseNormalization normalization);
+
+	/* Scale factor of each weak learner's responses, all one without
+	 * normalization.
+	 */
+	const std::vector<double>& ResponseScales() const;
+
+	/* Cache of solved problems on disk.  Entries are keyed by a hash of
+	 * the labels, the weak learner columns in the order added (after
+	 * normalization), nu, the weight layout, the formulation and the
+	 * solver.  Update() on a cached problem restores the weights, rho,
+	 * gamma and margin distribution without solving.  With the simplex
+	 * solver the optimal basis is stored too, and the first Update() of a
+	 * problem extending a cached one by further weak learners starts from
+	 * that basis.
+	 *
+	 * directory: cache directory, created if missing.  Empty disables the
+	 *    cache.  It may be shared by concurrent runs.
+	 * max_bytes: the least recently used entries are removed beyond this
+	 *    total size.
+	 */
+	void SetSolutionCache(const std::string& directory,
+		uint64_t max_bytes = static_cast<uint64_t>(1) << 30);
+
+	/* Scaling of the LP rows and columns by Clp: 0 off, 1 equilibrium,
+	 * 2 geometric, 3 automatic, or -1 to keep the default of Clp.
+	 */
+	void SetLPScaling(int mode);
+
+	/* Reject redundant weak learners when they are added.  Must be set
+	 * before the first weak learner is added.
+	 *
+	 * epsilon: a learner whose margin columns differ by at most epsilon
+	 *    (max-norm) from those of an existing learner is a duplicate.
+	 *    Candidates are found by hashing the columns quantized to a grid of
+	 *    width epsilon, hence near-duplicates are occasionally missed.
+	 * check_dominated: also reject a learner whose margin coefficients are
+	 *    all at most those of an existing learner plus epsilon.  Its weight
+	 *    can always be moved to the existing learner without decreasing any
+	 *    margin.  This compares against every stored learner.
+	 */
+	void SetRedundancyCheck(bool enable, double epsilon = 0.0,
+		bool check_dominated = false);
+
+	/* Change nu of the initialized problem, keeping the weak learners.
+	 * Only the slack penalty D = 1 / (N nu) changes, in the objective of
+	 * the primal or the bounds of the dual formulation, and the next
+	 * Update() continues from the current basis.
+	 */
+	void SetNu(double nu);
+
+	/* Start the next Update() from prior classifier weights, such as those
+	 * of a previous model on the same weak learners.
+	 *
+	 * weights: in the layout of ClassifierWeights(), for the first weak
+	 *    learners added, missing ones start at zero.  Each weight vector is
+	 *    rescaled to sum to one.  K vectors for fewer groups of classes
+	 *    give each group the weights of its first class.
+	 * fixed_rho, rho: use the given margin rho, otherwise the optimal rho
+	 *    for the weights is computed from the sample margins.
+	 *
+	 * The slacks xi follow from the margins, giving a feasible primal point
+	 * around which a starting basis is set for the primal simplex.  The
+	 * barrier solver cannot be warm-started and ignores it.
+	 */
+	void SetInitialWeights(const std::vector<std::vector<double> >& weights,
+		bool fixed_rho = false, double rho = 0.0);
+
+	/* (Re-)solve the LPBoost multiclass problem.  Returns false, leaving
+	 * the previous solution in place, when no weak learner has been added
+	 * yet or the LP solver fails; the failed problem is then reported on
+	 * std::cerr and written to LP-CRASH.mps.
+	 */
+	bool Update();
+
+	/* Options of the Clp barrier solver, InitializeBoosting with
+	 * interior_point.
+	 *
+	 * threads: threads of the Cholesky factorization, 0 for the default of
+	 *    the backend.  Sets the OpenMP and, with HAS_OPENBLAS, the OpenBLAS
+	 *    threads here, for the whole process.  Built with neither (the
+	 *    default CHOLESKY_FLAGS), threads has no effect: a warning is
+	 *    printed and Stats().barrier_threads_ignored set.
+	 * max_dense_columns: the rho and weak learner columns are split off the
+	 *    normal equations as dense columns, leaving one small block per
+	 *    sample.  With more dense columns than this the normal matrix is
+	 *    factored as dense instead, by CHOLMOD (HAS_CLP_CHOLMOD), MUMPS
+	 *    (HAS_CLP_MUMPS) or the dense Clp Cholesky, whichever Clp was
+	 *    built with.  Default 300.
+	 */
+	void SetBarrierOptions(unsigned int threads,
+		unsigned int max_dense_columns = 300);
+
+	/* Race dual simplex from the last basis against the barrier solver in
+	 * every Update(), on a copy of the Clp problem in a second thread.
+	 * The first proven optimal solution is taken.  The simplex is stopped
+	 * at its next iteration when the barrier wins.  The barrier cannot be
+	 * stopped: when the simplex wins, Update() returns without waiting
+	 * and the barrier runs to completion in the background, on the copy,
+	 * which it frees.  An Update() is thus as fast as the faster of the
+	 * two, plus the copy of the problem, but the lost barrier keeps a core
+	 * and the memory of the copy busy.  While it runs, further Update()s
+	 * solve by dual simplex alone instead of racing, counted as
+	 * race_skipped in Stats().
+	 *
+	 * decisive_wins: once one method won this many Update()s in a row,
+	 *    stop racing and solve with it alone until the next
+	 *    InitializeBoosting.  0 races every Update().
+	 *
+	 * Overrides interior_point of InitializeBoosting, Clp only.  The wins
+	 * are counted in Stats().
+	 */
+	void SetSolverRace(bool race, unsigned int decisive_wins = 0);
+
+	/* Relax the margin rows of samples far beyond the margin, a heuristic
+	 * to save simplex pivots.  After each Update() of the primal
+	 * formulation, a
+	 * sample is screened whose margin exceeds rho by at least
+	 * margin_threshold, whose rows have no dual weight, and for which the
+	 * duality gap bounds the dual weight any optimal solution could put on
+	 * its rows below a small tolerance.  The K-1 margin rows of a screened
+	 * sample are made free and its xi fixed at zero, such that the solver
+	 * no longer pivots on them.  The rows are not deleted: the LP does not
+	 * shrink, every factorization still holds them as basic slacks, and
+	 * the coefficients of later weak learners are still stored in them.
+	 *
+	 * Nothing guarantees that a screened sample stays beyond the margin
+	 * once weak learners, samples or SetNu change the LP.  Every solve is
+	 * therefore checked on the screened samples afterwards, violators are
+	 * put back and the LP solved again: the result is that of the full
+	 * problem.
+	 *
+	 * Off by default.  The screened samples and the fraction of relaxed
+	 * margin rows are counted in Stats().
+	 */
+	void SetSampleScreening(bool enable, double margin_threshold = 0.1);
+
+	/* Coarse-to-fine first solve.  The first simplex Update() of the
+	 * primal formulation without a basis first solves the LP over the same
+	 * weak learners on subsamples of the samples, stratified by class,
+	 * taking a fraction of each class that grows geometrically from
+	 * fraction to one over the levels.  Each level starts from the basis of
+	 * the one before, its new samples entering with basic slacks; the full
+	 * problem then starts from the last basis and the lifted primal point,
+	 * rho and the weights of the subsample with xi from the margins.
+	 *
+	 * levels: number of subsample levels, 0 disables.
+	 * fraction: of each class in the first level, in (0, 1).
+	 *
+	 * The iterations of the levels are counted in Stats().
 	 */
-	void Update();
+	void SetCoarseToFine(unsigned int levels, double fraction = 0.1);
+
+	/* Grouped weight sharing, between the single alpha of weight sharing
+	 * and one alpha_i per class.  The classes are partitioned into G
+	 * groups and the classes of group g share the weight vector alpha_g,
+	 * giving M G weight columns and G norm-1 rows.  A margin row of a
+	 * sample of class y against class cl has H_{y,.}(x)' alpha_g(y) -
+	 * H_{cl,.}(x)' alpha_g(cl), one column if both classes are in the same
+	 * group.
+	 *
+	 * class_groups: group of each class, K entries; the group ids are
+	 *    numbered by first appearance.  One group is solved as weight
+	 *    sharing, K groups as no weight sharing.
+	 *
+	 * Set before adding weak learners; an initialized problem is set up
+	 * again.  ClassifierWeights() still has one weight vector per class,
+	 * those of a group equal.
+	 */
+	void SetClassGroups(const std::vector<int>& class_groups);
+
+	/* Partition K classes into number_groups groups by their confusion,
+	 * for SetClassGroups.  confusion: (K,K) matrix, confusion[a][b] how
+	 * often class a is predicted as b, for example by a first round of
+	 * boosting or the unweighted vote of the weak learners.  The classes
+	 * most confused with each other are merged first (average linkage on
+	 * the symmetric confusion rates), such that they share weights and
+	 * are told apart by the same blend of weak learners.
+	 */
+	static std::vector<int> GroupClassesByConfusion(
+		const std::vector<std::vector<double> >& confusion,
+		unsigned int number_groups);
+
+	/* The LP as held by the solver, to inspect or hand to another solver:
+	 *    minimize objective' x
+	 *    subject to row_lower <= A x <= row_upper,
+	 *               column_lower <= x <= column_upper.
+	 * In the dual formulation this is the dual LP.  The pointers are into
+	 * the solver's own arrays and valid until the problem changes or the
+	 * next Update().  A is column-major, column j has column_lengths[j]
+	 * elements from column_starts[j] on; consecutive columns follow each
+	 * other directly unless has_gaps.  number_elements is the extent of
+	 * row_indices and values, gaps included.
+	 */
+	struct LPData {
+		int number_rows;
+		int number_columns;
+		CoinBigIndex number_elements;
+		bool has_gaps;
+		const CoinBigIndex* column_starts;
+		const int* column_lengths;
+		const int* row_indices;
+		const double* values;
+		const double* column_lower;
+		const double* column_upper;
+		const double* objective;
+		const double* row_lower;
+		const double* row_upper;
+	};
+	LPData SolverLP() const;
+
+	/* Use a solution of the SolverLP() problem computed elsewhere in place
+	 * of Update(): the weights, rho, gamma and margin distribution are
+	 * taken from it as from a solve.
+	 *
+	 * column_solution: x, one value per column.
+	 * row_price: the dual values of the rows.
+	 *
+	 * Returns the largest violation of the column bounds and rows by x,
+	 * zero for a feasible solution.  Vectors not of the sizes of the
+	 * SolverLP() columns and rows are not taken, the violation is then
+	 * infinite.
+	 */
+	double SetSolution(const std::vector<double>& column_solution,
+		const std::vector<double>& row_price);
+
+	/* Tolerance epsilon > 0 of EntropyRegularizedFormulation, default 0.01.
+	 * Smaller values follow the LP solution more closely.
+	 */
+	void SetEntropyTolerance(double epsilon);
+
+	/* Number of boosting iterations after which ERLPBoost is within epsilon
+	 * of the optimal soft margin, 32/epsilon^2 ln(N/nu).
+	 */
+	static unsigned int EntropyIterationBound(unsigned int number_samples,
+		double nu, double epsilon);
 
 	/* Write current problem as MPS file.
 	 */
@@ -58,20 +417,280 @@ public:
 	 *    f(x) = argmax_i (H(x)_{i,.} alpha_i),
 	 * where H(x)_{i,.} is the i'th row of the (K,M) prediction matrix for
 	 * sample x.
+	 *
+	 * With class groups (SetClassGroups), also of a single group, the
+	 * K-vector of the individual weights is returned, class i with the
+	 * weights of its group.  It is expanded when the weights change, the
+	 * call only reads.
 	 */
 	const std::vector<std::vector<double> >& ClassifierWeights() const;
 
+	/* ClassifierWeights() for the responses as given, if they are
+	 * normalized (SetResponseNormalization).  alpha_m times the scale of
+	 * weak learner m; the prediction function is the same.
+	 */
+	std::vector<std::vector<double> > RawClassifierWeights() const;
+
 	/* Rho, the margin.
 	 * Gamma, the soft margin.
 	 */
 	double Rho() const;
 	double Gamma() const;
 
+	/* Distribution over the margin constraints after the last Update(),
+	 * the sample weights to train the next weak learner on.  (N,K) matrix
+	 * d with d[n][y_n] = 0, summing to one; d[n][cl] is the weight of
+	 * sample n being confused with class cl.
+	 */
+	const std::vector<std::vector<double> >& MarginDistribution() const;
+
+	/* Number of constraint matrix elements for N samples and M dense weak
+	 * learners.  It is an upper bound for sparse weak learners, and for
+	 * class groups with weight_sharing false.
+	 */
+	static uint64_t MatrixElements(uint64_t number_samples,
+		int number_classes, uint64_t number_learners, bool weight_sharing);
+
+	/* Largest number of constraint matrix elements the LP solver can
+	 * store, given by its element index type CoinBigIndex.  Build
+	 * CoinUtils and the solver with a 64-bit CoinBigIndex for larger
+	 * problems.  Exceeding the limit is a fatal error.
+	 */
+	static uint64_t MaximumMatrixElements();
+
+	/* Whether a problem of N samples and M dense weak learners stays within
+	 * the LP solver's row index range and element limit.  Exceeding them in
+	 * InitializeBoosting, AddMulticlassClassifier or AddSamples is a fatal
+	 * error; callers which must survive it, such as the Python binding,
+	 * check first.  Counts elements as MatrixElements does.
+	 */
+	static bool FitsSolver(uint64_t number_samples, int number_classes,
+		uint64_t number_learners, bool weight_sharing);
+
+	/* Whether InitializeBoosting with number_samples labels fits the
+	 * solver, for the classes and weight sharing of this classifier.
+	 */
+	bool CanInitialize(uint64_t number_samples) const;
+
+	/* Whether adding added_samples samples and added_learners weak
+	 * learners, counted as dense, to the initialized problem fits the
+	 * solver.
+	 */
+	bool CanAdd(uint64_t added_samples, uint64_t added_learners) const;
+
+	/* Keep up to max_idle Clp solver instances of destroyed classifiers
+	 * for reuse by InitializeBoosting, process-wide.  0 (the default)
+	 * deletes them.
+	 */
+	static void SetSolverPoolSize(unsigned int max_idle);
+
+	/* Counters on the problem construction.
+	 */
+	struct Statistics {
+		unsigned int classifiers_added;	// learners passed in
+		unsigned int classifiers_duplicate;	// rejected as duplicates
+		unsigned int classifiers_dominated;	// rejected as dominated
+		unsigned int barrier_dense_columns;	// split off in the last barrier
+		unsigned int solver_iterations;	// in the last Update()
+		unsigned int cache_hits;	// Update()s restored from the cache
+		unsigned int cache_warm_starts;	// from a cached smaller problem
+		// Heap allocations for temporaries while adding weak learners,
+		// beyond the buffers sized at InitializeBoosting and AddSamples
+		unsigned int scratch_allocations;
+		unsigned int race_simplex_wins;	// Update()s won by dual simplex
+		unsigned int race_barrier_wins;	// by the barrier, SetSolverRace
+		// Update()s by simplex alone, the barrier of a race still running
+		unsigned int race_skipped;
+		unsigned int samples_screened;	// now, see SetSampleScreening
+		unsigned int samples_reinserted;	// screened, then violated
+		// Of the margin rows, relaxed by screening now, still in the LP
+		double relaxed_row_fraction;
+		unsigned int coarse_iterations;	// of the levels, SetCoarseToFine
+		// SetBarrierOptions threads without an OpenMP or OpenBLAS build
+		bool barrier_threads_ignored;
+	};
+	const Statistics& Stats() const;
+
+	/* Held-out validation tracking.  After each Update() the validation
+	 * scores are brought up to date with the weak learners whose weights
+	 * changed only, instead of recomputing them from all weak learners.
+	 *
+	 * labels: (N_v,1) vector of class ids of the validation samples.
+	 * threads: number of threads scoring the validation samples.
+	 */
+	void SetValidationSet(const std::vector<int>& labels,
+		unsigned int threads = 1);
+
+	/* learner_id: weak learner id as returned by AddMulticlassClassifier.
+	 * response: (N_v,K) responses of the weak learner on the validation set.
+	 *    Weak learners without a validation response count as zero.
+	 */
+	void AddValidationResponse(unsigned int learner_id,
+		const std::vector<std::vector<double> >& response);
+
+	/* Validation result of the last Update().
+	 */
+	struct ValidationResult {
+		double accuracy;	// Fraction of samples with correct argmax class
+		// Score of the true class minus the best other score, per sample
+		std::vector<double> margins;
+		unsigned int learners_changed;	// Weight updates applied
+		double seconds;	// Wall time of the validation update
+	};
+	const ValidationResult& Validation() const;
+
 private:
+	// Rows and columns of the primal LP; in the dual formulation the LP
+	// is transposed, a primal row index is a column index and vice versa.
+	unsigned int PrimalRows() const;
+	unsigned int PrimalColumns() const;
+	// The primal constraint matrix by column.
+	const CoinPackedMatrix* PrimalMatrixByColumn() const;
+	// Index of the margin constraint row of sample n and class cl != y_n.
+	unsigned int MarginRow(unsigned int n, int cl) const;
+	// LP column of the slack xi_n.
+	unsigned int XiColumn(unsigned int n) const;
+	// First LP column of weak learner m.
+	unsigned int AlphaColumn(unsigned int m) const;
+	// Minimum margin of each sample for weights in ClassifierWeights layout.
+	void SampleMargins(const std::vector<std::vector<double> >& alpha,
+		std::vector<double>& margins) const;
+	// Optimal soft margin rho given the sample margins.
+	double OptimalRho(const std::vector<double>& margins) const;
+	// Solution cache entry, see SetSolutionCache.
+	struct CacheEntry {
+		unsigned int number_classifiers;
+		double rho;
+		double gamma;
+		std::vector<std::vector<double> > weights;
+		std::vector<double> distribution;	// of the margin rows
+		std::vector<char> structural_status;	// basis, empty if none
+		std::vector<char> artificial_status;
+	};
+	// Key of the problem with the first number_learners weak learners and
+	// the current options, stored in its entry, empty if unknown.
+	std::string CacheKey(unsigned int number_learners) const;
+	std::string CachePath(const std::string& key) const;
+	bool ReadCacheEntry(const std::string& key, CacheEntry& entry) const;
+	// Store the current solution, then evict beyond cache_max_bytes.
+	void WriteCacheEntry(const std::string& key);
+	// Returns the size of the entries left.
+	uint64_t EvictCache(const std::string& keep_path) const;
+	// Update() from a cache hit, false on a miss.
+	bool RestoreCachedSolution();
+	// Start from the solution of the longest cached prefix problem.
+	void WarmStartFromCache();
+	// Set the cached basis, extended to the current LP.
+	bool SetCachedBasis(const CacheEntry& entry);
+	// Set a basis around the feasible primal point, false if the solver
+	// does not take it.
+	bool SetPointBasis(const std::vector<double>& primal);
+
+	// Set the slack penalty D = 1 / (nu N) of all samples in the LP.
+	void SetSlackPenalty();
+	// Return the LP solver to the solver pool, or delete it.
+	void ReleaseSolver();
+	// Barrier solve, choosing the Cholesky backend.
+	void SolveBarrier(OsiClpSolverInterface* clp_si);
+	// Barrier solve of clp_si without crossover, of a problem of the
+	// formulation and number of classes.  Returns the number of dense
+	// columns split off.  Touches no member, for the barrier of a race.
+	static unsigned int RunBarrier(OsiClpSolverInterface* clp_si,
+		Formulation formulation, int number_classes,
+		unsigned int max_dense_columns);
+	// Race simplex on si against barrier on a copy, see SetSolverRace.
+	// Returns the solver holding the solution, si or the copy, which race
+	// owns.
+	OsiSolverInterface* RaceSolvers(OsiClpSolverInterface* clp_si,
+		boost::shared_ptr<SolverRace>& race);
+	// Report a failed solve and write the LP for analysis.
+	void ReportSolverFailure() const;
+	// Screen the samples beyond the margin without dual weight in the
+	// solution of si, see SetSampleScreening.
+	void ScreenSamples();
+	// Put back the screened samples the solution of si violates, returns
+	// their number.
+	unsigned int ReinsertViolatedSamples();
+	// Free the margin rows of sample n and fix its xi at zero, or undo.
+	void SetSampleScreened(unsigned int n, bool screened);
+	// Solve the subsample levels of SetCoarseToFine and start si from the
+	// lifted basis and point.  Returns false if a level failed to solve.
+	bool SolveCoarseToFine();
+	// Samples of the coarse level taking fraction of each class, sorted.
+	void CoarseSamples(double fraction,
+		std::vector<unsigned int>& samples) const;
+	// The LP of si restricted to the margin rows and xi of samples, new
+	// in a solver like si.  Sets the rows and columns of si it keeps.
+	OsiSolverInterface* CoarseProblem(const std::vector<unsigned int>& samples,
+		std::vector<int>& rows, std::vector<int>& columns) const;
+	// A x at the solution x of si, one value per row.
+	void RowActivities(std::vector<double>& activity) const;
+	// Weights, rho, gamma and margin distribution from a solution of the
+	// solver's LP.
+	void ExtractSolution(const double* column_solution,
+		const double* row_price, double objective_value);
+	// Rebuild expanded_weights, after every change of classifier_weights.
+	void ExpandClassifierWeights();
+	// Store the distribution over the margin constraints, weights[r -
+	// first_row] for margin row r.
+	void SetMarginDistribution(const double* weights, unsigned int first_row);
+	// Frank-Wolfe solve of the entropy regularized problem.
+	void UpdateEntropyRegularized();
+	// Minimizer d over the capped simplex of d' z + 1/eta KL(d, uniform),
+	// z and d over the margin rows.
+	void EntropyDistribution(const std::vector<double>& z, double eta,
+		std::vector<double>& d) const;
+	// Constraint matrix of the initial problem without weak learners.
+	CoinPackedMatrix* BuildInitialMatrix(unsigned int margin_rows) const;
+	// Margin columns of a dense response, response(n, cl) the response of
+	// sample n to class cl.
+	template <typename Response>
+	unsigned int AddDenseColumns(const Response& response);
+	// The coefficients of the margin rows for AddDenseColumns, appended to
+	// the norm1_rows column arrays indices and values of current lengths
+	// counts, with Classes == number_classes or 0.
+	template <int Classes, typename Response>
+	void MarginColumns(const Response& response, int* const* indices,
+		double* const* values, int* counts);
+	// Most margin coefficients column ci of a weak learner can have.
+	unsigned int ColumnCapacity(unsigned int ci) const;
+	// Size the scratch buffers for the current N and K.
+	void ReserveScratch();
+	// Column arrays for a new weak learner from the scratch arena, with the
+	// one-norm row entry set: indices[ci][0 .. counts[ci]-1] and values.
+	void BeginScratchColumns(int**& indices, double**& values, int*& counts);
+	// Add the columns built in the arrays of BeginScratchColumns.
+	unsigned int AddScratchColumns(int* const* indices,
+		double* const* values, const int* counts);
+	// Add the norm1_rows columns of a weak learner, returns its id.
+	unsigned int AddLearnerColumns(CoinPackedVector* cols);
+	// Order-independent hash of the quantized learner columns.
+	uint64_t ColumnHash(const CoinPackedVector* cols) const;
+	// True if cols equal (or are dominated by) the columns of learner m.
+	bool ColumnsMatch(const CoinPackedVector* cols, unsigned int m,
+		bool dominated) const;
+
+	// Weight change of column ci of weak learner m since the last
+	// validation update.
+	struct ValidationDelta {
+		unsigned int m;
+		unsigned int ci;
+		double delta;
+	};
+	// Apply the weight changes to the validation scores.
+	void UpdateValidation();
+	// Apply deltas to samples [n_begin, n_end), count the correct ones and
+	// store their margins.
+	void ValidationWorker(const std::vector<ValidationDelta>* deltas,
+		unsigned int n_begin, unsigned int n_end, unsigned int* correct);
+
 	bool initialized;	// Safety flag to ensure correct call order
 	int number_classes;	// Number of classes in the multiclass problem
 	double nu;	// LPBoost nu, D = 1.0 / (N * nu)
 	bool weight_sharing;	// true: global alpha, false: A_{.,class}
+	// Group of each class if grouped, A_{.,group}, empty else
+	std::vector<int> class_groups;
+	bool single_group;	// SetClassGroups of one group, as weight sharing
 	unsigned int norm1_rows;	// Number of |.|_1 = 1 constraints.
 	unsigned int number_classifiers;	// M, number of weak learners
 
@@ -79,12 +698,97 @@ private:
 	double gamma;	// achieved objective in max-view: rho - D \sum_i \xi_i
 
 	std::vector<int> sample_labels;	// Multiclass labels, N samples
+	std::vector<unsigned int> xi_columns;	// LP column of xi_n
+	std::vector<unsigned int> alpha_columns;	// First LP column of learner m
 	// If weight sharing is used: 1 vector of M-vectors,
 	// If no weight sharing is used: K vector of M-vectors.
+	// With class groups: G vector of M-vectors.
 	std::vector<std::vector<double> > classifier_weights;
+	// K vector of M-vectors of the class groups, or of the single group,
+	// returned by ClassifierWeights()
+	std::vector<std::vector<double> > expanded_weights;
 
 	OsiSolverInterface* si;
 	bool use_interior_point;
+	std::string solver_name;
+	Formulation formulation;	// Problem solved by Update()
+	double entropy_epsilon;	// Tolerance of the entropy regularization
+	// (N,K) distribution over the margin constraints
+	std::vector<std::vector<double> > margin_distribution;
+	uint64_t matrix_elements;	// Constraint matrix elements
+	bool warm_start_pending;	// Next Update() starts from SetInitialWeights
+
+	bool redundancy_check;	// Reject duplicate weak learners
+	double redundancy_epsilon;	// Duplicate tolerance, max-norm
+	bool redundancy_dominated;	// Also reject dominated weak learners
+	// Column hash to learner id
+	std::multimap<uint64_t, unsigned int> column_hashes;
+	// Dense column buffer for comparisons, all zero between uses
+	mutable std::vector<double> redundancy_scratch;
+
+	// Bump allocator for the temporaries of adding one weak learner.
+	// Allocate hands out memory valid until the next Reset, which keeps it
+	// for reuse; only growing past the reserved size allocates.
+	class ScratchArena {
+	public:
+		ScratchArena();
+		void Reserve(size_t bytes);
+		void Reset();
+		template <typename T>
+		T* Allocate(size_t count);
+		// Allocations since the last call, not counting Reserve.
+		unsigned int TakeAllocations();
+	private:
+		std::deque<std::vector<double> > blocks;
+		unsigned int block;	// Block allocated from
+		size_t used;	// Doubles used of it
+		unsigned int allocations;
+	};
+	ScratchArena scratch_arena;
+	// Weak learner columns, reserved to ColumnCapacity
+	std::vector<CoinPackedVector> scratch_columns;
+	std::vector<unsigned int> class_samples;	// Samples per class
+
+	ResponseNormalization response_normalization;
+	std::vector<double> response_scales;	// Scale of each weak learner
+	int lp_scaling;	// Clp scaling mode, -1 for its default
+
+	std::string cache_directory;	// Solution cache, empty if disabled
+	uint64_t cache_max_bytes;
+	uint64_t cache_bytes;	// At the last scan, plus entries written since
+	bool cache_scanned;
+	// Hash of the labels and the first m weak learner columns, 0 for m
+	// before the last AddSamples, and a second hash of the same
+	std::vector<uint64_t> cache_chain;
+	std::vector<uint64_t> cache_check_chain;
+	bool lp_has_basis;	// The solver holds a basis to continue from
+
+	unsigned int barrier_max_dense_columns;	// Else dense normal matrix
+	bool solver_race;	// Race simplex and barrier in Update()
+	unsigned int race_decisive_wins;	// Wins in a row to stop racing
+	bool race_barrier_leads;	// Method of the current winning streak
+	unsigned int race_streak;	// Its length
+	// Race the simplex won, expired once its barrier finished
+	boost::weak_ptr<SolverRace> abandoned_race;
+
+	bool sample_screening;	// Screen samples beyond the margin
+	double screening_threshold;	// Margin above rho to screen at
+	std::vector<bool> sample_screened;	// Rows free and xi fixed
+
+	unsigned int coarse_levels;	// Subsample levels of the first solve
+	double coarse_fraction;	// Of each class in the first level
+
+	Statistics stats;
+
+	std::vector<int> validation_labels;	// N_v validation labels
+	unsigned int validation_threads;
+	// Learner-major responses, N_v * K per weak learner
+	std::vector<double> validation_responses;
+	std::vector<bool> validation_registered;	// Learner has a response
+	// Weights included in the validation scores, classifier_weights layout
+	std::vector<std::vector<double> > validation_weights;
+	std::vector<double> validation_scores;	// N_v * K scores
+	ValidationResult validation;
 };
 
 }
@@ -9,13 +9,39 @@
 
 #include <vector>
 #include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <string>
 #include <algorithm>
+#include <map>
+#include <limits>
+
+#include <stdlib.h>
+
+#include <boost/filesystem.hpp>
 
 #include "LPBoostMulticlassClassifier.h"
 #include "LPBoostMulticlassClassifier_test.h"
+#include "LPBoostServer.h"
 
 CPPUNIT_TEST_SUITE_REGISTRATION(LPBoostMulticlassClassifierTest);
 
+const double LPBoostMulticlassClassifierTest::resp[4][5][3] = {
+	{ { 0.9, 0.1, 0.0 }, { 0.2, 0.7, 0.1 }, { 0.5, 0.1, 0.4 },
+		{ 0.4, 0.5, 0.1 }, { 0.3, 0.3, 0.4 } },
+	{ { 0.6, 0.3, 0.1 }, { 0.5, 0.4, 0.1 }, { 0.1, 0.2, 0.7 },
+		{ 0.7, 0.1, 0.2 }, { 0.2, 0.6, 0.2 } },
+	{ { 0.2, 0.5, 0.3 }, { 0.1, 0.8, 0.1 }, { 0.3, 0.3, 0.4 },
+		{ 0.6, 0.2, 0.2 }, { 0.0, 0.9, 0.1 } },
+	{ { 0.5, 0.2, 0.3 }, { 0.3, 0.6, 0.1 }, { 0.2, 0.2, 0.6 },
+		{ 0.8, 0.1, 0.1 }, { 0.4, 0.5, 0.1 } } };
+
+std::vector<int> LPBoostMulticlassClassifierTest::Labels(
+	unsigned int number_samples) {
+	const int labels[5] = { 0, 1, 2, 0, 1 };
+	return (std::vector<int>(labels, labels + number_samples));
+}
+
 // Simple test: three samples, one perfect classifier
 // classifier
 void LPBoostMulticlassClassifierTest::LearningSimple() {
@@ -143,6 +169,1159 @@ void LPBoostMulticlassClassifierTest::LearningNoise() {
 	CPPUNIT_ASSERT_DOUBLES_EQUAL(mlp.Rho(), 1.0, 1e-8);
 }
 
+// Sparse input: one-hot weak learners given in compressed row format, some
+// classes listed twice, must give the same solution as their dense
+// responses.
+void LPBoostMulticlassClassifierTest::LearningSparse() {
+	std::vector<int> labels;
+	labels.push_back(0);
+	labels.push_back(1);
+	labels.push_back(2);
+	labels.push_back(1);
+
+	// Predicted class of each weak learner (rows) for each sample (columns)
+	int votes[3][4] = { { 0, 1, 2, 0 }, { 1, 1, 2, 1 }, { 0, 2, 2, 1 } };
+
+	for (int ws = 0; ws < 2; ++ws) {
+		Boosting::LPBoostMulticlassClassifier mlp_dense(3, 0.5, ws == 0);
+		Boosting::LPBoostMulticlassClassifier mlp_sparse(3, 0.5, ws == 0);
+		mlp_dense.InitializeBoosting(labels);
+		mlp_sparse.InitializeBoosting(labels);
+
+		for (unsigned int m = 0; m < 3; ++m) {
+			std::vector<std::vector<double> > resp(4, std::vector<double>(3));
+			std::vector<unsigned int> sample_start;
+			std::vector<int> classes;
+			std::vector<double> values;
+			for (unsigned int n = 0; n < 4; ++n) {
+				resp[n][votes[m][n]] = 1.0;
+				sample_start.push_back(classes.size());
+				classes.push_back(votes[m][n]);
+				if (n % 2 == 0) {
+					values.push_back(1.0);
+				} else {
+					// Listed twice, the values add up
+					values.push_back(0.25);
+					classes.push_back(votes[m][n]);
+					values.push_back(0.75);
+				}
+			}
+			sample_start.push_back(classes.size());
+			mlp_dense.AddMulticlassClassifier(resp);
+			mlp_sparse.AddMulticlassClassifierSparse(sample_start,
+				classes, values);
+		}
+		mlp_dense.Update();
+		mlp_sparse.Update();
+
+		const std::vector<std::vector<double> >& clw_dense =
+			mlp_dense.ClassifierWeights();
+		const std::vector<std::vector<double> >& clw_sparse =
+			mlp_sparse.ClassifierWeights();
+		CPPUNIT_ASSERT_EQUAL(clw_dense.size(), clw_sparse.size());
+		for (unsigned int k = 0; k < clw_dense.size(); ++k) {
+			for (unsigned int m = 0; m < clw_dense[k].size(); ++m)
+				CPPUNIT_ASSERT_DOUBLES_EQUAL(clw_dense[k][m],
+					clw_sparse[k][m], 1e-8);
+		}
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(mlp_dense.Gamma(),
+			mlp_sparse.Gamma(), 1e-8);
+	}
+}
+
+// Duplicate and dominated weak learners are mapped to existing ones
+void LPBoostMulticlassClassifierTest::RedundantClassifiers() {
+	Boosting::LPBoostMulticlassClassifier mlp(3, 0.1, true);
+	mlp.SetRedundancyCheck(true, 1e-6, true);
+
+	std::vector<int> labels;
+	labels.push_back(0);
+	labels.push_back(1);
+	labels.push_back(2);
+	mlp.InitializeBoosting(labels);
+
+	std::vector<std::vector<double> > resp1(3, std::vector<double>(3));
+	resp1[0][0] = 0.9;
+	resp1[0][1] = 0.1;
+	resp1[1][1] = 0.6;
+	resp1[1][2] = 0.4;
+	resp1[2][0] = 0.5;
+	resp1[2][2] = 0.5;
+	CPPUNIT_ASSERT_EQUAL(mlp.AddMulticlassClassifier(resp1), 0u);
+
+	// Duplicate up to epsilon
+	std::vector<std::vector<double> > resp2(resp1);
+	resp2[1][1] += 1e-9;
+	CPPUNIT_ASSERT_EQUAL(mlp.AddMulticlassClassifier(resp2), 0u);
+
+	// Dominated: all margins smaller
+	std::vector<std::vector<double> > resp3(resp1);
+	for (unsigned int n = 0; n < 3; ++n)
+		resp3[n][labels[n]] *= 0.5;
+	CPPUNIT_ASSERT_EQUAL(mlp.AddMulticlassClassifier(resp3), 0u);
+
+	// New learner
+	std::vector<std::vector<double> > resp4(3, std::vector<double>(3));
+	resp4[0][0] = 1.0;
+	resp4[1][1] = 1.0;
+	resp4[2][2] = 1.0;
+	CPPUNIT_ASSERT_EQUAL(mlp.AddMulticlassClassifier(resp4), 1u);
+	mlp.Update();
+
+	CPPUNIT_ASSERT(mlp.ClassifierWeights()[0].size() == 2);
+	CPPUNIT_ASSERT_EQUAL(mlp.Stats().classifiers_added, 4u);
+	CPPUNIT_ASSERT_EQUAL(mlp.Stats().classifiers_duplicate, 1u);
+	CPPUNIT_ASSERT_EQUAL(mlp.Stats().classifiers_dominated, 1u);
+}
+
+// Element counts of large problems must not wrap around
+void LPBoostMulticlassClassifierTest::MatrixElementCount() {
+	// N = 200000, K = 100, M = 2000 has 4e10 elements
+	uint64_t margin_rows = 200000ULL * 99ULL;
+	CPPUNIT_ASSERT(Boosting::LPBoostMulticlassClassifier::MatrixElements(
+		200000, 100, 2000, true) == 2 * margin_rows + 2000 * (1 + margin_rows));
+	CPPUNIT_ASSERT(Boosting::LPBoostMulticlassClassifier::MatrixElements(
+		200000, 100, 2000, false)
+		== 2 * margin_rows + 2000 * (100 + 2 * margin_rows));
+	CPPUNIT_ASSERT(Boosting::LPBoostMulticlassClassifier::MatrixElements(
+		200000, 100, 2000, true) > (1ULL << 32));
+
+	// Beyond the row index range, checked without building the problem
+	CPPUNIT_ASSERT(Boosting::LPBoostMulticlassClassifier::FitsSolver(
+		200000, 100, 0, true));
+	CPPUNIT_ASSERT(Boosting::LPBoostMulticlassClassifier::FitsSolver(
+		1ULL << 31, 3, 0, true) == false);
+	Boosting::LPBoostMulticlassClassifier mlp(3, 0.5, true);
+	CPPUNIT_ASSERT(mlp.CanInitialize(1ULL << 31) == false);
+	mlp.InitializeBoosting(Labels(4));
+	CPPUNIT_ASSERT(mlp.CanAdd(4, 1));
+	CPPUNIT_ASSERT(mlp.CanAdd(1ULL << 31, 0) == false);
+}
+
+// Retraining from the weights of a previous model gives the same solution,
+// in fewer simplex iterations than from scratch.
+void LPBoostMulticlassClassifierTest::WarmStart() {
+	std::vector<int> labels(Labels(4));
+
+	Boosting::LPBoostMulticlassClassifier mlp_cold(3, 0.5, true);
+	Boosting::LPBoostMulticlassClassifier mlp_warm(3, 0.5, true);
+	mlp_cold.InitializeBoosting(labels);
+	mlp_warm.InitializeBoosting(labels);
+	for (unsigned int m = 0; m < 3; ++m) {
+		std::vector<std::vector<double> > response(4);
+		for (unsigned int n = 0; n < 4; ++n)
+			response[n].assign(resp[m][n], resp[m][n] + 3);
+		mlp_cold.AddMulticlassClassifier(response);
+		mlp_warm.AddMulticlassClassifier(response);
+	}
+	mlp_cold.Update();
+
+	mlp_warm.SetInitialWeights(mlp_cold.ClassifierWeights());
+	mlp_warm.Update();
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(mlp_cold.Gamma(), mlp_warm.Gamma(), 1e-8);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(mlp_cold.Rho(), mlp_warm.Rho(), 1e-8);
+	CPPUNIT_ASSERT(mlp_warm.Stats().solver_iterations <
+		mlp_cold.Stats().solver_iterations);
+}
+
+// Adding samples to a solved problem must give the same solution as
+// training on all samples from scratch.
+void LPBoostMulticlassClassifierTest::AddSamples() {
+	std::vector<int> labels(Labels(5));
+
+	for (int shared = 0; shared < 2; ++shared) {
+		std::vector<int> labels_first(labels.begin(), labels.begin() + 3);
+		std::vector<int> labels_added(labels.begin() + 3, labels.end());
+
+		Boosting::LPBoostMulticlassClassifier mlp_full(3, 0.5, shared != 0);
+		Boosting::LPBoostMulticlassClassifier mlp_online(3, 0.5, shared != 0);
+		mlp_full.InitializeBoosting(labels);
+		mlp_online.InitializeBoosting(labels_first);
+		std::vector<std::vector<std::vector<double> > > responses_added(3);
+		for (unsigned int m = 0; m < 3; ++m) {
+			std::vector<std::vector<double> > response(5);
+			for (unsigned int n = 0; n < 5; ++n)
+				response[n].assign(resp[m][n], resp[m][n] + 3);
+			mlp_full.AddMulticlassClassifier(response);
+			mlp_online.AddMulticlassClassifier(std::vector<
+				std::vector<double> >(response.begin(), response.begin() + 3));
+			responses_added[m].assign(response.begin() + 3, response.end());
+		}
+		mlp_full.Update();
+		mlp_online.Update();
+
+		mlp_online.AddSamples(labels_added, responses_added);
+		mlp_online.Update();
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(mlp_full.Gamma(), mlp_online.Gamma(),
+			1e-8);
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(mlp_full.Rho(), mlp_online.Rho(), 1e-8);
+	}
+}
+
+// The incremental validation scores must match scoring the validation set
+// with the final weights from scratch.
+void LPBoostMulticlassClassifierTest::ValidationTracking() {
+	std::vector<int> labels(Labels(4));
+
+	// Validation set: the training samples in reverse order
+	std::vector<int> labels_val(labels.rbegin(), labels.rend());
+
+	for (int shared = 0; shared < 2; ++shared) {
+		Boosting::LPBoostMulticlassClassifier mlp(3, 0.5, shared != 0);
+		mlp.InitializeBoosting(labels);
+		mlp.SetValidationSet(labels_val, 2);
+		for (unsigned int m = 0; m < 3; ++m) {
+			std::vector<std::vector<double> > response(4);
+			std::vector<std::vector<double> > response_val(4);
+			for (unsigned int n = 0; n < 4; ++n) {
+				response[n].assign(resp[m][n], resp[m][n] + 3);
+				response_val[3 - n] = response[n];
+			}
+			unsigned int id = mlp.AddMulticlassClassifier(response);
+			mlp.AddValidationResponse(id, response_val);
+			mlp.Update();
+		}
+
+		const std::vector<std::vector<double> >& clw = mlp.ClassifierWeights();
+		const Boosting::LPBoostMulticlassClassifier::ValidationResult& val =
+			mlp.Validation();
+		unsigned int correct = 0;
+		for (unsigned int n = 0; n < 4; ++n) {
+			double score[3] = { 0.0, 0.0, 0.0 };
+			for (unsigned int m = 0; m < 3; ++m) {
+				for (int cl = 0; cl < 3; ++cl)
+					score[cl] += clw[shared ? 0 : cl][m] * resp[m][n][cl];
+			}
+			int y = labels[n];
+			double margin = score[y] - std::max(score[(y + 1) % 3],
+				score[(y + 2) % 3]);
+			CPPUNIT_ASSERT_DOUBLES_EQUAL(margin, val.margins[3 - n], 1e-8);
+			if (margin > 0.0)
+				correct += 1;
+		}
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(correct / 4.0, val.accuracy, 1e-12);
+	}
+}
+
+// The dual formulation must recover the primal solution, also when weak
+// learners and samples are added between updates.  nu N is not integral,
+// such that the optimal rho is unique.
+void LPBoostMulticlassClassifierTest::DualFormulation() {
+	std::vector<int> labels(Labels(5));
+
+	for (int shared = 0; shared < 2; ++shared) {
+		std::vector<int> labels_first(labels.begin(), labels.begin() + 4);
+		std::vector<int> labels_added(labels.begin() + 4, labels.end());
+
+		Boosting::LPBoostMulticlassClassifier mlp_primal(3, 0.3, shared != 0);
+		Boosting::LPBoostMulticlassClassifier mlp_dual(3, 0.3, shared != 0);
+		mlp_primal.InitializeBoosting(labels_first);
+		mlp_dual.InitializeBoosting(labels_first, false, "clp",
+			Boosting::LPBoostMulticlassClassifier::DualFormulation);
+		std::vector<std::vector<std::vector<double> > > responses_added(3);
+		for (unsigned int m = 0; m < 3; ++m) {
+			std::vector<std::vector<double> > response(5);
+			for (unsigned int n = 0; n < 5; ++n)
+				response[n].assign(resp[m][n], resp[m][n] + 3);
+			std::vector<std::vector<double> > response_first(
+				response.begin(), response.begin() + 4);
+			mlp_primal.AddMulticlassClassifier(response_first);
+			mlp_dual.AddMulticlassClassifier(response_first);
+			responses_added[m].assign(response.begin() + 4, response.end());
+
+			mlp_primal.Update();
+			mlp_dual.Update();
+			CPPUNIT_ASSERT_DOUBLES_EQUAL(mlp_primal.Gamma(), mlp_dual.Gamma(),
+				1e-8);
+			CPPUNIT_ASSERT_DOUBLES_EQUAL(mlp_primal.Rho(), mlp_dual.Rho(),
+				1e-8);
+		}
+
+		mlp_primal.AddSamples(labels_added, responses_added);
+		mlp_dual.AddSamples(labels_added, responses_added);
+		mlp_primal.Update();
+		mlp_dual.Update();
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(mlp_primal.Gamma(), mlp_dual.Gamma(),
+			1e-8);
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(mlp_primal.Rho(), mlp_dual.Rho(), 1e-8);
+
+		// Optimal weights need not be unique, check that the recovered
+		// weights are feasible and achieve the optimal objective.
+		const std::vector<std::vector<double> >& clw = mlp_dual.ClassifierWeights();
+		double weight_sum = 0.0;
+		for (unsigned int ci = 0; ci < clw.size(); ++ci) {
+			for (unsigned int m = 0; m < clw[ci].size(); ++m) {
+				CPPUNIT_ASSERT(clw[ci][m] >= -1e-8);
+				weight_sum += clw[ci][m];
+			}
+		}
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(static_cast<double>(clw.size()),
+			weight_sum, 1e-8);
+		double objective = mlp_dual.Rho();
+		for (unsigned int n = 0; n < 5; ++n) {
+			int y = labels[n];
+			double margin = std::numeric_limits<double>::infinity();
+			for (int cl = 0; cl < 3; ++cl) {
+				if (cl == y)
+					continue;
+				double diff = 0.0;
+				for (unsigned int m = 0; m < 3; ++m) {
+					diff += clw[shared ? 0 : y][m] * resp[m][n][y]
+						- clw[shared ? 0 : cl][m] * resp[m][n][cl];
+				}
+				margin = std::min(margin, diff);
+			}
+			objective -= std::max(0.0, mlp_dual.Rho() - margin) / (0.3 * 5);
+		}
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(mlp_primal.Gamma(), objective, 1e-8);
+	}
+}
+
+void LPBoostMulticlassClassifierTest::EntropyRegularized() {
+	std::vector<int> labels(Labels(5));
+
+	double epsilon = 0.05;
+	for (int shared = 0; shared < 2; ++shared) {
+		Boosting::LPBoostMulticlassClassifier mlp_lp(3, 0.3, shared != 0);
+		Boosting::LPBoostMulticlassClassifier mlp_er(3, 0.3, shared != 0);
+		mlp_lp.InitializeBoosting(labels);
+		mlp_er.InitializeBoosting(labels, false, "clp",
+			Boosting::LPBoostMulticlassClassifier::EntropyRegularizedFormulation);
+		mlp_er.SetEntropyTolerance(epsilon);
+		for (unsigned int m = 0; m < 3; ++m) {
+			std::vector<std::vector<double> > response(5);
+			for (unsigned int n = 0; n < 5; ++n)
+				response[n].assign(resp[m][n], resp[m][n] + 3);
+			mlp_lp.AddMulticlassClassifier(response);
+			mlp_er.AddMulticlassClassifier(response);
+
+			// The soft margin is within epsilon of the optimal one
+			mlp_lp.Update();
+			mlp_er.Update();
+			CPPUNIT_ASSERT(mlp_er.Gamma() <= mlp_lp.Gamma() + 1e-8);
+			CPPUNIT_ASSERT(mlp_er.Gamma() >= mlp_lp.Gamma() - epsilon);
+
+			// Both distributions sum to one, no sample above 1/(nu N)
+			for (int formulation = 0; formulation < 2; ++formulation) {
+				const std::vector<std::vector<double> >& dist = formulation ?
+					mlp_er.MarginDistribution() : mlp_lp.MarginDistribution();
+				CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(5), dist.size());
+				double total = 0.0;
+				for (unsigned int n = 0; n < 5; ++n) {
+					CPPUNIT_ASSERT_DOUBLES_EQUAL(0.0, dist[n][labels[n]], 1e-12);
+					double sample_total = 0.0;
+					for (int cl = 0; cl < 3; ++cl) {
+						CPPUNIT_ASSERT(dist[n][cl] >= 0.0);
+						sample_total += dist[n][cl];
+					}
+					CPPUNIT_ASSERT(sample_total <= 1.0 / (0.3 * 5) + 1e-8);
+					total += sample_total;
+				}
+				CPPUNIT_ASSERT_DOUBLES_EQUAL(1.0, total, 1e-8);
+			}
+		}
+	}
+	CPPUNIT_ASSERT_EQUAL(1179u, Boosting::LPBoostMulticlassClassifier::
+		EntropyIterationBound(1000, 0.1, 0.5));
+}
+
+void LPBoostMulticlassClassifierTest::BarrierDenseColumns() {
+	std::vector<int> labels(Labels(5));
+
+	// rho and the three weak learners touch all ten margin rows
+	for (unsigned int max_dense = 2; max_dense <= 4; max_dense += 2) {
+		Boosting::LPBoostMulticlassClassifier mlp_simplex(3, 0.3);
+		Boosting::LPBoostMulticlassClassifier mlp_barrier(3, 0.3);
+		mlp_simplex.InitializeBoosting(labels);
+		mlp_barrier.InitializeBoosting(labels, true);
+		mlp_barrier.SetBarrierOptions(2, max_dense);
+#if defined(_OPENMP) || defined(HAS_OPENBLAS)
+		CPPUNIT_ASSERT(mlp_barrier.Stats().barrier_threads_ignored == false);
+#else
+		CPPUNIT_ASSERT(mlp_barrier.Stats().barrier_threads_ignored);
+#endif
+		for (unsigned int m = 0; m < 3; ++m) {
+			std::vector<std::vector<double> > response(5);
+			for (unsigned int n = 0; n < 5; ++n)
+				response[n].assign(resp[m][n], resp[m][n] + 3);
+			mlp_simplex.AddMulticlassClassifier(response);
+			mlp_barrier.AddMulticlassClassifier(response);
+		}
+		mlp_simplex.Update();
+		mlp_barrier.Update();
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(mlp_simplex.Gamma(), mlp_barrier.Gamma(),
+			1e-6);
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(mlp_simplex.Rho(), mlp_barrier.Rho(),
+			1e-6);
+	}
+}
+
+void LPBoostMulticlassClassifierTest::ResponseNormalization() {
+	std::vector<int> labels(Labels(5));
+	double factor[3] = { 1.0, 1000.0, 0.001 };
+
+	// Normalized, the solution does not depend on the response scales
+	for (int mode = 1; mode <= 2; ++mode) {
+		for (int shared = 0; shared < 2; ++shared) {
+			Boosting::LPBoostMulticlassClassifier mlp(3, 0.3, shared != 0);
+			Boosting::LPBoostMulticlassClassifier mlp_scaled(3, 0.3,
+				shared != 0);
+			mlp.SetResponseNormalization(static_cast<Boosting::
+				LPBoostMulticlassClassifier::ResponseNormalization>(mode));
+			mlp_scaled.SetResponseNormalization(static_cast<Boosting::
+				LPBoostMulticlassClassifier::ResponseNormalization>(mode));
+			mlp.InitializeBoosting(labels);
+			mlp_scaled.InitializeBoosting(labels);
+			for (unsigned int m = 0; m < 3; ++m) {
+				std::vector<std::vector<double> > response(5);
+				std::vector<std::vector<double> > response_scaled(5);
+				for (unsigned int n = 0; n < 5; ++n) {
+					response[n].assign(resp[m][n], resp[m][n] + 3);
+					for (unsigned int cl = 0; cl < 3; ++cl)
+						response_scaled[n].push_back(factor[m] * resp[m][n][cl]);
+				}
+				mlp.AddMulticlassClassifier(response);
+				mlp_scaled.AddMulticlassClassifier(response_scaled);
+				CPPUNIT_ASSERT_DOUBLES_EQUAL(mlp.ResponseScales()[m],
+					factor[m] * mlp_scaled.ResponseScales()[m], 1e-8);
+			}
+			mlp.Update();
+			mlp_scaled.Update();
+			CPPUNIT_ASSERT_DOUBLES_EQUAL(mlp.Gamma(), mlp_scaled.Gamma(), 1e-8);
+
+			std::vector<std::vector<double> > raw = mlp.RawClassifierWeights();
+			std::vector<std::vector<double> > raw_scaled =
+				mlp_scaled.RawClassifierWeights();
+			for (unsigned int ci = 0; ci < raw.size(); ++ci) {
+				for (unsigned int m = 0; m < 3; ++m) {
+					CPPUNIT_ASSERT_DOUBLES_EQUAL(raw[ci][m],
+						factor[m] * raw_scaled[ci][m], 1e-6);
+				}
+			}
+		}
+	}
+
+	// Max-abs of the shared margin coefficients of the first learner
+	Boosting::LPBoostMulticlassClassifier mlp(3, 0.3);
+	mlp.SetResponseNormalization(
+		Boosting::LPBoostMulticlassClassifier::MaxAbsNormalization);
+	mlp.InitializeBoosting(labels);
+	std::vector<std::vector<double> > response(5);
+	for (unsigned int n = 0; n < 5; ++n)
+		response[n].assign(resp[0][n], resp[0][n] + 3);
+	mlp.AddMulticlassClassifier(response);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(1.0 / 0.9, mlp.ResponseScales()[0], 1e-12);
+}
+
+void LPBoostMulticlassClassifierTest::SolutionCache() {
+	std::vector<int> labels(Labels(5));
+	std::vector<std::vector<std::vector<double> > > responses(4);
+	for (unsigned int m = 0; m < 4; ++m) {
+		responses[m].resize(5);
+		for (unsigned int n = 0; n < 5; ++n)
+			responses[m][n].assign(resp[m][n], resp[m][n] + 3);
+	}
+
+	char cache_template[] = "/tmp/mclp_cache_test_XXXXXX";
+	CPPUNIT_ASSERT(mkdtemp(cache_template) != NULL);
+	std::string cache_directory(cache_template);
+
+	// Solved with two, then three weak learners
+	Boosting::LPBoostMulticlassClassifier mlp_solved(3, 0.3);
+	mlp_solved.SetSolutionCache(cache_directory);
+	mlp_solved.InitializeBoosting(labels, false);
+	for (unsigned int m = 0; m < 3; ++m) {
+		mlp_solved.AddMulticlassClassifier(responses[m]);
+		if (m > 0)
+			mlp_solved.Update();
+	}
+	CPPUNIT_ASSERT_EQUAL(0u, mlp_solved.Stats().cache_hits);
+
+	// Same problem: restored without solving
+	Boosting::LPBoostMulticlassClassifier mlp_cached(3, 0.3);
+	mlp_cached.SetSolutionCache(cache_directory);
+	mlp_cached.InitializeBoosting(labels, false);
+	for (unsigned int m = 0; m < 3; ++m)
+		mlp_cached.AddMulticlassClassifier(responses[m]);
+	mlp_cached.Update();
+	CPPUNIT_ASSERT_EQUAL(1u, mlp_cached.Stats().cache_hits);
+	CPPUNIT_ASSERT_EQUAL(mlp_solved.Gamma(), mlp_cached.Gamma());
+	CPPUNIT_ASSERT_EQUAL(mlp_solved.Rho(), mlp_cached.Rho());
+	CPPUNIT_ASSERT(mlp_solved.ClassifierWeights() ==
+		mlp_cached.ClassifierWeights());
+
+	// A further weak learner: warm started from the cached basis
+	mlp_cached.AddMulticlassClassifier(responses[3]);
+	Boosting::LPBoostMulticlassClassifier mlp_extended(3, 0.3);
+	mlp_extended.SetSolutionCache(cache_directory);
+	mlp_extended.InitializeBoosting(labels, false);
+	for (unsigned int m = 0; m < 4; ++m)
+		mlp_extended.AddMulticlassClassifier(responses[m]);
+	mlp_extended.Update();
+	CPPUNIT_ASSERT_EQUAL(0u, mlp_extended.Stats().cache_hits);
+	CPPUNIT_ASSERT_EQUAL(1u, mlp_extended.Stats().cache_warm_starts);
+
+	// Other nu: a different problem
+	Boosting::LPBoostMulticlassClassifier mlp_other(3, 0.5);
+	mlp_other.SetSolutionCache(cache_directory);
+	mlp_other.InitializeBoosting(labels, false);
+	for (unsigned int m = 0; m < 3; ++m)
+		mlp_other.AddMulticlassClassifier(responses[m]);
+	mlp_other.Update();
+	CPPUNIT_ASSERT_EQUAL(0u, mlp_other.Stats().cache_hits);
+
+	// Beyond the size limit the older entries are evicted
+	unsigned int entries = 0;
+	boost::filesystem::directory_iterator end;
+	for (boost::filesystem::directory_iterator it(cache_directory);
+		it != end; ++it)
+		entries += 1;
+	CPPUNIT_ASSERT_EQUAL(4u, entries);
+	uint64_t entry_bytes = 0;
+	for (boost::filesystem::directory_iterator it(cache_directory);
+		it != end; ++it) {
+		entry_bytes = std::max(entry_bytes,
+			static_cast<uint64_t>(boost::filesystem::file_size(it->path())));
+	}
+	mlp_other.SetSolutionCache(cache_directory, entry_bytes);
+	mlp_other.AddMulticlassClassifier(responses[3]);
+	mlp_other.Update();
+	entries = 0;
+	for (boost::filesystem::directory_iterator it(cache_directory);
+		it != end; ++it)
+		entries += 1;
+	CPPUNIT_ASSERT_EQUAL(1u, entries);
+
+	boost::filesystem::remove_all(cache_directory);
+}
+
+void LPBoostMulticlassClassifierTest::ExternalSolution() {
+	std::vector<int> labels(Labels(5));
+
+	Boosting::LPBoostMulticlassClassifier mlp_solved(3, 0.3);
+	Boosting::LPBoostMulticlassClassifier mlp_external(3, 0.3);
+	mlp_solved.InitializeBoosting(labels);
+	mlp_external.InitializeBoosting(labels);
+	for (unsigned int m = 0; m < 3; ++m) {
+		std::vector<std::vector<double> > response(5);
+		for (unsigned int n = 0; n < 5; ++n)
+			response[n].assign(resp[m][n], resp[m][n] + 3);
+		mlp_solved.AddMulticlassClassifier(response);
+		mlp_external.AddMulticlassClassifier(response);
+	}
+	mlp_solved.Update();
+
+	// [rho, xi_1, ..., xi_5, alpha_1, ..., alpha_3] with one norm row and
+	// K-1 margin rows per sample.
+	Boosting::LPBoostMulticlassClassifier::LPData lp =
+		mlp_external.SolverLP();
+	CPPUNIT_ASSERT_EQUAL(1 + 5 * 2, lp.number_rows);
+	CPPUNIT_ASSERT_EQUAL(1 + 5 + 3, lp.number_columns);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(-1.0, lp.objective[0], 1e-12);
+	CPPUNIT_ASSERT(lp.objective[1] > 0.0);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0.0, lp.objective[6], 1e-12);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(1.0, lp.row_lower[0], 1e-12);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(1.0, lp.row_upper[0], 1e-12);
+	int elements = 0;
+	for (int ci = 0; ci < lp.number_columns; ++ci) {
+		CPPUNIT_ASSERT(lp.column_starts[ci] + lp.column_lengths[ci] <=
+			lp.number_elements);
+		for (int ei = 0; ei < lp.column_lengths[ci]; ++ei) {
+			int ri = lp.row_indices[lp.column_starts[ci] + ei];
+			CPPUNIT_ASSERT(ri >= 0 && ri < lp.number_rows);
+		}
+		elements += lp.column_lengths[ci];
+	}
+	// rho and xi in the margin rows, alpha in the norm row and the margin
+	// rows it does not vanish in
+	int expected_elements = 5 * 2 + 5 * 2 + 3;
+	for (unsigned int m = 0; m < 3; ++m) {
+		for (unsigned int n = 0; n < 5; ++n) {
+			for (int cl = 0; cl < 3; ++cl) {
+				if (cl != labels[n] && resp[m][n][labels[n]] != resp[m][n][cl])
+					expected_elements += 1;
+			}
+		}
+	}
+	CPPUNIT_ASSERT_EQUAL(expected_elements, elements);
+
+	// Hand over the solution of the first classifier as if solved elsewhere
+	const std::vector<std::vector<double> >& clw =
+		mlp_solved.ClassifierWeights();
+	double rho = mlp_solved.Rho();
+	std::vector<double> column_solution(lp.number_columns, 0.0);
+	std::vector<double> row_price(lp.number_rows, 0.0);
+	column_solution[0] = rho;
+	for (unsigned int m = 0; m < 3; ++m)
+		column_solution[6 + m] = clw[0][m];
+	const std::vector<std::vector<double> >& distribution =
+		mlp_solved.MarginDistribution();
+	for (unsigned int n = 0; n < 5; ++n) {
+		double margin = std::numeric_limits<double>::infinity();
+		for (int cl = 0; cl < 3; ++cl) {
+			if (cl == labels[n])
+				continue;
+			double margin_cl = 0.0;
+			for (unsigned int m = 0; m < 3; ++m)
+				margin_cl += clw[0][m] * (resp[m][n][labels[n]] - resp[m][n][cl]);
+			margin = std::min(margin, margin_cl);
+			row_price[1 + n * 2 + (cl < labels[n] ? cl : cl - 1)] =
+				distribution[n][cl];
+		}
+		column_solution[1 + n] = std::max(0.0, rho - margin);
+	}
+
+	double violation = mlp_external.SetSolution(column_solution, row_price);
+	CPPUNIT_ASSERT(violation < 1e-8);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(mlp_solved.Gamma(), mlp_external.Gamma(),
+		1e-8);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(rho, mlp_external.Rho(), 1e-12);
+	CPPUNIT_ASSERT(clw == mlp_external.ClassifierWeights());
+	CPPUNIT_ASSERT(distribution == mlp_external.MarginDistribution());
+
+	// An infeasible solution is reported
+	column_solution[1] = -1.0;
+	CPPUNIT_ASSERT(mlp_external.SetSolution(column_solution, row_price)
+		>= 1.0 - 1e-12);
+
+	// So is one of the wrong size, without taking it
+	column_solution.pop_back();
+	CPPUNIT_ASSERT(mlp_external.SetSolution(column_solution, row_price)
+		== std::numeric_limits<double>::infinity());
+	CPPUNIT_ASSERT(mlp_external.SetSolution(std::vector<double>(),
+		std::vector<double>()) == std::numeric_limits<double>::infinity());
+}
+
+void LPBoostMulticlassClassifierTest::StridedResponse() {
+	std::vector<int> labels(Labels(5));
+	// (N,M,K) column-major as passed from MATLAB
+	float resp_matlab[3 * 3 * 5];
+	for (unsigned int m = 0; m < 3; ++m) {
+		for (unsigned int n = 0; n < 5; ++n) {
+			for (unsigned int cl = 0; cl < 3; ++cl) {
+				resp_matlab[cl * 15 + m * 5 + n] =
+					static_cast<float>(resp[m][n][cl]);
+			}
+		}
+	}
+
+	for (int shared = 0; shared < 2; ++shared) {
+		Boosting::LPBoostMulticlassClassifier mlp_nested(3, 0.3, shared != 0);
+		Boosting::LPBoostMulticlassClassifier mlp_rows(3, 0.3, shared != 0);
+		Boosting::LPBoostMulticlassClassifier mlp_matlab(3, 0.3, shared != 0);
+		mlp_nested.InitializeBoosting(labels);
+		mlp_rows.InitializeBoosting(labels);
+		mlp_matlab.InitializeBoosting(labels);
+		for (unsigned int m = 0; m < 3; ++m) {
+			std::vector<std::vector<double> > response(5);
+			for (unsigned int n = 0; n < 5; ++n)
+				response[n].assign(resp[m][n], resp[m][n] + 3);
+			CPPUNIT_ASSERT_EQUAL(m,
+				mlp_nested.AddMulticlassClassifier(response));
+			CPPUNIT_ASSERT_EQUAL(m, mlp_rows.AddMulticlassClassifier(
+				&resp[m][0][0], 3, 1));
+			CPPUNIT_ASSERT_EQUAL(m, mlp_matlab.AddMulticlassClassifier(
+				resp_matlab + m * 5, 1, 15));
+		}
+		mlp_nested.Update();
+		mlp_rows.Update();
+		mlp_matlab.Update();
+
+		CPPUNIT_ASSERT_EQUAL(mlp_nested.Gamma(), mlp_rows.Gamma());
+		CPPUNIT_ASSERT(mlp_nested.ClassifierWeights() ==
+			mlp_rows.ClassifierWeights());
+		// Only up to the float precision of the responses
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(mlp_nested.Gamma(), mlp_matlab.Gamma(),
+			1e-6);
+	}
+}
+
+void LPBoostMulticlassClassifierTest::MarginKernels() {
+	// A class count with a specialized kernel and one without, responses
+	// with zeros and ties.
+	int class_counts[2] = { 3, 7 };
+	for (int ki = 0; ki < 2; ++ki) {
+		int K = class_counts[ki];
+		unsigned int N = 9;
+		std::vector<int> labels(N);
+		std::vector<double> response(N * K);
+		for (unsigned int n = 0; n < N; ++n) {
+			labels[n] = n % K;
+			for (int cl = 0; cl < K; ++cl)
+				response[n * K + cl] = ((n * 7 + cl * 3) % 5) * 0.25;
+		}
+
+		for (int shared = 0; shared < 2; ++shared) {
+			Boosting::LPBoostMulticlassClassifier mlp(K, 0.3, shared != 0);
+			mlp.InitializeBoosting(labels);
+			mlp.AddMulticlassClassifier(&response[0], K, 1);
+
+			// Expected column of each class weight (one if shared), by row
+			unsigned int norm1_rows = shared ? 1 : K;
+			std::vector<std::map<int, double> > expected(norm1_rows);
+			for (unsigned int ci = 0; ci < norm1_rows; ++ci)
+				expected[ci][ci] = 1.0;
+			int row = norm1_rows;
+			for (unsigned int n = 0; n < N; ++n) {
+				int y = labels[n];
+				for (int cl = 0; cl < K; ++cl) {
+					if (cl == y)
+						continue;
+					double resp_y = response[n * K + y];
+					double resp_cl = response[n * K + cl];
+					if (shared) {
+						if (resp_y != resp_cl)
+							expected[0][row] = resp_y - resp_cl;
+					} else {
+						if (resp_y != 0.0)
+							expected[y][row] = resp_y;
+						if (resp_cl != 0.0)
+							expected[cl][row] = -resp_cl;
+					}
+					row += 1;
+				}
+			}
+
+			Boosting::LPBoostMulticlassClassifier::LPData lp = mlp.SolverLP();
+			CPPUNIT_ASSERT_EQUAL(static_cast<int>(1 + N + norm1_rows),
+				lp.number_columns);
+			for (unsigned int ci = 0; ci < norm1_rows; ++ci) {
+				int col = 1 + N + ci;
+				std::map<int, double> actual;
+				for (int ei = 0; ei < lp.column_lengths[col]; ++ei) {
+					CoinBigIndex pos = lp.column_starts[col] + ei;
+					actual[lp.row_indices[pos]] = lp.values[pos];
+				}
+				CPPUNIT_ASSERT(expected[ci] == actual);
+			}
+		}
+	}
+}
+
+void LPBoostMulticlassClassifierTest::ScratchAllocations() {
+	unsigned int N = 12;
+	int K = 4;
+	std::vector<int> labels(N);
+	for (unsigned int n = 0; n < N; ++n)
+		labels[n] = (n * 5) % K;
+
+	for (int shared = 0; shared < 2; ++shared) {
+		Boosting::LPBoostMulticlassClassifier mlp(K, 0.3, shared != 0);
+		mlp.InitializeBoosting(labels);
+		std::vector<int> labels_added(3, 1);
+		std::vector<std::vector<std::vector<double> > > responses_added;
+		for (unsigned int m = 0; m < 6; ++m) {
+			// Dense and sparse weak learners, one-hot on some class
+			std::vector<double> response(N * K, 0.0);
+			std::vector<unsigned int> sample_start;
+			std::vector<int> classes;
+			std::vector<double> values;
+			for (unsigned int n = 0; n < N; ++n) {
+				int cl = (n + m) % K;
+				response[n * K + cl] = 1.0;
+				sample_start.push_back(classes.size());
+				classes.push_back(cl);
+				values.push_back(1.0);
+			}
+			sample_start.push_back(classes.size());
+			if (m % 2 == 0)
+				mlp.AddMulticlassClassifier(&response[0], K, 1);
+			else
+				mlp.AddMulticlassClassifierSparse(sample_start, classes, values);
+			responses_added.push_back(std::vector<std::vector<double> >(3,
+				std::vector<double>(K, 0.5)));
+		}
+		CPPUNIT_ASSERT_EQUAL(6u, mlp.Stats().classifiers_added);
+		CPPUNIT_ASSERT_EQUAL(0u, mlp.Stats().scratch_allocations);
+
+		// The buffers grow with the samples, not with the next learner
+		mlp.AddSamples(labels_added, responses_added);
+		std::vector<double> response((N + 3) * K, 0.25);
+		for (unsigned int n = 0; n < N + 3; ++n)
+			response[n * K + n % K] = 1.0;
+		mlp.AddMulticlassClassifier(&response[0], K, 1);
+		CPPUNIT_ASSERT_EQUAL(0u, mlp.Stats().scratch_allocations);
+	}
+}
+
+void LPBoostMulticlassClassifierTest::ResetReuse() {
+	// Jobs of different sizes on one instance, then through the solver
+	// pool, each compared against a fresh classifier.
+	Boosting::LPBoostMulticlassClassifier::SetSolverPoolSize(2);
+	Boosting::LPBoostMulticlassClassifier reused(2, 0.5);
+	for (unsigned int job = 0; job < 6; ++job) {
+		unsigned int N = 5 + 3 * (job % 3);
+		int K = 2 + job % 3;
+		std::vector<int> labels(N);
+		for (unsigned int n = 0; n < N; ++n)
+			labels[n] = (n * 7 + job) % K;
+		Boosting::LPBoostMulticlassClassifier::Formulation formulation =
+			(job < 3) ? Boosting::LPBoostMulticlassClassifier::PrimalFormulation :
+			Boosting::LPBoostMulticlassClassifier::DualFormulation;
+
+		Boosting::LPBoostMulticlassClassifier fresh(K, 0.4, job % 2 == 0);
+		fresh.InitializeBoosting(labels, false, "clp", formulation);
+		reused.Reset(K, 0.4, job % 2 == 0, labels, false, "clp", formulation);
+		CPPUNIT_ASSERT_EQUAL(0u, reused.Stats().classifiers_added);
+		for (unsigned int m = 0; m < 4; ++m) {
+			std::vector<double> response(N * K, 0.0);
+			for (unsigned int n = 0; n < N; ++n)
+				response[n * K + (n + m * job) % K] = 1.0;
+			fresh.AddMulticlassClassifier(&response[0], K, 1);
+			CPPUNIT_ASSERT_EQUAL(m,
+				reused.AddMulticlassClassifier(&response[0], K, 1));
+		}
+		fresh.Update();
+		reused.Update();
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(fresh.Gamma(), reused.Gamma(), 1e-8);
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(fresh.Rho(), reused.Rho(), 1e-8);
+		std::vector<std::vector<double> > wf = fresh.ClassifierWeights();
+		std::vector<std::vector<double> > wr = reused.ClassifierWeights();
+		CPPUNIT_ASSERT_EQUAL(wf.size(), wr.size());
+		for (unsigned int ci = 0; ci < wf.size(); ++ci) {
+			CPPUNIT_ASSERT_EQUAL(wf[ci].size(), wr[ci].size());
+			for (unsigned int m = 0; m < wf[ci].size(); ++m)
+				CPPUNIT_ASSERT_DOUBLES_EQUAL(wf[ci][m], wr[ci][m], 1e-8);
+		}
+	}
+	Boosting::LPBoostMulticlassClassifier::SetSolverPoolSize(0);
+}
+
+void LPBoostMulticlassClassifierTest::SolverRace() {
+	unsigned int N = 9;
+	int K = 3;
+	std::vector<int> labels(N);
+	for (unsigned int n = 0; n < N; ++n)
+		labels[n] = (n * 2) % K;
+
+	for (int dual = 0; dual < 2; ++dual) {
+		Boosting::LPBoostMulticlassClassifier::Formulation formulation =
+			dual ? Boosting::LPBoostMulticlassClassifier::DualFormulation :
+			Boosting::LPBoostMulticlassClassifier::PrimalFormulation;
+		Boosting::LPBoostMulticlassClassifier simplex(K, 0.3);
+		Boosting::LPBoostMulticlassClassifier racing(K, 0.3);
+		Boosting::LPBoostMulticlassClassifier decided(K, 0.3);
+		simplex.InitializeBoosting(labels, false, "clp", formulation);
+		racing.SetSolverRace(true);
+		racing.InitializeBoosting(labels, false, "clp", formulation);
+		decided.SetSolverRace(true, 1);
+		decided.InitializeBoosting(labels, false, "clp", formulation);
+		for (unsigned int m = 0; m < 4; ++m) {
+			std::vector<double> response(N * K, 0.1);
+			for (unsigned int n = 0; n < N; ++n)
+				response[n * K + (n * (m + 1)) % K] = 1.0;
+			simplex.AddMulticlassClassifier(&response[0], K, 1);
+			racing.AddMulticlassClassifier(&response[0], K, 1);
+			decided.AddMulticlassClassifier(&response[0], K, 1);
+			simplex.Update();
+			racing.Update();
+			decided.Update();
+			CPPUNIT_ASSERT_DOUBLES_EQUAL(simplex.Gamma(), racing.Gamma(), 1e-6);
+			CPPUNIT_ASSERT_DOUBLES_EQUAL(simplex.Gamma(), decided.Gamma(), 1e-6);
+		}
+		// Every update raced, unless decided after the first win or the
+		// barrier the simplex beat still ran.
+		CPPUNIT_ASSERT_EQUAL(4u, racing.Stats().race_simplex_wins
+			+ racing.Stats().race_barrier_wins
+			+ racing.Stats().race_skipped);
+		CPPUNIT_ASSERT_EQUAL(1u, decided.Stats().race_simplex_wins
+			+ decided.Stats().race_barrier_wins);
+	}
+}
+
+void LPBoostMulticlassClassifierTest::ChangeNu() {
+	unsigned int N = 10;
+	int K = 3;
+	std::vector<int> labels(N);
+	for (unsigned int n = 0; n < N; ++n)
+		labels[n] = n % K;
+
+	for (int dual = 0; dual < 2; ++dual) {
+		Boosting::LPBoostMulticlassClassifier::Formulation formulation =
+			dual ? Boosting::LPBoostMulticlassClassifier::DualFormulation :
+			Boosting::LPBoostMulticlassClassifier::PrimalFormulation;
+		Boosting::LPBoostMulticlassClassifier changed(K, 0.8);
+		Boosting::LPBoostMulticlassClassifier fresh(K, 0.2);
+		changed.InitializeBoosting(labels, false, "clp", formulation);
+		fresh.InitializeBoosting(labels, false, "clp", formulation);
+		for (unsigned int m = 0; m < 3; ++m) {
+			// Right on all but every (m+3)'th sample
+			std::vector<double> response(N * K, 0.0);
+			for (unsigned int n = 0; n < N; ++n)
+				response[n * K + (n % (m + 3) == 0 ? n + 1 : n) % K] = 1.0;
+			changed.AddMulticlassClassifier(&response[0], K, 1);
+			fresh.AddMulticlassClassifier(&response[0], K, 1);
+		}
+		changed.Update();
+		changed.SetNu(0.2);
+		changed.Update();
+		fresh.Update();
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(fresh.Gamma(), changed.Gamma(), 1e-6);
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(fresh.Rho(), changed.Rho(), 1e-6);
+	}
+}
+
+void LPBoostMulticlassClassifierTest::SampleScreening() {
+	unsigned int N = 24;
+	int K = 3;
+	std::vector<int> labels(N);
+	for (unsigned int n = 0; n < N; ++n)
+		labels[n] = n % K;
+
+	Boosting::LPBoostMulticlassClassifier screened(K, 0.2);
+	Boosting::LPBoostMulticlassClassifier full(K, 0.2);
+	screened.SetSampleScreening(true, 0.1);
+	screened.InitializeBoosting(labels, false);
+	full.InitializeBoosting(labels, false);
+	for (unsigned int m = 0; m < 6; ++m) {
+		// The first learners are right on most samples, the last ones on
+		// the hard samples n % 4 == 0 only, and wrong on the others, which
+		// the first learners screened.
+		std::vector<double> response(N * K, 0.0);
+		for (unsigned int n = 0; n < N; ++n) {
+			bool right = (m < 3) ? (n % (m + 4) != 0) : (n % 4 == 0);
+			response[n * K + (right ? n : n + 1 + m % 2) % K] = 1.0;
+		}
+		screened.AddMulticlassClassifier(&response[0], K, 1);
+		full.AddMulticlassClassifier(&response[0], K, 1);
+		screened.Update();
+		full.Update();
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(full.Gamma(), screened.Gamma(), 1e-6);
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(full.Rho(), screened.Rho(), 1e-6);
+		if (m == 0)
+			CPPUNIT_ASSERT(screened.Stats().samples_screened > 0);
+	}
+	const Boosting::LPBoostMulticlassClassifier::Statistics& stats =
+		screened.Stats();
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(static_cast<double>(stats.samples_screened)
+		/ N, stats.relaxed_row_fraction, 1e-12);
+	CPPUNIT_ASSERT_EQUAL(0u, full.Stats().samples_screened);
+}
+
+void LPBoostMulticlassClassifierTest::CoarseToFine() {
+	unsigned int N = 40;
+	int K = 3;
+	std::vector<int> labels(N);
+	for (unsigned int n = 0; n < N; ++n)
+		labels[n] = (n * 7) % K;
+
+	for (unsigned int levels = 0; levels < 3; ++levels) {
+		Boosting::LPBoostMulticlassClassifier mlp(K, 0.2, levels != 1);
+		Boosting::LPBoostMulticlassClassifier cold(K, 0.2, levels != 1);
+		mlp.SetCoarseToFine(levels, 0.25);
+		mlp.InitializeBoosting(labels, false);
+		cold.InitializeBoosting(labels, false);
+		for (unsigned int m = 0; m < 5; ++m) {
+			// Right on all but every (m+2)'th sample, graded responses
+			std::vector<double> response(N * K, 0.0);
+			for (unsigned int n = 0; n < N; ++n) {
+				unsigned int cl = (n % (m + 2) == 0) ? labels[n] + 1 : labels[n];
+				response[n * K + cl % K] = 1.0 + 0.1 * ((n + m) % 5);
+			}
+			mlp.AddMulticlassClassifier(&response[0], K, 1);
+			cold.AddMulticlassClassifier(&response[0], K, 1);
+		}
+		mlp.Update();
+		cold.Update();
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(cold.Gamma(), mlp.Gamma(), 1e-6);
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(cold.Rho(), mlp.Rho(), 1e-6);
+		if (levels == 0)
+			CPPUNIT_ASSERT_EQUAL(0u, mlp.Stats().coarse_iterations);
+		else
+			CPPUNIT_ASSERT(mlp.Stats().coarse_iterations > 0);
+	}
+}
+
+void LPBoostMulticlassClassifierTest::ClassGroups() {
+	unsigned int N = 24;
+	int K = 4;
+	std::vector<int> labels(N);
+	for (unsigned int n = 0; n < N; ++n)
+		labels[n] = n % K;
+
+	// One group is weight sharing, K groups none, groups in between.
+	int one_group[] = { 5, 5, 5, 5 };
+	int identity[] = { 0, 1, 2, 3 };
+	int pairs[] = { 7, 7, 3, 3 };
+	Boosting::LPBoostMulticlassClassifier shared(K, 0.5, true);
+	Boosting::LPBoostMulticlassClassifier individual(K, 0.5, false);
+	Boosting::LPBoostMulticlassClassifier grouped_one(K, 0.5, false);
+	Boosting::LPBoostMulticlassClassifier grouped_identity(K, 0.5, true);
+	Boosting::LPBoostMulticlassClassifier grouped(K, 0.5);
+	Boosting::LPBoostMulticlassClassifier grouped_sparse(K, 0.5);
+	grouped_one.SetClassGroups(std::vector<int>(one_group, one_group + K));
+	grouped_identity.SetClassGroups(std::vector<int>(identity, identity + K));
+	grouped.SetClassGroups(std::vector<int>(pairs, pairs + K));
+	shared.InitializeBoosting(labels, false);
+	individual.InitializeBoosting(labels, false);
+	grouped_one.InitializeBoosting(labels, false);
+	grouped_identity.InitializeBoosting(labels, false);
+	grouped.InitializeBoosting(labels, false);
+	// Set up again when already initialized
+	grouped_sparse.InitializeBoosting(labels, false);
+	grouped_sparse.SetClassGroups(std::vector<int>(pairs, pairs + K));
+
+	std::vector<std::vector<double> > responses;
+	for (unsigned int m = 0; m < 5; ++m) {
+		// Right on the classes m and m+1 and on every third other sample
+		std::vector<double> response(N * K, 0.0);
+		std::vector<unsigned int> sample_start(1, 0);
+		std::vector<int> classes;
+		std::vector<double> values;
+		for (unsigned int n = 0; n < N; ++n) {
+			bool right = (labels[n] == static_cast<int>(m % K) ||
+				labels[n] == static_cast<int>((m + 1) % K) || n % 3 == 0);
+			unsigned int cl = right ? labels[n] : labels[n] + 1 + n % 3;
+			response[n * K + cl % K] = 1.0 + 0.1 * ((n + m) % 3);
+			classes.push_back(cl % K);
+			values.push_back(response[n * K + cl % K]);
+			sample_start.push_back(classes.size());
+		}
+		shared.AddMulticlassClassifier(&response[0], K, 1);
+		individual.AddMulticlassClassifier(&response[0], K, 1);
+		grouped_one.AddMulticlassClassifier(&response[0], K, 1);
+		grouped_identity.AddMulticlassClassifier(&response[0], K, 1);
+		grouped.AddMulticlassClassifier(&response[0], K, 1);
+		grouped_sparse.AddMulticlassClassifierSparse(sample_start, classes,
+			values);
+		responses.push_back(response);
+	}
+	shared.Update();
+	individual.Update();
+	grouped_one.Update();
+	grouped_identity.Update();
+	grouped.Update();
+	grouped_sparse.Update();
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(shared.Gamma(), grouped_one.Gamma(), 1e-6);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(individual.Gamma(),
+		grouped_identity.Gamma(), 1e-6);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(grouped.Gamma(), grouped_sparse.Gamma(),
+		1e-6);
+	CPPUNIT_ASSERT(shared.Gamma() <= grouped.Gamma() + 1e-6);
+	CPPUNIT_ASSERT(grouped.Gamma() <= individual.Gamma() + 1e-6);
+
+	// One weight vector per class, equal within a group
+	const std::vector<std::vector<double> >& weights =
+		grouped.ClassifierWeights();
+	CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(K), weights.size());
+	CPPUNIT_ASSERT(weights[0] == weights[1]);
+	CPPUNIT_ASSERT(weights[2] == weights[3]);
+	// also for a single group, solved as weight sharing
+	const std::vector<std::vector<double> >& one_weights =
+		grouped_one.ClassifierWeights();
+	CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(K), one_weights.size());
+	for (int cl = 0; cl < K; ++cl)
+		CPPUNIT_ASSERT(one_weights[cl] == shared.ClassifierWeights()[0]);
+
+	// The soft margin of the expanded weights on the responses is Gamma,
+	// rho - D \sum_n max(0, rho - margin_n).
+	double soft_margin = grouped.Rho();
+	for (unsigned int n = 0; n < N; ++n) {
+		std::vector<double> score(K, 0.0);
+		for (int cl = 0; cl < K; ++cl) {
+			for (unsigned int m = 0; m < responses.size(); ++m)
+				score[cl] += weights[cl][m] * responses[m][n * K + cl];
+		}
+		double margin = std::numeric_limits<double>::infinity();
+		for (int cl = 0; cl < K; ++cl) {
+			if (cl != labels[n])
+				margin = std::min(margin, score[labels[n]] - score[cl]);
+		}
+		soft_margin -= std::max(0.0, grouped.Rho() - margin) / (0.5 * N);
+	}
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(grouped.Gamma(), soft_margin, 1e-6);
+
+	// Classes 0 and 2, 1 and 3 are confused with each other.
+	double confusion_data[4][4] = {
+		{ 8, 0, 4, 1 }, { 0, 9, 1, 3 }, { 5, 1, 7, 0 }, { 1, 4, 0, 9 } };
+	std::vector<std::vector<double> > confusion(K);
+	for (int cl = 0; cl < K; ++cl)
+		confusion[cl].assign(confusion_data[cl], confusion_data[cl] + K);
+	std::vector<int> groups =
+		Boosting::LPBoostMulticlassClassifier::GroupClassesByConfusion(
+			confusion, 2);
+	int expected[] = { 0, 1, 0, 1 };
+	CPPUNIT_ASSERT(groups == std::vector<int>(expected, expected + K));
+}
+
+void LPBoostMulticlassClassifierTest::ServerRoundTrip() {
+	std::vector<int> labels = Labels(5);
+	std::ostringstream labels_text;
+	labels_text << " 3 0.3 0 primal 5";
+	for (unsigned int n = 0; n < 5; ++n)
+		labels_text << " " << labels[n];
+	std::vector<std::string> responses_text(4);
+	for (unsigned int m = 0; m < 4; ++m) {
+		std::ostringstream text;
+		text << std::setprecision(17);
+		for (unsigned int n = 0; n < 5; ++n) {
+			for (unsigned int cl = 0; cl < 3; ++cl)
+				text << " " << resp[m][n][cl];
+		}
+		responses_text[m] = text.str();
+	}
+
+	char journal_template[] = "/tmp/mclp_server_test_XXXXXX";
+	CPPUNIT_ASSERT(mkdtemp(journal_template) != NULL);
+	std::string journal_directory(journal_template);
+
+	double rho;
+	double gamma;
+	{
+		Boosting::Server server(journal_directory, 1 << 30, false);
+		const char* names[] = { "toy", "dropped" };
+		for (unsigned int pi = 0; pi < 2; ++pi) {
+			std::string name(names[pi]);
+			CPPUNIT_ASSERT_EQUAL(std::string("OK"),
+				server.Handle("create " + name + labels_text.str()));
+			// Without weak learners the LP is infeasible
+			CPPUNIT_ASSERT(server.Handle("update " + name)
+				.compare(0, 4, "ERR ") == 0);
+			for (unsigned int m = 0; m < 4; ++m) {
+				CPPUNIT_ASSERT(server.Handle("add_learner " + name
+					+ responses_text[m]).compare(0, 3, "OK ") == 0);
+				if (m == 1) {
+					CPPUNIT_ASSERT(server.Handle("update " + name)
+						.compare(0, 3, "OK ") == 0);
+				}
+			}
+		}
+		std::istringstream solved(server.Handle("update toy"));
+		std::string status;
+		solved >> status >> rho >> gamma;
+		CPPUNIT_ASSERT_EQUAL(std::string("OK"), status);
+
+		CPPUNIT_ASSERT_EQUAL(std::string("OK"),
+			server.Handle("drop dropped"));
+		CPPUNIT_ASSERT(boost::filesystem::exists(
+			journal_directory + "/dropped.journal") == false);
+		CPPUNIT_ASSERT(server.Handle("update dropped")
+			.compare(0, 4, "ERR ") == 0);
+
+		// Beyond the solver's row index range, refused before allocating
+		CPPUNIT_ASSERT(server.Handle("create big 2000000000 0.3 0 primal 2 0 1")
+			.compare(0, 4, "ERR ") == 0);
+	}
+
+	// A new server rebuilds the problem from its journal, solved cold in
+	// its final state.
+	Boosting::Server server(journal_directory, 1 << 30, false);
+	CPPUNIT_ASSERT(server.Handle("weights toy").compare(0, 7, "OK 3 4 ")
+		== 0);
+	std::istringstream reloaded(server.Handle("update toy"));
+	std::string status;
+	double reloaded_rho;
+	double reloaded_gamma;
+	reloaded >> status >> reloaded_rho >> reloaded_gamma;
+	CPPUNIT_ASSERT_EQUAL(std::string("OK"), status);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(rho, reloaded_rho, 1e-6);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(gamma, reloaded_gamma, 1e-6);
+	CPPUNIT_ASSERT(server.Handle("update dropped")
+		.compare(0, 4, "ERR ") == 0);
+
+	boost::filesystem::remove_all(journal_directory);
+}
+
 int main(int argc, char **argv) {
 	CPPUNIT_NS::TestResult controller;
 	CPPUNIT_NS::TestResultCollector result;
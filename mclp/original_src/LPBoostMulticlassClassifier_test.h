@@ -2,17 +2,68 @@
 #ifndef LPBOOSTMULTICLASSCLASSIFIER_TEST_H
 #define LPBOOSTMULTICLASSCLASSIFIER_TEST_H
 
+#include <vector>
+
 #include <cppunit/extensions/HelperMacros.h>
 
 class LPBoostMulticlassClassifierTest : public CPPUNIT_NS::TestFixture {
 	CPPUNIT_TEST_SUITE(LPBoostMulticlassClassifierTest);
 	CPPUNIT_TEST(LearningSimple);
 	CPPUNIT_TEST(LearningNoise);
+	CPPUNIT_TEST(LearningSparse);
+	CPPUNIT_TEST(RedundantClassifiers);
+	CPPUNIT_TEST(MatrixElementCount);
+	CPPUNIT_TEST(WarmStart);
+	CPPUNIT_TEST(AddSamples);
+	CPPUNIT_TEST(ValidationTracking);
+	CPPUNIT_TEST(DualFormulation);
+	CPPUNIT_TEST(EntropyRegularized);
+	CPPUNIT_TEST(BarrierDenseColumns);
+	CPPUNIT_TEST(ResponseNormalization);
+	CPPUNIT_TEST(SolutionCache);
+	CPPUNIT_TEST(ExternalSolution);
+	CPPUNIT_TEST(StridedResponse);
+	CPPUNIT_TEST(MarginKernels);
+	CPPUNIT_TEST(ScratchAllocations);
+	CPPUNIT_TEST(ResetReuse);
+	CPPUNIT_TEST(SolverRace);
+	CPPUNIT_TEST(ChangeNu);
+	CPPUNIT_TEST(SampleScreening);
+	CPPUNIT_TEST(CoarseToFine);
+	CPPUNIT_TEST(ClassGroups);
+	CPPUNIT_TEST(ServerRoundTrip);
 	CPPUNIT_TEST_SUITE_END();
 
 protected:
+	// Responses resp[m][n][cl] of four weak learners on five samples of
+	// three classes, and the labels of the first number_samples samples.
+	static const double resp[4][5][3];
+	static std::vector<int> Labels(unsigned int number_samples);
+
 	void LearningSimple();
 	void LearningNoise();
+	void LearningSparse();
+	void RedundantClassifiers();
+	void MatrixElementCount();
+	void WarmStart();
+	void AddSamples();
+	void ValidationTracking();
+	void DualFormulation();
+	void EntropyRegularized();
+	void BarrierDenseColumns();
+	void ResponseNormalization();
+	void SolutionCache();
+	void ExternalSolution();
+	void StridedResponse();
+	void MarginKernels();
+	void ScratchAllocations();
+	void ResetReuse();
+	void SolverRace();
+	void ChangeNu();
+	void SampleScreening();
+	void CoarseToFine();
+	void ClassGroups();
+	void ServerRoundTrip();
 };
 
 #endif
@@ -0,0 +1,440 @@
+/* Named multiclass LPBoost problems served by request lines.
+ *
+ * Copyright (C) 2008 -- Sebastian Nowozin <sebastian.nowozin@tuebingen.mpg.de>
+ */
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include <ctype.h>
+
+#include "LPBoostServer.h"
+
+namespace Boosting {
+
+static bool is_command(const std::string& command) {
+	return (command == "create" || command == "add_learner" ||
+		command == "add_samples" || command == "set_nu" ||
+		command == "update" || command == "weights" ||
+		command == "duals" || command == "drop");
+}
+
+static bool is_mutation(const std::string& command) {
+	return (command == "create" || command == "add_learner" ||
+		command == "add_samples" || command == "set_nu" ||
+		command == "update");
+}
+
+static bool valid_name(const std::string& name) {
+	if (name.empty() || name.size() > 200 || name[0] == '.')
+		return (false);
+	for (unsigned int i = 0; i < name.size(); ++i) {
+		char ch = name[i];
+		if (isalnum(static_cast<unsigned char>(ch)) == 0 &&
+			ch != '_' && ch != '-' && ch != '.')
+			return (false);
+	}
+	return (true);
+}
+
+// Read count values, false if there are fewer or more.
+template <typename T>
+static bool read_values(std::istringstream& args, size_t count,
+	std::vector<T>& values) {
+	values.resize(count);
+	for (size_t i = 0; i < count; ++i) {
+		if (!(args >> values[i]))
+			return (false);
+	}
+	std::string rest;
+	return (!(args >> rest));
+}
+
+static bool valid_labels(const std::vector<int>& labels, int number_classes) {
+	for (unsigned int n = 0; n < labels.size(); ++n) {
+		if (labels[n] < 0 || labels[n] >= number_classes)
+			return (false);
+	}
+	return (true);
+}
+
+// Memory of a loaded problem: the LP arrays of the solver, and about as
+// much again for its factorization and our copies of the columns.
+static uint64_t estimate_bytes(
+	const LPBoostMulticlassClassifier& classifier) {
+	LPBoostMulticlassClassifier::LPData lp = classifier.SolverLP();
+	uint64_t bytes = static_cast<uint64_t>(lp.number_elements)
+		* (sizeof(double) + sizeof(int));
+	bytes += static_cast<uint64_t>(lp.number_rows + lp.number_columns)
+		* 8 * sizeof(double);
+	return (2 * bytes);
+}
+
+Server::Server(const std::string& checkpoint_dir, uint64_t memory_budget,
+	bool verbose)
+	: checkpoint_dir(checkpoint_dir), memory_budget(memory_budget),
+		verbose(verbose), use_clock(0), evictions(0), loads(0) {
+}
+
+std::string Server::Handle(const std::string& line) {
+	boost::posix_time::ptime start =
+		boost::posix_time::microsec_clock::universal_time();
+	std::istringstream args(line);
+	std::string command;
+	std::string name;
+	args >> command;
+
+	std::string reply;
+	if (command == "stats") {
+		reply = Statistics();
+	} else if (is_command(command) == false) {
+		return ("ERR unknown command \"" + command + "\"");
+	} else if (!(args >> name) || valid_name(name) == false) {
+		reply = "ERR missing or invalid problem name";
+	} else {
+		reply = Request(command, name, line, args);
+	}
+	Record(command, (boost::posix_time::microsec_clock::universal_time()
+		- start).total_microseconds());
+
+	return (reply);
+}
+
+std::string Server::Request(const std::string& command,
+	const std::string& name, const std::string& line,
+	std::istringstream& args) {
+	boost::shared_ptr<Problem> problem = Find(name, command == "create");
+	if (problem.get() == NULL)
+		return ("ERR unknown problem \"" + name + "\"");
+
+	std::string reply;
+	uint64_t bytes = 0;
+	{
+		boost::mutex::scoped_lock lock(problem->mutex);
+		if (problem->dropped)
+			return ("ERR unknown problem \"" + name + "\"");
+		if (command == "drop") {
+			{
+				// Find must not load the journal of the dropped problem
+				// into a new one.
+				boost::mutex::scoped_lock problems_lock(problems_mutex);
+				boost::system::error_code error;
+				boost::filesystem::remove(problem->journal_path, error);
+				if (error)
+					return ("ERR failed to remove the journal of \"" + name
+						+ "\": " + error.message());
+				problems.erase(name);
+			}
+			problem->dropped = true;
+			delete problem->classifier;
+			problem->classifier = NULL;
+			return ("OK");
+		}
+		if (command != "create" && problem->classifier == NULL &&
+			Load(*problem) == false)
+			return ("ERR failed to load the journal of \"" + name + "\"");
+
+		reply = Execute(*problem, command, args);
+		if (reply.compare(0, 2, "OK") == 0 && is_mutation(command))
+			Journal(*problem, line, command == "create");
+		if (problem->classifier != NULL)
+			bytes = estimate_bytes(*problem->classifier);
+	}
+	Account(problem, bytes);
+
+	return (reply);
+}
+
+std::string Server::Execute(Problem& problem, const std::string& command,
+	std::istringstream& args) {
+	std::ostringstream reply;
+	reply << std::setprecision(17);
+
+	if (command == "create") {
+		int number_classes;
+		double nu;
+		int sharing;
+		std::string formulation_name;
+		unsigned int number_samples;
+		std::vector<int> labels;
+		if (!(args >> number_classes >> nu >> sharing >> formulation_name
+			>> number_samples) || number_classes < 2 ||
+			!(nu > 0.0 && nu <= 1.0) || number_samples == 0)
+			return ("ERR usage: create NAME K NU SHARING FORMULATION N labels");
+		if (LPBoostMulticlassClassifier::FitsSolver(number_samples,
+			number_classes, 0, sharing != 0) == false)
+			return ("ERR problem too large for the LP solver");
+		if (read_values(args, number_samples, labels) == false ||
+			valid_labels(labels, number_classes) == false)
+			return ("ERR usage: create NAME K NU SHARING FORMULATION N labels");
+
+		LPBoostMulticlassClassifier::Formulation formulation;
+		if (formulation_name == "primal") {
+			formulation =
+				LPBoostMulticlassClassifier::PrimalFormulation;
+		} else if (formulation_name == "dual") {
+			formulation =
+				LPBoostMulticlassClassifier::DualFormulation;
+		} else {
+			return ("ERR formulation must be \"primal\" or \"dual\"");
+		}
+		delete problem.classifier;
+		problem.classifier = new LPBoostMulticlassClassifier(
+			number_classes, nu, sharing != 0);
+		problem.classifier->InitializeBoosting(labels, false, "clp",
+			formulation);
+		problem.number_classes = number_classes;
+		problem.weight_sharing = (sharing != 0);
+		problem.number_samples = number_samples;
+		problem.number_learners = 0;
+		problem.solved = false;
+		return ("OK");
+	}
+
+	LPBoostMulticlassClassifier& classifier = *problem.classifier;
+	unsigned int number_classes =
+		static_cast<unsigned int>(problem.number_classes);
+	if (command == "add_learner") {
+		if (LPBoostMulticlassClassifier::FitsSolver(problem.number_samples,
+			problem.number_classes, problem.number_learners + 1,
+			problem.weight_sharing) == false)
+			return ("ERR problem too large for the LP solver");
+		std::vector<double> response;
+		if (read_values(args, static_cast<size_t>(problem.number_samples)
+			* number_classes, response) == false) {
+			reply << "ERR expected " << problem.number_samples << " x "
+				<< number_classes << " responses";
+			return (reply.str());
+		}
+		unsigned int learner_id = classifier.AddMulticlassClassifier(
+			&response[0], number_classes, 1);
+		problem.number_learners = std::max(problem.number_learners,
+			learner_id + 1);
+		problem.solved = false;
+		reply << "OK " << learner_id;
+	} else if (command == "add_samples") {
+		unsigned int number_added;
+		std::vector<int> labels;
+		if (!(args >> number_added) || number_added == 0)
+			return ("ERR usage: add_samples NAME S labels responses");
+		if (LPBoostMulticlassClassifier::FitsSolver(
+			static_cast<uint64_t>(problem.number_samples) + number_added,
+			problem.number_classes, problem.number_learners,
+			problem.weight_sharing) == false)
+			return ("ERR problem too large for the LP solver");
+		labels.resize(number_added);
+		for (unsigned int n = 0; n < number_added; ++n) {
+			if (!(args >> labels[n]))
+				return ("ERR usage: add_samples NAME S labels responses");
+		}
+		unsigned int number_learners = problem.number_learners;
+		std::vector<double> values;
+		if (valid_labels(labels, problem.number_classes) == false ||
+			read_values(args, static_cast<size_t>(number_learners)
+				* number_added * number_classes, values) == false) {
+			reply << "ERR expected " << number_added << " labels and "
+				<< number_learners << " x " << number_added << " x "
+				<< number_classes << " responses";
+			return (reply.str());
+		}
+		std::vector<std::vector<std::vector<double> > > responses(
+			number_learners, std::vector<std::vector<double> >(number_added,
+				std::vector<double>(number_classes)));
+		size_t vi = 0;
+		for (unsigned int m = 0; m < number_learners; ++m) {
+			for (unsigned int n = 0; n < number_added; ++n) {
+				for (unsigned int cl = 0; cl < number_classes; ++cl)
+					responses[m][n][cl] = values[vi++];
+			}
+		}
+		classifier.AddSamples(labels, responses);
+		problem.number_samples += number_added;
+		problem.solved = false;
+		reply << "OK";
+	} else if (command == "set_nu") {
+		double nu;
+		if (!(args >> nu) || !(nu > 0.0 && nu <= 1.0))
+			return ("ERR usage: set_nu NAME NU, 0 < NU <= 1");
+		classifier.SetNu(nu);
+		problem.solved = false;
+		reply << "OK";
+	} else if (command == "update") {
+		if (problem.number_learners == 0)
+			return ("ERR no weak learners to solve for");
+		if (classifier.Update() == false)
+			return ("ERR the LP solver failed");
+		problem.solved = true;
+		reply << "OK " << classifier.Rho() << " " << classifier.Gamma();
+	} else if (command == "weights") {
+		const std::vector<std::vector<double> >& weights =
+			classifier.ClassifierWeights();
+		reply << "OK " << weights.size() << " "
+			<< (weights.empty() ? 0 : weights[0].size());
+		for (unsigned int ci = 0; ci < weights.size(); ++ci) {
+			for (unsigned int m = 0; m < weights[ci].size(); ++m)
+				reply << " " << weights[ci][m];
+		}
+	} else if (command == "duals") {
+		const std::vector<std::vector<double> >& distribution =
+			classifier.MarginDistribution();
+		reply << "OK " << distribution.size() << " " << number_classes;
+		for (unsigned int n = 0; n < distribution.size(); ++n) {
+			for (unsigned int cl = 0; cl < distribution[n].size(); ++cl)
+				reply << " " << distribution[n][cl];
+		}
+	}
+	return (reply.str());
+}
+
+bool Server::Load(Problem& problem) {
+	std::ifstream in(problem.journal_path.c_str());
+	if (in.fail())
+		return (false);
+
+	// The journal holds no solutions, the updates only decide whether the
+	// final problem is solved: once, cold, at the end instead of at each.
+	bool update = false;
+	std::string line;
+	while (std::getline(in, line)) {
+		std::istringstream args(line);
+		std::string command;
+		std::string name;
+		args >> command >> name;
+		if (command == "update") {
+			update = true;
+			continue;
+		}
+		if (command != "create" && problem.classifier == NULL)
+			return (false);
+		if (Execute(problem, command, args).compare(0, 2, "OK") != 0)
+			return (false);
+		update = false;
+	}
+	if (problem.classifier == NULL)
+		return (false);
+	if (update)
+		problem.solved = problem.classifier->Update();
+	if (verbose)
+		std::cout << "Loaded \"" << problem.name << "\"." << std::endl;
+	boost::mutex::scoped_lock lock(problems_mutex);
+	loads += 1;
+	return (true);
+}
+
+void Server::Journal(Problem& problem, const std::string& line,
+	bool truncate) {
+	std::ofstream out(problem.journal_path.c_str(),
+		truncate ? std::ios::trunc : std::ios::app);
+	out << line << "\n";
+	out.flush();
+	if (out.fail()) {
+		// Keep it in memory, the journal cannot rebuild it.
+		std::cerr << "Failed to write the journal \"" << problem.journal_path
+			<< "\", \"" << problem.name << "\" is kept in memory."
+			<< std::endl;
+		problem.durable = false;
+	} else if (truncate) {
+		problem.durable = true;
+	}
+}
+
+boost::shared_ptr<Problem> Server::Find(const std::string& name,
+	bool create) {
+	boost::mutex::scoped_lock lock(problems_mutex);
+	std::map<std::string, boost::shared_ptr<Problem> >::iterator it =
+		problems.find(name);
+	if (it != problems.end())
+		return (it->second);
+
+	std::string journal_path =
+		(boost::filesystem::path(checkpoint_dir) / (name + ".journal"))
+			.string();
+	if (create == false && boost::filesystem::exists(journal_path) == false)
+		return (boost::shared_ptr<Problem>());
+	boost::shared_ptr<Problem> problem(new Problem);
+	problem->name = name;
+	problem->journal_path = journal_path;
+	problems[name] = problem;
+	return (problem);
+}
+
+void Server::Account(const boost::shared_ptr<Problem>& problem,
+	uint64_t bytes) {
+	boost::mutex::scoped_lock lock(problems_mutex);
+	problem->bytes = bytes;
+	problem->last_use = ++use_clock;
+
+	uint64_t total = 0;
+	std::vector<std::pair<uint64_t, Problem*> > by_use;
+	std::map<std::string, boost::shared_ptr<Problem> >::iterator it;
+	for (it = problems.begin(); it != problems.end(); ++it) {
+		total += it->second->bytes;
+		if (it->second->bytes > 0 && it->second != problem)
+			by_use.push_back(std::make_pair(it->second->last_use,
+				it->second.get()));
+	}
+	std::sort(by_use.begin(), by_use.end());
+
+	// Least recently used first, skipping problems busy with a request.
+	for (unsigned int pi = 0; pi < by_use.size() && total > memory_budget;
+		++pi) {
+		Problem* victim = by_use[pi].second;
+		boost::mutex::scoped_try_lock victim_lock(victim->mutex);
+		if (victim_lock.owns_lock() == false || victim->durable == false)
+			continue;
+		delete victim->classifier;
+		victim->classifier = NULL;
+		total -= victim->bytes;
+		victim->bytes = 0;
+		evictions += 1;
+		if (verbose)
+			std::cout << "Evicted \"" << victim->name << "\"." << std::endl;
+	}
+}
+
+void Server::Record(const std::string& command, uint64_t microseconds) {
+	boost::mutex::scoped_lock lock(latency_mutex);
+	Latency& latency = latencies[command];
+	latency.count += 1;
+	latency.total_us += microseconds;
+	latency.max_us = std::max(latency.max_us, microseconds);
+	unsigned int bucket = 0;
+	while (bucket < 31 && (static_cast<uint64_t>(1) << bucket) <= microseconds)
+		bucket += 1;
+	latency.histogram[bucket] += 1;
+}
+
+std::string Server::Statistics() {
+	std::ostringstream reply;
+	{
+		boost::mutex::scoped_lock lock(problems_mutex);
+		unsigned int loaded = 0;
+		uint64_t total = 0;
+		std::map<std::string, boost::shared_ptr<Problem> >::iterator it;
+		for (it = problems.begin(); it != problems.end(); ++it) {
+			loaded += (it->second->bytes > 0) ? 1 : 0;
+			total += it->second->bytes;
+		}
+		reply << "OK problems " << problems.size() << " loaded " << loaded
+			<< " bytes " << total << " budget " << memory_budget
+			<< " evictions " << evictions << " loads " << loads;
+	}
+	// Per command: count, mean, p50, p99 and max latency in microseconds.
+	boost::mutex::scoped_lock lock(latency_mutex);
+	std::map<std::string, Latency>::const_iterator it;
+	for (it = latencies.begin(); it != latencies.end(); ++it) {
+		const Latency& latency = it->second;
+		reply << " " << it->first << " " << latency.count << " "
+			<< latency.total_us / std::max(1u, latency.count) << " "
+			<< latency.Quantile(0.5) << " " << latency.Quantile(0.99) << " "
+			<< latency.max_us;
+	}
+	return (reply.str());
+}
+
+}
+
@@ -0,0 +1,155 @@
+/* Named multiclass LPBoost problems served by request lines, the state of
+ * the training daemon mclpd.  Keeps the problems and their solved LPs in
+ * memory between requests, so that a job adding a few weak learners to a
+ * problem continues from the last basis instead of paying for process
+ * start-up, reading the data and a cold solve.
+ *
+ * Protocol: one request per line, answered by one line, "OK ..." or
+ * "ERR <message>".  Values are separated by whitespace, responses are
+ * row-major over samples and classes.
+ *
+ *   create NAME K NU SHARING FORMULATION N y_1 ... y_N
+ *       New problem (or restart of NAME) with K classes and N samples,
+ *       SHARING 0 or 1, FORMULATION "primal" or "dual".
+ *   add_learner NAME r_11 ... r_NK           -> OK <learner id>
+ *   add_samples NAME S y_1 ... y_S <the S x K responses of each weak
+ *       learner added so far, in order>
+ *   set_nu NAME NU
+ *   update NAME                              -> OK <rho> <gamma>
+ *   weights NAME                             -> OK <rows> <M> <weights>
+ *   duals NAME                               -> OK <N> <K> <distribution>
+ *   drop NAME
+ *   stats                                    -> OK <counters> <latencies>
+ *
+ * update fails with ERR before the first weak learner and when the LP
+ * solver fails, and create, add_learner and add_samples when the LP would
+ * exceed the solver's row or element index range.
+ *
+ * Requests on one problem are serialized, different problems are served
+ * concurrently.  Every request changing a problem is appended to its
+ * journal NAME.journal in the checkpoint directory.  Beyond the memory
+ * budget the least recently used problems are evicted and rebuilt from
+ * their journal when next used; problems journaled by an earlier run are
+ * loaded the same way.  The journal holds the requests, not the solutions:
+ * a rebuilt problem is solved once, cold, in its final state if its last
+ * request was an update.  Its weights are then an optimal solution of the
+ * final problem, possibly a different one of several optima, and the
+ * solutions of the earlier updates are not reproduced.
+ *
+ * Copyright (C) 2008 -- Sebastian Nowozin <sebastian.nowozin@tuebingen.mpg.de>
+ */
+
+#ifndef BOOSTING_LPBOOSTSERVER_H
+#define BOOSTING_LPBOOSTSERVER_H
+
+#include <string>
+#include <sstream>
+#include <map>
+#include <algorithm>
+
+#include <stdint.h>
+#include <math.h>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "LPBoostMulticlassClassifier.h"
+
+namespace Boosting {
+
+// A named problem, its classifier NULL while evicted.
+struct Problem {
+	Problem() : classifier(NULL), number_classes(0), weight_sharing(false),
+		number_samples(0), number_learners(0), solved(false), dropped(false),
+		durable(true), bytes(0), last_use(0) {
+	}
+	~Problem() {
+		delete classifier;
+	}
+
+	boost::mutex mutex;	// Serializes the requests on the problem
+	std::string name;
+	std::string journal_path;
+	LPBoostMulticlassClassifier* classifier;
+	int number_classes;
+	bool weight_sharing;
+	unsigned int number_samples;
+	unsigned int number_learners;
+	bool solved;	// Updated since the last change
+	bool dropped;
+	bool durable;	// The journal holds all changes, it can be evicted
+	// Guarded by the server's problems_mutex
+	uint64_t bytes;	// Estimated memory while loaded
+	uint64_t last_use;
+};
+
+// Request latencies of one command.
+struct Latency {
+	Latency() : count(0), total_us(0), max_us(0) {
+		std::fill(histogram, histogram + 32, 0u);
+	}
+	unsigned int count;
+	uint64_t total_us;
+	uint64_t max_us;
+	unsigned int histogram[32];	// bucket b: [2^(b-1), 2^b) microseconds
+
+	// Upper bound of the fraction q quantile.
+	uint64_t Quantile(double q) const {
+		unsigned int rank = static_cast<unsigned int>(ceil(q * count));
+		unsigned int seen = 0;
+		for (unsigned int b = 0; b < 32; ++b) {
+			seen += histogram[b];
+			if (seen >= rank && seen > 0)
+				return (std::min(max_us, (static_cast<uint64_t>(1) << b)));
+		}
+		return (max_us);
+	}
+};
+
+class Server {
+public:
+	/* checkpoint_dir: Existing directory of the problem journals.
+	 * memory_budget: Bytes of loaded problems beyond which the least
+	 *   recently used are evicted.
+	 */
+	Server(const std::string& checkpoint_dir, uint64_t memory_budget,
+		bool verbose);
+
+	/* Answer one request line, without its newline.  Thread-safe.
+	 */
+	std::string Handle(const std::string& line);
+
+private:
+	std::string Request(const std::string& command, const std::string& name,
+		const std::string& line, std::istringstream& args);
+	// Apply a command to a loaded problem, or a create.
+	std::string Execute(Problem& problem, const std::string& command,
+		std::istringstream& args);
+	// Rebuild an evicted problem from its journal.
+	bool Load(Problem& problem);
+	void Journal(Problem& problem, const std::string& line, bool truncate);
+	// Problem of the name, created if create or journaled earlier.
+	boost::shared_ptr<Problem> Find(const std::string& name, bool create);
+	// Record the memory of a problem just used and evict beyond the budget.
+	void Account(const boost::shared_ptr<Problem>& problem, uint64_t bytes);
+	void Record(const std::string& command, uint64_t microseconds);
+	std::string Statistics();
+
+	std::string checkpoint_dir;
+	uint64_t memory_budget;
+	bool verbose;
+
+	boost::mutex problems_mutex;
+	std::map<std::string, boost::shared_ptr<Problem> > problems;
+	uint64_t use_clock;
+	unsigned int evictions;
+	unsigned int loads;
+
+	boost::mutex latency_mutex;
+	std::map<std::string, Latency> latencies;
+};
+
+}
+
+#endif
+
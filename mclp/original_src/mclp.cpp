@@ -16,6 +16,10 @@
 #include <boost/lambda/lambda.hpp>
 #include <boost/lambda/bind.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 
 #include <assert.h>
 #include <stdlib.h>
@@ -72,7 +76,9 @@ read_problem(const std::string& train_filename,
 	return (max_label + 1);
 }
 
-static unsigned int count_lines(const std::string& filename) {
+// Count the lines of a file, empty lines only if count_empty.
+static unsigned int count_lines(const std::string& filename,
+	bool count_empty) {
 	std::ifstream in(filename.c_str());
 	if (in.fail()) {
 		std::cerr << "count_lines, failed to open \"" << filename
@@ -81,9 +87,8 @@ static unsigned int count_lines(const std::string& filename) {
 	}
 	unsigned int lines = 0;
 	std::string line;
-	while (in.eof() == false) {
-		std::getline(in, line);
-		if (line.size() == 0)
+	while (std::getline(in, line)) {
+		if (line.size() == 0 && count_empty == false)
 			continue;
 		lines += 1;
 	}
@@ -91,16 +96,204 @@ static unsigned int count_lines(const std::string& filename) {
 	return (lines);
 }
 
-static void read_problem_data(Boosting::LPBoostMulticlassClassifier& mlp,
-	std::vector<std::vector<std::string> >& data_S_M, int number_classes) {
-	// responses[m][n][cl], the m'th weak learner, n'th sample, cl'th class
-	// response
-	std::vector<std::vector<std::vector<double> > > responses;
+// A problem over the weak learner responses of the training file: its
+// labels on a subset of the samples and the response column of each of its
+// classes.  Without --tasks there is one, of the training labels.
+struct Task {
+	Task() : nu(0.1), number_classes(0), identity(true), mlp(NULL),
+		seconds(0.0), solved(false) {
+	}
+	std::string output_filename;
+	double nu;
+	int number_classes;
+	std::vector<int> labels;	// Of the task samples
+	std::vector<unsigned int> samples;	// Training sample of each
+	std::vector<int> columns;	// Response column of each class
+	bool identity;	// All samples, class k is response column k
+	Boosting::LPBoostMulticlassClassifier* mlp;
+	std::vector<unsigned int> learner_ids;	// Of each weak learner read
+	double seconds;	// Wall time of the solve
+	bool solved;	// The LP solver succeeded
+};
+
+// Read the tasks file, lines "output nu labels_file [column ...]".  The
+// labels file holds one label per training sample, -1 to leave the sample
+// out.  The columns map the task classes to response columns, by default
+// all number_classes of them.  Returns false on failure.
+static bool read_tasks(const std::string& tasks_filename,
+	unsigned int number_samples, int number_classes,
+	std::vector<Task>& tasks) {
+	std::ifstream in(tasks_filename.c_str());
+	if (in.fail())
+		return (false);
+
+	std::string line;
+	while (std::getline(in, line)) {
+		std::istringstream is(line);
+		Task task;
+		std::string labels_filename;
+		if (!(is >> task.output_filename))
+			continue;	// skip over empty lines
+		if (task.output_filename[0] == '#')
+			continue;
+		if (!(is >> task.nu >> labels_filename) ||
+			task.nu <= 0.0 || task.nu > 1.0) {
+			std::cerr << "Task \"" << task.output_filename << "\": expected "
+				<< "\"output nu labels_file [column ...]\"." << std::endl;
+			return (false);
+		}
+		int column;
+		while (is >> column) {
+			if (column < 0 || column >= number_classes) {
+				std::cerr << "Task \"" << task.output_filename << "\": "
+					<< "response column " << column << " out of range."
+					<< std::endl;
+				return (false);
+			}
+			task.columns.push_back(column);
+		}
+		if (task.columns.empty()) {
+			for (int cl = 0; cl < number_classes; ++cl)
+				task.columns.push_back(cl);
+		}
+		task.number_classes = task.columns.size();
+
+		std::ifstream lin(labels_filename.c_str());
+		int label;
+		unsigned int n = 0;
+		while (lin >> label) {
+			if (label >= task.number_classes || label < -1) {
+				std::cerr << "Task \"" << task.output_filename << "\": "
+					<< "label " << label << " out of range." << std::endl;
+				return (false);
+			}
+			if (label >= 0) {
+				task.labels.push_back(label);
+				task.samples.push_back(n);
+			}
+			n += 1;
+		}
+		if (lin.fail() && lin.eof() == false) {
+			std::cerr << "Failed to read labels \"" << labels_filename
+				<< "\"." << std::endl;
+			return (false);
+		}
+		if (n != number_samples || task.labels.empty()) {
+			std::cerr << "Task \"" << task.output_filename << "\": "
+				<< labels_filename << " has " << n << " labels, "
+				<< task.labels.size() << " used, for " << number_samples
+				<< " samples." << std::endl;
+			return (false);
+		}
+		task.identity = (task.samples.size() == number_samples &&
+			task.number_classes == number_classes);
+		for (int cl = 0; task.identity && cl < number_classes; ++cl)
+			task.identity = (task.columns[cl] == cl);
+		tasks.push_back(task);
+	}
+	return (tasks.empty() == false);
+}
+
+// Add the responses of weak learner m to a task.
+static unsigned int add_task_learner(Task& task, int number_classes,
+	const std::vector<double>& responses, const std::vector<unsigned int>&
+	sparse_start, const std::vector<int>& sparse_classes,
+	const std::vector<double>& sparse_values, bool sparse) {
+	if (task.identity && sparse) {
+		return (task.mlp->AddMulticlassClassifierSparse(sparse_start,
+			sparse_classes, sparse_values));
+	} else if (task.identity) {
+		return (task.mlp->AddMulticlassClassifier(&responses[0],
+			number_classes, 1));
+	}
+
+	// Gather the task samples and class columns.
+	if (sparse) {
+		std::vector<std::vector<int> > column_classes(number_classes);
+		for (int cl = 0; cl < task.number_classes; ++cl)
+			column_classes[task.columns[cl]].push_back(cl);
+		std::vector<unsigned int> start;
+		std::vector<int> classes;
+		std::vector<double> values;
+		for (unsigned int i = 0; i < task.samples.size(); ++i) {
+			unsigned int n = task.samples[i];
+			start.push_back(classes.size());
+			for (unsigned int ei = sparse_start[n]; ei < sparse_start[n + 1];
+				++ei) {
+				const std::vector<int>& mapped =
+					column_classes[sparse_classes[ei]];
+				for (unsigned int ci = 0; ci < mapped.size(); ++ci) {
+					classes.push_back(mapped[ci]);
+					values.push_back(sparse_values[ei]);
+				}
+			}
+		}
+		start.push_back(classes.size());
+		return (task.mlp->AddMulticlassClassifierSparse(start, classes,
+			values));
+	}
+	std::vector<double> response(task.samples.size() * task.number_classes);
+	for (unsigned int i = 0; i < task.samples.size(); ++i) {
+		const double* row = &responses[task.samples[i] * number_classes];
+		for (int cl = 0; cl < task.number_classes; ++cl)
+			response[i * task.number_classes + cl] = row[task.columns[cl]];
+	}
+	return (task.mlp->AddMulticlassClassifier(&response[0],
+		task.number_classes, 1));
+}
+
+// Group the classes of every task by the confusion of the unweighted vote
+// of the weak learners, given by the summed responses score[n*K + cl] of
+// each training sample n and response column cl.
+static void group_task_classes(std::vector<Task>& tasks,
+	const std::vector<double>& score, int number_classes,
+	unsigned int number_groups) {
+	for (unsigned int ti = 0; ti < tasks.size(); ++ti) {
+		Task& task = tasks[ti];
+		std::vector<std::vector<double> > confusion(task.number_classes,
+			std::vector<double>(task.number_classes, 0.0));
+		for (unsigned int i = 0; i < task.samples.size(); ++i) {
+			const double* row = &score[task.samples[i] * number_classes];
+			int predicted = 0;
+			for (int cl = 1; cl < task.number_classes; ++cl) {
+				if (row[task.columns[cl]] > row[task.columns[predicted]])
+					predicted = cl;
+			}
+			confusion[task.labels[i]][predicted] += 1.0;
+		}
+		std::vector<int> class_groups = Boosting::LPBoostMulticlassClassifier::
+			GroupClassesByConfusion(confusion, number_groups);
+		task.mlp->SetClassGroups(class_groups);
+
+		if (tasks.size() > 1)
+			std::cout << task.output_filename << ": ";
+		std::cout << "Class groups";
+		for (int cl = 0; cl < task.number_classes; ++cl)
+			std::cout << " " << class_groups[cl];
+		std::cout << std::endl;
+	}
+}
+
+// Read the weak learner responses once, adding them to every task.  Sets
+// the learner id each task assigned to each weak learner read.  If
+// number_groups is positive, the classes of each task are grouped first,
+// see group_task_classes.
+static void read_problem_data(std::vector<Task>& tasks,
+	std::vector<std::vector<std::string> >& data_S_M, int number_classes,
+	bool weight_sharing, bool sparse, unsigned int number_groups) {
+	// responses[m][n*K + cl], the m'th weak learner, n'th sample, cl'th
+	// class response
+	std::vector<std::vector<double> > responses;
+	// Sparse responses of the m'th weak learner in compressed row format,
+	// the non-zeros of sample n start at sparse_start[m][n].
+	std::vector<std::vector<unsigned int> > sparse_start;
+	std::vector<std::vector<int> > sparse_classes;
+	std::vector<std::vector<double> > sparse_values;
 
 	// Obtain number of weak learners
 	unsigned int number_classifiers = 0;
 	for (unsigned int j = 0; j < data_S_M[0].size(); ++j) {
-		unsigned int linecount_cur = count_lines(data_S_M[0][j]);
+		unsigned int linecount_cur = count_lines(data_S_M[0][j], sparse);
 		std::cout << "   input partition " << j << ", "
 			<< linecount_cur << " weak learners" << std::endl;
 		number_classifiers += linecount_cur;
@@ -110,11 +303,32 @@ static void read_problem_data(Boosting::LPBoostMulticlassClassifier& mlp,
 	std::cout << "Total number of weak learners is "
 		<< number_classifiers << std::endl;
 
-	responses.resize(number_classifiers);
-	for (unsigned int mi = 0; mi < number_classifiers; ++mi) {
-		responses[mi].resize(data_S_M.size());
-		for (unsigned int n = 0; n < data_S_M.size(); ++n)
-			responses[mi][n].resize(number_classes);
+	// Dense responses fill the constraint matrix, check it fits before
+	// reading anything.
+	for (unsigned int ti = 0; ti < tasks.size(); ++ti) {
+		uint64_t matrix_elements =
+			Boosting::LPBoostMulticlassClassifier::MatrixElements(
+				tasks[ti].samples.size(), tasks[ti].number_classes,
+				number_classifiers, weight_sharing);
+		if (sparse == false && matrix_elements >
+			Boosting::LPBoostMulticlassClassifier::MaximumMatrixElements()) {
+			std::cerr << "The constraint matrix needs " << matrix_elements
+				<< " elements, the LP solver supports at most "
+				<< Boosting::LPBoostMulticlassClassifier::MaximumMatrixElements()
+				<< ".  Use sparse responses or a solver build with 64-bit "
+				<< "CoinBigIndex." << std::endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (sparse) {
+		sparse_start.resize(number_classifiers);
+		sparse_classes.resize(number_classifiers);
+		sparse_values.resize(number_classifiers);
+	} else {
+		responses.resize(number_classifiers);
+		for (unsigned int mi = 0; mi < number_classifiers; ++mi)
+			responses[mi].resize(data_S_M.size() * number_classes);
 	}
 
 	int fixed_m = -1;
@@ -130,17 +344,33 @@ static void read_problem_data(Boosting::LPBoostMulticlassClassifier& mlp,
 					<< n << "." << std::endl;
 				exit(EXIT_FAILURE);
 			}
-			// M rows, K responses each, linewise read
+			// M rows, K responses each, linewise read.  An empty sparse
+			// line is a weak learner without non-zero response.
 			std::string line;
-			while (in.eof() == false) {
-				std::getline(in, line);
-				if (line.size() == 0)
+			while (std::getline(in, line)) {
+				if (line.size() == 0 && sparse == false)
 					continue;	// skip over empty lines
 
 				std::istringstream is(line);
-				for (int cl = 0; cl < number_classes; ++cl) {
-					assert(is.eof() == false);
-					is >> responses[m][n][cl];
+				if (sparse) {
+					// Sparse line format: class:value class:value ...
+					sparse_start[m].push_back(sparse_classes[m].size());
+					int cl;
+					char sep;
+					double value;
+					while (is >> cl >> sep >> value) {
+						assert(sep == ':');
+						assert(cl >= 0 && cl < number_classes);
+						if (value == 0.0)
+							continue;
+						sparse_classes[m].push_back(cl);
+						sparse_values[m].push_back(value);
+					}
+				} else {
+					for (int cl = 0; cl < number_classes; ++cl) {
+						assert(is.eof() == false);
+						is >> responses[m][n * number_classes + cl];
+					}
 				}
 				m += 1;	// next weak learner
 			}
@@ -155,23 +385,213 @@ static void read_problem_data(Boosting::LPBoostMulticlassClassifier& mlp,
 		}
 	}
 
-	// Add weak learner responses to multiclass LP
+	for (unsigned int m = 0; sparse && m < number_classifiers; ++m)
+		sparse_start[m].push_back(sparse_classes[m].size());
+
+	if (number_groups > 0) {
+		std::vector<double> score(data_S_M.size() * number_classes, 0.0);
+		for (unsigned int m = 0; m < number_classifiers; ++m) {
+			if (sparse) {
+				for (unsigned int n = 0; n < data_S_M.size(); ++n) {
+					for (unsigned int ei = sparse_start[m][n];
+						ei < sparse_start[m][n + 1]; ++ei) {
+						score[n * number_classes + sparse_classes[m][ei]] +=
+							sparse_values[m][ei];
+					}
+				}
+			} else {
+				for (unsigned int ei = 0; ei < score.size(); ++ei)
+					score[ei] += responses[m][ei];
+			}
+		}
+		group_task_classes(tasks, score, number_classes, number_groups);
+	}
+
+	// Add weak learner responses to the multiclass LP of every task
+	std::vector<double> no_responses;
+	for (unsigned int ti = 0; ti < tasks.size(); ++ti)
+		tasks[ti].learner_ids.resize(number_classifiers);
 	for (unsigned int m = 0; m < number_classifiers; ++m) {
-		mlp.AddMulticlassClassifier(responses[m]);
-		responses[m].clear();	// free some memory now
+		for (unsigned int ti = 0; ti < tasks.size(); ++ti) {
+			tasks[ti].learner_ids[m] = sparse ?
+				add_task_learner(tasks[ti], number_classes, no_responses,
+					sparse_start[m], sparse_classes[m], sparse_values[m],
+					true) :
+				add_task_learner(tasks[ti], number_classes, responses[m],
+					std::vector<unsigned int>(), std::vector<int>(),
+					no_responses, false);
+		}
+		if (sparse) {
+			sparse_start[m].clear();	// free some memory now
+			sparse_classes[m].clear();
+			sparse_values[m].clear();
+		} else {
+			std::vector<double>().swap(responses[m]);	// free memory now
+		}
+	}
+}
+
+// Read a weight matrix as written by mclp, one row per line.  Returns false
+// on failure.
+static bool read_weights(const std::string& weights_filename,
+	std::vector<std::vector<double> >& weights) {
+	weights.clear();
+	std::ifstream in(weights_filename.c_str());
+	if (in.fail())
+		return (false);
+
+	std::string line;
+	while (in.eof() == false) {
+		std::getline(in, line);
+		if (line.size() == 0)
+			continue;
+
+		std::istringstream is(line);
+		weights.push_back(std::vector<double>());
+		double value;
+		while (is >> value)
+			weights.back().push_back(value);
 	}
+	in.close();
+
+	return (true);
+}
+
+// Read the group of each class, whitespace separated.  Returns false on
+// failure.
+static bool read_class_groups(const std::string& groups_filename,
+	std::vector<int>& class_groups) {
+	class_groups.clear();
+	std::ifstream in(groups_filename.c_str());
+	if (in.fail())
+		return (false);
+
+	int group;
+	while (in >> group)
+		class_groups.push_back(group);
+	return (in.eof());
+}
+
+// Solve the tasks on a pool of threads, each taking the next unsolved task.
+// The problems share nothing but the responses already copied into them.
+static void solve_task_worker(std::vector<Task>* tasks, unsigned int* next,
+	boost::mutex* next_mutex) {
+	while (true) {
+		unsigned int ti;
+		{
+			boost::mutex::scoped_lock lock(*next_mutex);
+			if (*next >= tasks->size())
+				return;
+			ti = (*next)++;
+		}
+		boost::posix_time::ptime start =
+			boost::posix_time::microsec_clock::universal_time();
+		(*tasks)[ti].solved = (*tasks)[ti].mlp->Update();
+		(*tasks)[ti].seconds = (boost::posix_time::microsec_clock::
+			universal_time() - start).total_microseconds() * 1e-6;
+	}
+}
+
+static void solve_tasks(std::vector<Task>& tasks, unsigned int threads) {
+	if (threads == 0)
+		threads = boost::thread::hardware_concurrency();
+	if (threads == 0)
+		threads = 1;
+	if (threads > tasks.size())
+		threads = tasks.size();
+
+	unsigned int next = 0;
+	boost::mutex next_mutex;
+	if (threads <= 1) {
+		solve_task_worker(&tasks, &next, &next_mutex);
+		return;
+	}
+	boost::thread_group workers;
+	for (unsigned int ti = 0; ti < threads; ++ti) {
+		workers.create_thread(boost::bind(&solve_task_worker, &tasks, &next,
+			&next_mutex));
+	}
+	workers.join_all();
+}
+
+// Write the weights of a solved task, for the responses as given
+static void write_weights(const Task& task, bool binary_output) {
+	const std::vector<unsigned int>& learner_ids = task.learner_ids;
+	std::vector<std::vector<double> > clw = task.mlp->RawClassifierWeights();
+	std::cout << "Writing (K,M) weight matrix to \""
+		<< task.output_filename << "\", K = " << clw.size()
+		<< ", M = " << learner_ids.size() << std::endl;
+
+	std::ofstream wout(task.output_filename.c_str(),
+		binary_output ? std::ios::binary : std::ios::out);
+	if (wout.fail()) {
+		std::cerr << "Failed to open \"" << task.output_filename
+			<< "\" for writing." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	if (binary_output) {
+		static const char magic[8] = { 'M', 'C', 'L', 'P', 'M', '1', 0, 0 };
+		uint32_t dims[2] = { static_cast<uint32_t>(clw.size()),
+			static_cast<uint32_t>(learner_ids.size()) };
+		wout.write(magic, sizeof(magic));
+		wout.write(reinterpret_cast<const char*>(dims), sizeof(dims));
+	}
+	wout << std::setprecision(12);
+	for (unsigned int aidx = 0; aidx < clw.size(); ++aidx) {
+		// The weight of a learner goes to the first weak learner mapped to
+		// it, dropped redundant learners get zero weight.
+		std::vector<bool> written(clw[aidx].size(), false);
+		for (unsigned int bidx = 0; bidx < learner_ids.size(); ++bidx) {
+			double weight = 0.0;
+			if (written[learner_ids[bidx]] == false) {
+				weight = clw[aidx][learner_ids[bidx]];
+				written[learner_ids[bidx]] = true;
+			}
+			if (binary_output) {
+				wout.write(reinterpret_cast<const char*>(&weight),
+					sizeof(weight));
+			} else {
+				wout << (bidx == 0 ? "" : " ") << weight;
+			}
+		}
+		if (binary_output == false)
+			wout << std::endl;
+	}
+	wout.close();
 }
 
 int main(int argc, char* argv[]) {
 	bool verbose;
 	bool interior_point;
+	unsigned int barrier_threads;
+	bool race;
+	double screen;
+	unsigned int coarse_levels;
+	double coarse_fraction;
+	std::string class_groups_filename;
+	unsigned int number_groups;
+	std::string normalize;
+	std::string cache_dir;
+	unsigned int cache_size;
+	int lp_scaling;
 	double nu;
 	bool weight_sharing;
 	bool force;
+	bool sparse;
+	bool redundant;
+	bool redundant_dominated;
+	double redundant_epsilon;
+	bool binary_output;
+	bool dual;
+	double entropy_epsilon;
 	std::string train_filename;
 	std::string output_filename;
 	std::string solver;
 	std::string mpsfile;
+	std::string init_weights_filename;
+	double init_rho = 0.0;
+	std::string tasks_filename;
+	unsigned int task_threads;
 
 	// Command line options
 	po::options_description generic("Generic Options");
@@ -192,11 +612,37 @@ int main(int argc, char* argv[]) {
 			"used, this is a single line containing the alpha vector.  If "
 			"no weight sharing is used, it is a matrix with number-of-classes "
 			"rows and number-of-weak-learners columns.")
+		("binary_output", po::value<bool>(&binary_output)->default_value(false),
+			"Write the weight matrix in binary as 8 bytes \"MCLPM1\\0\\0\", "
+			"uint32 rows, uint32 columns and the float64 weights row-major, "
+			"for mclp_predict.")
 		("force", po::value<bool>(&force)->default_value(false),
 			"Force overwriting the output file.  Otherwise, if the "
 			"output file already exists, the program is aborted immediately.")
 		("writemps", po::value<std::string>(&mpsfile)->default_value(""),
 			"Write linear programming problem as MPS file.")
+		("init_weights", po::value<std::string>
+			(&init_weights_filename)->default_value(""),
+			"Warm start from the weight matrix of a previous model, as "
+			"written to --output, for example when retraining on refreshed "
+			"data.  Only used by the simplex solver, \"--interior_point 0\".")
+		("init_rho", po::value<double>(&init_rho),
+			"Margin rho of the --init_weights model.  If not given, the "
+			"best margin for the initial weights is used.")
+		("tasks", po::value<std::string>(&tasks_filename)->default_value(""),
+			"Train several problems over the weak learner responses read "
+			"once, one per line \"output nu labels_file [column ...]\".  "
+			"labels_file holds a label per training sample, -1 leaves the "
+			"sample out; the columns map the task classes to response "
+			"columns, by default all of them.  Replaces --output and --nu.")
+		("task_threads",
+			po::value<unsigned int>(&task_threads)->default_value(0),
+			"Threads solving --tasks problems, 0 for one per core.")
+		("sparse", po::value<bool>(&sparse)->default_value(false),
+			"Weak learner responses are given sparsely as "
+			"\"class:value class:value ...\" lines, unlisted responses are "
+			"zero.  An empty line is a weak learner without non-zero "
+			"response for the sample, every line counts.")
 		;
 
 	po::options_description lpboost_options("LPBoost Options");
@@ -206,12 +652,80 @@ int main(int argc, char* argv[]) {
 			"indicates stronger regularization")
 		("weight_sharing", po::value<bool>(&weight_sharing)->default_value(true),
 			"Share classifier weights among all classes.")
+		("class_groups", po::value<std::string>
+			(&class_groups_filename)->default_value(""),
+			"File with the group of each class, the classes of a group share "
+			"their weights.  Overrides --weight_sharing; the output has a "
+			"row per class.")
+		("groups", po::value<unsigned int>(&number_groups)->default_value(0),
+			"If positive, share weights within this many groups of classes, "
+			"merging the classes most confused by the unweighted vote of "
+			"the weak learners first.  Overrides --weight_sharing; the "
+			"output has a row per class.")
 		("interior_point",
 			po::value<bool>(&interior_point)->default_value(true),
 			"Use interior point (true) or simplex method (false) to "
 			"solve the LPBoost master problem")
+		("barrier_threads",
+			po::value<unsigned int>(&barrier_threads)->default_value(0),
+			"Threads of the Cholesky factorization of the barrier solver, "
+			"0 for the default of the backend Clp was built with.  Needs "
+			"-fopenmp or -DHAS_OPENBLAS in CHOLESKY_FLAGS.")
+		("race", po::value<bool>(&race)->default_value(false),
+			"Run dual simplex and the barrier solver concurrently and take "
+			"the first solution, overriding --interior_point.  Clp only.")
+		("screen", po::value<double>(&screen)->default_value(0.0),
+			"If positive, relax the margin rows of samples whose margin "
+			"exceeds rho by this much and which have no dual weight, so the "
+			"simplex skips them; a heuristic, any sample a later solve "
+			"violates is put back.  Primal formulation only.")
+		("coarse_levels",
+			po::value<unsigned int>(&coarse_levels)->default_value(0),
+			"Solve on this many growing subsamples of each class first and "
+			"start the simplex solve of all samples from the result.  "
+			"Primal formulation, \"--interior_point 0\" only.")
+		("coarse_fraction",
+			po::value<double>(&coarse_fraction)->default_value(0.1),
+			"Fraction of each class in the first --coarse_levels subsample.")
 		("solver", po::value<std::string>(&solver)->default_value("clp"),
 			"LP solver to use.  One of \"clp\" or \"mosek\".")
+		("dual", po::value<bool>(&dual)->default_value(false),
+			"Solve the dual LP, over a distribution on the samples, instead "
+			"of the primal.  Faster if the number of samples times the "
+			"number of classes is much larger than the number of weak "
+			"learner weights.  See mclpbench.")
+		("entropy_epsilon",
+			po::value<double>(&entropy_epsilon)->default_value(0.0),
+			"If positive, solve the entropy regularized problem (ERLPBoost) "
+			"to within this tolerance of the optimal soft margin instead of "
+			"the LP.")
+		("normalize", po::value<std::string>(&normalize)->default_value("none"),
+			"Normalize the responses of each weak learner: \"none\", "
+			"\"maxabs\" (margin coefficients at most one in magnitude) or "
+			"\"std\" (unit standard deviation).  The weights written apply "
+			"to the responses as given.")
+		("cache_dir", po::value<std::string>(&cache_dir)->default_value(""),
+			"Directory of a cache of solved problems.  A rerun on the same "
+			"labels, weak learners and options restores the weights "
+			"without solving; with more weak learners it starts from the "
+			"cached basis.")
+		("cache_size", po::value<unsigned int>(&cache_size)->default_value(1024),
+			"Size limit of --cache_dir in megabytes, least recently used "
+			"entries are removed first.")
+		("lp_scaling", po::value<int>(&lp_scaling)->default_value(-1),
+			"Clp scaling of the LP: 0 off, 1 equilibrium, 2 geometric, "
+			"3 automatic, -1 the default of Clp.")
+		("redundant", po::value<bool>(&redundant)->default_value(false),
+			"Drop weak learners whose responses duplicate those of an "
+			"earlier weak learner.  Dropped weak learners get zero weight "
+			"in the output.")
+		("redundant_epsilon",
+			po::value<double>(&redundant_epsilon)->default_value(0.0),
+			"Tolerance on the margin coefficients for \"--redundant 1\".")
+		("redundant_dominated",
+			po::value<bool>(&redundant_dominated)->default_value(false),
+			"With \"--redundant 1\", also drop weak learners whose margins "
+			"never exceed those of an earlier weak learner.")
 		;
 
 	po::options_description all_options;
@@ -241,8 +755,8 @@ int main(int argc, char* argv[]) {
 	}
 
 	// Check if output file already exists
-	if (boost::filesystem::exists(boost::filesystem::path(output_filename))
-		&& force == false) {
+	if (tasks_filename.empty() && boost::filesystem::exists(
+		boost::filesystem::path(output_filename)) && force == false) {
 		std::cout << "Output file \"" << output_filename << "\" "
 			<< "already exists, exiting." << std::endl;
 		exit(EXIT_SUCCESS);
@@ -260,44 +774,211 @@ int main(int argc, char* argv[]) {
 	std::cout << labels.size() << " samples, "
 		<< number_classes << " classes." << std::endl;
 
-	// Instantiate multiclass classifier and fill it with training data
-	Boosting::LPBoostMulticlassClassifier mlp(number_classes, nu, weight_sharing);
-	mlp.InitializeBoosting(labels, interior_point, solver);
-	read_problem_data(mlp, data_S_M, number_classes);
+	// The tasks over the weak learner responses, by default the one of the
+	// training labels
+	std::vector<Task> tasks;
+	if (tasks_filename.empty()) {
+		Task task;
+		task.output_filename = output_filename;
+		task.nu = nu;
+		task.number_classes = number_classes;
+		task.labels = labels;
+		for (unsigned int n = 0; n < labels.size(); ++n)
+			task.samples.push_back(n);
+		for (int cl = 0; cl < number_classes; ++cl)
+			task.columns.push_back(cl);
+		tasks.push_back(task);
+	} else {
+		if (read_tasks(tasks_filename, labels.size(), number_classes,
+			tasks) == false) {
+			std::cerr << "Failed to read tasks from \"" << tasks_filename
+				<< "\"." << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		if (init_weights_filename.empty() == false || mpsfile.empty() == false) {
+			std::cerr << "--init_weights and --writemps need a single problem, "
+				<< "not --tasks." << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		for (unsigned int ti = 0; ti < tasks.size(); ++ti) {
+			if (boost::filesystem::exists(boost::filesystem::path(
+				tasks[ti].output_filename)) && force == false) {
+				std::cout << "Output file \"" << tasks[ti].output_filename
+					<< "\" already exists, exiting." << std::endl;
+				exit(EXIT_SUCCESS);
+			}
+		}
+		std::cout << tasks.size() << " tasks." << std::endl;
+	}
+
+	// Class groups given, or found from the weak learner responses
+	std::vector<int> class_groups;
+	if (class_groups_filename.empty() == false &&
+		read_class_groups(class_groups_filename, class_groups) == false) {
+		std::cerr << "Failed to read class groups from \""
+			<< class_groups_filename << "\"." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	for (unsigned int ti = 0; ti < tasks.size(); ++ti) {
+		if (class_groups.empty() == false && class_groups.size() !=
+			static_cast<unsigned int>(tasks[ti].number_classes)) {
+			std::cerr << "--class_groups has " << class_groups.size()
+				<< " groups for " << tasks[ti].number_classes << " classes."
+				<< std::endl;
+			exit(EXIT_FAILURE);
+		}
+		if (number_groups > static_cast<unsigned int>(
+			tasks[ti].number_classes)) {
+			std::cerr << "--groups " << number_groups << " exceeds the "
+				<< tasks[ti].number_classes << " classes." << std::endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (class_groups.empty() == false && number_groups > 0) {
+		std::cerr << "Give either --class_groups or --groups." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	// Instantiate a multiclass classifier per task and fill them with the
+	// training data
+	Boosting::LPBoostMulticlassClassifier::Formulation formulation =
+		Boosting::LPBoostMulticlassClassifier::PrimalFormulation;
+	if (entropy_epsilon > 0.0) {
+		formulation = Boosting::LPBoostMulticlassClassifier::
+			EntropyRegularizedFormulation;
+	} else if (dual) {
+		formulation = Boosting::LPBoostMulticlassClassifier::DualFormulation;
+	}
+	Boosting::LPBoostMulticlassClassifier::ResponseNormalization
+		normalization = Boosting::LPBoostMulticlassClassifier::NoNormalization;
+	if (normalize == "maxabs") {
+		normalization =
+			Boosting::LPBoostMulticlassClassifier::MaxAbsNormalization;
+	} else if (normalize == "std") {
+		normalization =
+			Boosting::LPBoostMulticlassClassifier::MarginStdNormalization;
+	} else if (normalize != "none") {
+		std::cerr << "Unknown normalization \"" << normalize << "\"."
+			<< std::endl;
+		exit(EXIT_FAILURE);
+	}
+	for (unsigned int ti = 0; ti < tasks.size(); ++ti) {
+		Task& task = tasks[ti];
+		task.mlp = new Boosting::LPBoostMulticlassClassifier(
+			task.number_classes, task.nu, weight_sharing);
+		task.mlp->SetRedundancyCheck(redundant, redundant_epsilon,
+			redundant_dominated);
+		if (entropy_epsilon > 0.0)
+			task.mlp->SetEntropyTolerance(entropy_epsilon);
+		task.mlp->SetBarrierOptions(barrier_threads);
+		task.mlp->SetSolverRace(race);
+		if (screen > 0.0)
+			task.mlp->SetSampleScreening(true, screen);
+		if (coarse_levels > 0)
+			task.mlp->SetCoarseToFine(coarse_levels, coarse_fraction);
+		if (class_groups.empty() == false)
+			task.mlp->SetClassGroups(class_groups);
+		task.mlp->SetResponseNormalization(normalization);
+		task.mlp->SetLPScaling(lp_scaling);
+		if (cache_dir.empty() == false) {
+			task.mlp->SetSolutionCache(cache_dir,
+				static_cast<uint64_t>(cache_size) << 20);
+		}
+		task.mlp->InitializeBoosting(task.labels, interior_point, solver,
+			formulation);
+	}
+	read_problem_data(tasks, data_S_M, number_classes, weight_sharing &&
+		class_groups.empty() && number_groups == 0, sparse, number_groups);
+	if (redundant) {
+		for (unsigned int ti = 0; ti < tasks.size(); ++ti) {
+			const Boosting::LPBoostMulticlassClassifier::Statistics& stats =
+				tasks[ti].mlp->Stats();
+			if (tasks.size() > 1)
+				std::cout << tasks[ti].output_filename << ": ";
+			std::cout << "Dropped " << stats.classifiers_duplicate
+				<< " duplicate and " << stats.classifiers_dominated
+				<< " dominated weak learners." << std::endl;
+		}
+	}
+
+	// The single problem options
+	Boosting::LPBoostMulticlassClassifier& mlp = *tasks[0].mlp;
+	const std::vector<unsigned int>& learner_ids = tasks[0].learner_ids;
+
+	if (init_weights_filename.empty() == false) {
+		std::vector<std::vector<double> > init_weights;
+		if (read_weights(init_weights_filename, init_weights) == false ||
+			init_weights.size() != ((weight_sharing && class_groups.empty() &&
+				number_groups == 0) ? 1 :
+				static_cast<unsigned int>(number_classes))) {
+			std::cerr << "Failed to read initial weights from \""
+				<< init_weights_filename << "\"." << std::endl;
+			exit(EXIT_FAILURE);
+		}
+
+		// Map the weights of the input weak learners to the learner ids, in
+		// the normalized scale.
+		unsigned int number_ids = 1 + *std::max_element(learner_ids.begin(),
+			learner_ids.end());
+		const std::vector<double>& scales = mlp.ResponseScales();
+		std::vector<std::vector<double> > init_alpha(init_weights.size(),
+			std::vector<double>(number_ids, 0.0));
+		for (unsigned int aidx = 0; aidx < init_weights.size(); ++aidx) {
+			for (unsigned int bidx = 0; bidx < init_weights[aidx].size() &&
+				bidx < learner_ids.size(); ++bidx) {
+				init_alpha[aidx][learner_ids[bidx]] +=
+					init_weights[aidx][bidx] / scales[learner_ids[bidx]];
+			}
+		}
+		std::cout << "Warm start from \"" << init_weights_filename << "\""
+			<< std::endl;
+		mlp.SetInitialWeights(init_alpha, vm.count("init_rho") > 0, init_rho);
+	}
 
 	if (mpsfile.empty() == false)
 		mlp.WriteMPS(mpsfile);
 
 	// Solve
 	std::cout << "Solving linear program..." << std::endl;
-	mlp.Update();
-	std::cout << "Done." << std::endl;
-	std::cout << "Soft margin " << mlp.Rho() << ", objective "
-		<< mlp.Gamma() << std::endl;
-
-	// Print weights
-	const std::vector<std::vector<double> >& clw = mlp.ClassifierWeights();
-	std::cout << "Writing (K,M) weight matrix to \""
-		<< output_filename << "\", K = "
-		<< (weight_sharing ? 1 : number_classes)
-		<< ", M = " << clw[0].size() << std::endl;
-
-	std::ofstream wout(output_filename.c_str());
-	if (wout.fail()) {
-		std::cerr << "Failed to open \"" << output_filename
-			<< "\" for writing." << std::endl;
-		exit(EXIT_FAILURE);
+	solve_tasks(tasks, task_threads);
+	for (unsigned int ti = 0; ti < tasks.size(); ++ti) {
+		if (tasks[ti].solved == false) {
+			std::cerr << "Solving \"" << tasks[ti].output_filename
+				<< "\" failed." << std::endl;
+			exit(EXIT_FAILURE);
+		}
 	}
-	wout << std::setprecision(12);
-	for (unsigned int aidx = 0; aidx < clw.size(); ++aidx) {
-		for (unsigned int bidx = 0; bidx < clw[aidx].size(); ++bidx) {
-			wout << (bidx == 0 ? "" : " ") << clw[aidx][bidx];
+	for (unsigned int ti = 0; ti < tasks.size(); ++ti) {
+		const Task& task = tasks[ti];
+		const Boosting::LPBoostMulticlassClassifier::Statistics& stats =
+			task.mlp->Stats();
+		if (tasks.size() > 1) {
+			std::cout << "Task \"" << task.output_filename << "\", "
+				<< task.samples.size() << " samples, " << task.number_classes
+				<< " classes, nu " << task.nu << std::endl;
+		}
+		if (race && stats.cache_hits == 0) {
+			std::cout << "Solved by "
+				<< (stats.race_barrier_wins > 0 ? "barrier" : "dual simplex")
+				<< "." << std::endl;
 		}
-		wout << std::endl;
+		std::cout << (stats.cache_hits > 0 ? "Done, restored from cache." :
+			"Done.") << std::endl;
+		std::cout << "Soft margin " << task.mlp->Rho() << ", objective "
+			<< task.mlp->Gamma() << ", " << stats.solver_iterations
+			<< " iterations";
+		if (coarse_levels > 0)
+			std::cout << " after " << stats.coarse_iterations << " coarse";
+		std::cout << ", " << task.seconds << " s" << std::endl;
+		if (screen > 0.0) {
+			std::cout << "Screened " << stats.samples_screened << " samples, "
+				<< "their rows relaxed (" << 100.0 * stats.relaxed_row_fraction
+				<< "% of the margin rows, still in the LP), "
+				<< stats.samples_reinserted << " put back." << std::endl;
+		}
+		write_weights(task, binary_output);
+		delete task.mlp;
 	}
-	wout.close();
 
 	exit(EXIT_SUCCESS);
 }
-
-
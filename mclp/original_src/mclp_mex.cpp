@@ -24,10 +24,6 @@
 
 static void read_matlab_data(Boosting::LPBoostMulticlassClassifier& mlp,
 							  const mxArray *scores) {
-	// responses[n][cl], the n'th sample, cl'th class
-	// response
-	std::vector<std::vector<double> > responses;
-	
 	const mwSize *dims = mxGetDimensions(scores);
 
 	assert(dims[0] && "Input should be 3D array");
@@ -43,19 +39,14 @@ static void read_matlab_data(Boosting::LPBoostMulticlassClassifier& mlp,
 	printf("nExamples = %d\n",number_examples);
 	printf("nClasses = %d\n",number_classes);
 
-	// We build and add the weak learners one after another 
-	for (unsigned int m = 0, m2=0; m < number_classifiers; ++m, m2+=number_examples){
-		responses.resize(number_examples);
-		for (unsigned int n = 0; n < number_examples; ++n)
-			responses[n].resize(number_classes);
-	
-		for (unsigned int cl = 0, cl2=0; cl < number_classes; ++cl,cl2+=number_classifiers*number_examples)
-			for (unsigned int n = 0; n < number_examples; ++n) 
-				responses[n][cl] = data[cl2+m2+n];
-
-		// Add weak learner responses to multiclass LP
-		mlp.AddMulticlassClassifier(responses);
-		responses.clear();	// free some memory now
+	// scores(n, m, cl) is column-major: the responses of weak learner m
+	// start at data[m*N], samples are adjacent and classes M*N apart.  They
+	// are added in place, one weak learner after another.
+	ptrdiff_t class_stride = static_cast<ptrdiff_t>(number_classifiers)
+		* number_examples;
+	for (unsigned int m = 0; m < number_classifiers; ++m) {
+		mlp.AddMulticlassClassifier(data
+			+ static_cast<ptrdiff_t>(m) * number_examples, 1, class_stride);
 	}
 }
 
@@ -126,7 +117,8 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 
 	// Solve
 	if (verbose) mexPrintf("Solving linear program...");
-	mlp.Update();
+	if (mlp.Update() == false)
+		mexErrMsgTxt("The linear program solver failed.");
 	if (verbose) mexPrintf("Done.");
 	if (verbose) mexPrintf("Soft margin %.4f, objective = %.4f\n",mlp.Rho(),mlp.Gamma());
 
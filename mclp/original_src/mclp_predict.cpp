@@ -0,0 +1,500 @@
+/* Command line utility applying a multiclass LPBoost model to test data.
+ *
+ * Copyright (C) 2008 -- Sebastian Nowozin <sebastian.nowozin@tuebingen.mpg.de>
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <boost/program_options.hpp>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+namespace po = boost::program_options;
+
+// Binary model: magic, uint32 rows (1 or K), uint32 M, rows*M float64
+// weights row-major.
+static const char binary_model_magic[8] = { 'M', 'C', 'L', 'P', 'M', '1', 0, 0 };
+// Binary test tensor: magic, uint32 N, uint32 M, uint32 K, then per sample
+// an int32 label (-1 if unknown) and M*K float64 responses, learner-major.
+static const char binary_tensor_magic[8] = { 'M', 'C', 'L', 'P', 'T', '1', 0, 0 };
+
+// Samples read and scored at a time, at most, and the buffer size for the
+// responses of a batch in the binary layout.
+static const unsigned int batch_size = 1024;
+static const size_t batch_bytes = 64 * 1024 * 1024;
+
+// The model, expanded to a (M,K) matrix with a weight per learner and class,
+// restricted to the learners with non-zero weight.
+struct Model {
+	unsigned int number_classifiers;	// M, all weak learners
+	int number_classes;	// K
+	std::vector<unsigned int> active;	// Learners with a non-zero weight
+	std::vector<bool> is_active;	// [m]
+	std::vector<double> weights;	// [active index * K + cl]
+};
+
+// A batch of test samples, either file names of the text layout or the
+// responses of the binary layout.
+struct Batch {
+	std::vector<int> labels;
+	std::vector<std::vector<std::string> > files;	// [n][partition]
+	std::vector<double> responses;	// [n * M * K], binary layout only
+	std::vector<double> scores;	// [n * K]
+	unsigned int size;
+};
+
+// Read a weight matrix, text as written by mclp or binary.  Returns false
+// on failure.
+static bool read_model(const std::string& model_filename,
+	std::vector<std::vector<double> >& weights) {
+	weights.clear();
+	std::ifstream in(model_filename.c_str(), std::ios::binary);
+	if (in.fail())
+		return (false);
+
+	char magic[8];
+	in.read(magic, sizeof(magic));
+	if (in.gcount() == sizeof(magic) &&
+		memcmp(magic, binary_model_magic, sizeof(magic)) == 0) {
+		uint32_t rows, cols;
+		in.read(reinterpret_cast<char*>(&rows), sizeof(rows));
+		in.read(reinterpret_cast<char*>(&cols), sizeof(cols));
+		weights.resize(rows, std::vector<double>(cols));
+		for (unsigned int row = 0; row < rows && cols > 0; ++row) {
+			in.read(reinterpret_cast<char*>(&weights[row][0]),
+				cols * sizeof(double));
+		}
+		return (in.fail() == false);
+	}
+
+	// Text, one row per line
+	in.clear();
+	in.seekg(0);
+	std::string line;
+	while (in.eof() == false) {
+		std::getline(in, line);
+		if (line.size() == 0)
+			continue;
+
+		std::istringstream is(line);
+		weights.push_back(std::vector<double>());
+		double value;
+		while (is >> value)
+			weights.back().push_back(value);
+	}
+	if (weights.empty())
+		return (false);
+	for (unsigned int row = 1; row < weights.size(); ++row) {
+		if (weights[row].size() != weights[0].size())
+			return (false);
+	}
+	return (true);
+}
+
+static void build_model(const std::vector<std::vector<double> >& weights,
+	int number_classes, Model& model) {
+	bool weight_sharing = (weights.size() == 1);
+	model.number_classifiers = weights[0].size();
+	model.number_classes = number_classes;
+	model.active.clear();
+	model.is_active.assign(model.number_classifiers, false);
+	model.weights.clear();
+	for (unsigned int m = 0; m < model.number_classifiers; ++m) {
+		bool nonzero = false;
+		for (unsigned int row = 0; row < weights.size(); ++row)
+			nonzero |= (weights[row][m] != 0.0);
+		if (nonzero == false)
+			continue;
+
+		model.active.push_back(m);
+		model.is_active[m] = true;
+		for (int cl = 0; cl < number_classes; ++cl)
+			model.weights.push_back(weights[weight_sharing ? 0 : cl][m]);
+	}
+}
+
+// Number of responses on the first line of a response file
+static int count_line_values(const std::string& filename) {
+	std::ifstream in(filename.c_str());
+	std::string line;
+	while (in.eof() == false) {
+		std::getline(in, line);
+		if (line.size() == 0)
+			continue;
+		std::istringstream is(line);
+		int count = 0;
+		double value;
+		while (is >> value)
+			count += 1;
+		return (count);
+	}
+	return (-1);
+}
+
+// score += sum over the active learners of w_{m,.} .* h_{m,.}, where h
+// points to the M*K responses of one sample.  The class loop is contiguous
+// in both operands and vectorizes.
+static void score_sample(const Model& model, const double* h,
+	double* score) {
+	int K = model.number_classes;
+	for (unsigned int ai = 0; ai < model.active.size(); ++ai) {
+		const double* w = &model.weights[ai * K];
+		const double* hm = h + model.active[ai] * K;
+		for (int cl = 0; cl < K; ++cl)
+			score[cl] += w[cl] * hm[cl];
+	}
+}
+
+// Score samples [n_begin, n_end) of the batch.
+static void score_batch(const Model* model, Batch* batch, bool sparse,
+	unsigned int n_begin, unsigned int n_end) {
+	int K = model->number_classes;
+	size_t sample_size = static_cast<size_t>(model->number_classifiers) * K;
+	// Responses of one sample for the text layout, zero for the inactive
+	// learners which are not parsed.
+	std::vector<double> h;
+	if (batch->files.empty() == false)
+		h.resize(sample_size);
+
+	for (unsigned int n = n_begin; n < n_end; ++n) {
+		double* score = &batch->scores[n * K];
+		std::fill(score, score + K, 0.0);
+		if (batch->files.empty()) {
+			score_sample(*model, &batch->responses[n * sample_size], score);
+			continue;
+		}
+
+		std::fill(h.begin(), h.end(), 0.0);
+		unsigned int m = 0;
+		for (unsigned int didx = 0; didx < batch->files[n].size(); ++didx) {
+			std::ifstream in(batch->files[n][didx].c_str());
+			if (in.fail()) {
+				std::cerr << "Failed to open file \"" << batch->files[n][didx]
+					<< "\"." << std::endl;
+				exit(EXIT_FAILURE);
+			}
+			std::string line;
+			while (in.eof() == false) {
+				std::getline(in, line);
+				if (line.size() == 0)
+					continue;
+				if (m >= model->number_classifiers) {
+					std::cerr << "More weak learners in \""
+						<< batch->files[n][didx] << "\" than in the model."
+						<< std::endl;
+					exit(EXIT_FAILURE);
+				}
+				if (model->is_active[m]) {
+					std::istringstream is(line);
+					double* hm = &h[m * K];
+					if (sparse) {
+						int cl;
+						char sep;
+						double value;
+						while (is >> cl >> sep >> value) {
+							if (cl >= 0 && cl < K)
+								hm[cl] = value;
+						}
+					} else {
+						for (int cl = 0; cl < K; ++cl)
+							is >> hm[cl];
+					}
+				}
+				m += 1;
+			}
+		}
+		if (m != model->number_classifiers) {
+			std::cerr << "Sample has " << m << " weak learners, the model "
+				<< model->number_classifiers << "." << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		score_sample(*model, &h[0], score);
+	}
+}
+
+// Read up to batch_size samples, returns false at the end of the input.
+static bool read_batch(std::istream& in, bool binary, int number_classes,
+	unsigned int number_classifiers, Batch& batch) {
+	batch.size = 0;
+	batch.labels.clear();
+	batch.files.clear();
+	size_t sample_size = static_cast<size_t>(number_classifiers) *
+		number_classes;
+	unsigned int capacity = batch_size;
+	if (binary) {
+		capacity = std::max(static_cast<size_t>(1), std::min(
+			static_cast<size_t>(batch_size),
+			batch_bytes / (sample_size * sizeof(double))));
+		batch.responses.resize(capacity * sample_size);
+	}
+
+	while (batch.size < capacity) {
+		if (binary) {
+			int32_t label;
+			in.read(reinterpret_cast<char*>(&label), sizeof(label));
+			if (in.gcount() != sizeof(label))
+				break;
+			in.read(reinterpret_cast<char*>(
+				&batch.responses[batch.size * sample_size]),
+				sample_size * sizeof(double));
+			if (in.fail()) {
+				std::cerr << "Truncated binary test data." << std::endl;
+				exit(EXIT_FAILURE);
+			}
+			batch.labels.push_back(label);
+		} else {
+			// Line format: label text1.txt text2.txt ... textP.txt
+			std::string line;
+			if (std::getline(in, line).fail())
+				break;
+			if (line.size() == 0)
+				continue;
+
+			std::istringstream is(line);
+			int label;
+			is >> label;
+			batch.labels.push_back(label);
+			batch.files.push_back(std::vector<std::string>());
+			std::string value;
+			while (is >> value)
+				batch.files.back().push_back(value);
+		}
+		batch.size += 1;
+	}
+	batch.scores.resize(batch.size * number_classes);
+
+	return (batch.size > 0);
+}
+
+// Score the batch on the given number of threads.
+static void score_batch_parallel(const Model* model, Batch* batch,
+	bool sparse, unsigned int threads) {
+	threads = std::max(1u, std::min(threads, batch->size));
+	boost::thread_group workers;
+	for (unsigned int ti = 1; ti < threads; ++ti) {
+		workers.create_thread(boost::bind(&score_batch, model, batch, sparse,
+			(ti * batch->size) / threads, ((ti + 1) * batch->size) / threads));
+	}
+	score_batch(model, batch, sparse, 0, batch->size / threads);
+	workers.join_all();
+}
+
+int main(int argc, char* argv[]) {
+	std::string model_filename;
+	std::string test_filename;
+	std::string output_filename;
+	bool binary;
+	bool sparse;
+	int number_classes;
+	unsigned int top_k;
+	unsigned int threads;
+
+	// Command line options
+	po::options_description generic("Generic Options");
+	generic.add_options()
+		("help", "Produce help message")
+		;
+
+	po::options_description input_options("Input/Output Options");
+	input_options.add_options()
+		("model", po::value<std::string>
+			(&model_filename)->default_value("output.txt"),
+			"Weight matrix as written by mclp, or the binary model layout: "
+			"8 bytes \"MCLPM1\\0\\0\", uint32 rows, uint32 columns, "
+			"rows*columns float64 weights, row-major.")
+		("test", po::value<std::string>
+			(&test_filename)->default_value("test.txt"),
+			"Test file in \"label s0-m0.txt s0-m1.txt ...\" format, one "
+			"sample per row, label -1 if unknown.")
+		("binary", po::value<bool>(&binary)->default_value(false),
+			"The test file is a binary tensor: 8 bytes \"MCLPT1\\0\\0\", "
+			"uint32 samples, uint32 weak learners, uint32 classes, then per "
+			"sample an int32 label and the weak learners' float64 responses, "
+			"one weak learner after the other.")
+		("sparse", po::value<bool>(&sparse)->default_value(false),
+			"Weak learner responses are given sparsely as "
+			"\"class:value class:value ...\" lines, as for mclp.")
+		("classes", po::value<int>(&number_classes)->default_value(0),
+			"Number of classes.  Taken from the model or the data if 0, "
+			"required for sparse responses with a shared weight model.")
+		("output", po::value<std::string>
+			(&output_filename)->default_value("predictions.txt"),
+			"File to write one line per sample to: the predicted class, "
+			"then the top-k \"class:score\" pairs.")
+		("top_k", po::value<unsigned int>(&top_k)->default_value(1),
+			"Number of highest scoring classes to write.")
+		("threads", po::value<unsigned int>(&threads)->default_value(
+			std::max(1u, boost::thread::hardware_concurrency())),
+			"Number of scoring threads.")
+		;
+
+	po::options_description all_options;
+	all_options.add(generic).add(input_options);
+	po::variables_map vm;
+	po::store(po::command_line_parser(argc, argv).options(all_options).run(), vm);
+	po::notify(vm);
+
+	if (vm.count("help")) {
+		std::cerr << "Usage: mclp_predict [options]" << std::endl;
+		std::cerr << std::endl;
+		std::cerr << "Apply a multiclass LPBoost model trained by mclp to "
+			<< "test data." << std::endl;
+		std::cerr << all_options << std::endl;
+
+		exit(EXIT_SUCCESS);
+	}
+
+	std::vector<std::vector<double> > weights;
+	if (read_model(model_filename, weights) == false) {
+		std::cerr << "Failed to read model from \"" << model_filename
+			<< "\"." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	if (weights.size() > 1)
+		number_classes = weights.size();
+
+	std::ifstream in(test_filename.c_str(), std::ios::binary);
+	if (in.fail()) {
+		std::cerr << "Failed to open test data \"" << test_filename
+			<< "\"." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	uint32_t number_samples = 0;
+	if (binary) {
+		char magic[8];
+		uint32_t dims[3];
+		in.read(magic, sizeof(magic));
+		in.read(reinterpret_cast<char*>(dims), sizeof(dims));
+		if (in.fail() || memcmp(magic, binary_tensor_magic,
+			sizeof(magic)) != 0) {
+			std::cerr << "\"" << test_filename << "\" is not a binary "
+				<< "test tensor." << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		number_samples = dims[0];
+		if (dims[1] != weights[0].size() || (number_classes > 0 &&
+			dims[2] != static_cast<uint32_t>(number_classes))) {
+			std::cerr << "Test tensor has " << dims[1] << " weak learners and "
+				<< dims[2] << " classes, inconsistent with the model."
+				<< std::endl;
+			exit(EXIT_FAILURE);
+		}
+		number_classes = dims[2];
+	} else if (number_classes <= 0) {
+		// Classes from the first response line of the first sample
+		std::string line;
+		while (number_classes <= 0 && std::getline(in, line).fail() == false) {
+			std::istringstream is(line);
+			int label;
+			std::string first_file;
+			if (is >> label >> first_file)
+				number_classes = count_line_values(first_file);
+		}
+		if (sparse || number_classes <= 0) {
+			std::cerr << "Cannot determine the number of classes, use "
+				"--classes." << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		in.clear();
+		in.seekg(0);
+	}
+	top_k = std::min(top_k, static_cast<unsigned int>(number_classes));
+
+	Model model;
+	build_model(weights, number_classes, model);
+	std::cout << "Model: " << model.number_classifiers << " weak learners, "
+		<< model.active.size() << " with non-zero weight, "
+		<< number_classes << " classes." << std::endl;
+
+	std::ofstream out(output_filename.c_str());
+	if (out.fail()) {
+		std::cerr << "Failed to open \"" << output_filename
+			<< "\" for writing." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	out << std::setprecision(12);
+
+	// confusion[y * K + predicted]
+	std::vector<uint64_t> confusion(number_classes * number_classes, 0);
+	uint64_t samples_scored = 0;
+	uint64_t samples_labeled = 0;
+
+	// The next batch is read while the current one is scored.
+	Batch batches[2];
+	bool have_batch = read_batch(in, binary, number_classes,
+		model.number_classifiers, batches[0]);
+	std::vector<int> order(number_classes);
+	for (unsigned int bi = 0; have_batch; bi ^= 1) {
+		Batch& batch = batches[bi];
+		boost::thread scorer(boost::bind(&score_batch_parallel, &model,
+			&batch, sparse, threads));
+		have_batch = read_batch(in, binary, number_classes,
+			model.number_classifiers, batches[bi ^ 1]);
+		scorer.join();
+
+		for (unsigned int n = 0; n < batch.size; ++n) {
+			const double* score = &batch.scores[n * number_classes];
+			for (int cl = 0; cl < number_classes; ++cl)
+				order[cl] = cl;
+			// Top-k classes by descending score, lower class id on ties
+			for (unsigned int ki = 0; ki < top_k; ++ki) {
+				for (int cl = ki + 1; cl < number_classes; ++cl) {
+					if (score[order[cl]] > score[order[ki]] ||
+						(score[order[cl]] == score[order[ki]] &&
+						order[cl] < order[ki]))
+						std::swap(order[ki], order[cl]);
+				}
+			}
+			out << order[0];
+			for (unsigned int ki = 0; ki < top_k; ++ki)
+				out << " " << order[ki] << ":" << score[order[ki]];
+			out << std::endl;
+
+			int y = batch.labels[n];
+			if (y >= 0 && y < number_classes) {
+				confusion[y * number_classes + order[0]] += 1;
+				samples_labeled += 1;
+			}
+		}
+		samples_scored += batch.size;
+	}
+	out.close();
+	if (binary && samples_scored != number_samples) {
+		std::cerr << "Binary test data holds " << samples_scored
+			<< " samples, its header " << number_samples << "." << std::endl;
+	}
+	std::cout << "Scored " << samples_scored << " samples, predictions "
+		<< "written to \"" << output_filename << "\"." << std::endl;
+
+	if (samples_labeled > 0) {
+		uint64_t correct = 0;
+		for (int cl = 0; cl < number_classes; ++cl)
+			correct += confusion[cl * number_classes + cl];
+		std::cout << "Accuracy " << static_cast<double>(correct) /
+			samples_labeled << " (" << correct << " of " << samples_labeled
+			<< " labeled samples)" << std::endl;
+		std::cout << "Confusion matrix, row: true class, column: "
+			<< "predicted class" << std::endl;
+		for (int y = 0; y < number_classes; ++y) {
+			for (int cl = 0; cl < number_classes; ++cl) {
+				std::cout << (cl == 0 ? "" : " ") << std::setw(8)
+					<< confusion[y * number_classes + cl];
+			}
+			std::cout << std::endl;
+		}
+	}
+
+	exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,606 @@
+/* Benchmark of the LP formulations and response normalizations over problem
+ * shapes.
+ *
+ * Copyright (C) 2008 -- Sebastian Nowozin <sebastian.nowozin@tuebingen.mpg.de>
+ */
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <boost/program_options.hpp>
+#include <boost/random.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include <assert.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "LPBoostMulticlassClassifier.h"
+
+namespace po = boost::program_options;
+
+// Random weak learner responses: uniform, plus a bonus on the true class
+// for the fraction of samples the learner gets right.  All scaled by a
+// factor spread log-uniformly over scale_spread decades.
+static void generate_response(boost::mt19937& rng,
+	const std::vector<int>& labels, unsigned int number_classes,
+	double scale_spread, std::vector<std::vector<double> >& response) {
+	boost::uniform_real<double> dist_uniform(0.0, 1.0);
+	boost::variate_generator<boost::mt19937&, boost::uniform_real<double> >
+		rand_uniform(rng, dist_uniform);
+	double accuracy = 0.3 + 0.4 * rand_uniform();
+	double scale = pow(10.0, scale_spread * (rand_uniform() - 0.5));
+
+	response.resize(labels.size());
+	for (unsigned int n = 0; n < labels.size(); ++n) {
+		response[n].resize(number_classes);
+		for (unsigned int k = 0; k < number_classes; ++k)
+			response[n][k] = rand_uniform();
+		if (rand_uniform() < accuracy)
+			response[n][labels[n]] += 0.5;
+		for (unsigned int k = 0; k < number_classes; ++k)
+			response[n][k] *= scale;
+	}
+}
+
+// Boost on one shape, adding the weak learners in rounds with an update
+// after each round.  Returns the solver time in seconds, the soft margin
+// and the solver iterations of all rounds.
+static double run(unsigned int number_samples, unsigned int number_classes,
+	unsigned int number_classifiers, unsigned int rounds, double nu,
+	bool weight_sharing, bool interior_point,
+	Boosting::LPBoostMulticlassClassifier::Formulation formulation,
+	Boosting::LPBoostMulticlassClassifier::ResponseNormalization
+		normalization, double scale_spread,
+	double& gamma, unsigned int& iterations) {
+	boost::mt19937 rng;	// same data for every formulation
+	boost::uniform_int<> dist_classlabel(0, number_classes - 1);
+	boost::variate_generator<boost::mt19937&, boost::uniform_int<> >
+		rand_class_label(rng, dist_classlabel);
+	std::vector<int> labels(number_samples);
+	for (unsigned int n = 0; n < number_samples; ++n)
+		labels[n] = rand_class_label();
+
+	Boosting::LPBoostMulticlassClassifier mlp(number_classes, nu,
+		weight_sharing);
+	mlp.SetResponseNormalization(normalization);
+	mlp.InitializeBoosting(labels, interior_point, "clp", formulation);
+
+	double seconds = 0.0;
+	iterations = 0;
+	std::vector<std::vector<double> > response;
+	unsigned int m = 0;
+	for (unsigned int round = 1; round <= rounds; ++round) {
+		boost::posix_time::ptime start =
+			boost::posix_time::microsec_clock::universal_time();
+		for (; m < (round * number_classifiers) / rounds; ++m) {
+			boost::posix_time::ptime gen_start =
+				boost::posix_time::microsec_clock::universal_time();
+			generate_response(rng, labels, number_classes, scale_spread,
+				response);
+			// Only the LP work is timed
+			start += boost::posix_time::microsec_clock::universal_time()
+				- gen_start;
+			mlp.AddMulticlassClassifier(response);
+		}
+		mlp.Update();
+		seconds += (boost::posix_time::microsec_clock::universal_time()
+			- start).total_microseconds() * 1e-6;
+		iterations += mlp.Stats().solver_iterations;
+	}
+	gamma = mlp.Gamma();
+
+	return (seconds);
+}
+
+// Time adding dense weak learners, in the given response layout: "nested"
+// vectors, "rows" for a row-major (N,K) array or "columns" for a
+// column-major one.  Returns the margin coefficients processed per second
+// and sets the scratch allocations per weak learner.
+static double run_kernels(unsigned int number_samples,
+	unsigned int number_classes, unsigned int number_classifiers, double nu,
+	bool weight_sharing, const std::string& layout, double& allocations) {
+	boost::mt19937 rng;
+	boost::uniform_int<> dist_classlabel(0, number_classes - 1);
+	boost::variate_generator<boost::mt19937&, boost::uniform_int<> >
+		rand_class_label(rng, dist_classlabel);
+	std::vector<int> labels(number_samples);
+	for (unsigned int n = 0; n < number_samples; ++n)
+		labels[n] = rand_class_label();
+
+	Boosting::LPBoostMulticlassClassifier mlp(number_classes, nu,
+		weight_sharing);
+	mlp.InitializeBoosting(labels);
+
+	double seconds = 0.0;
+	std::vector<std::vector<double> > response;
+	std::vector<double> flat(number_samples * number_classes);
+	for (unsigned int m = 0; m < number_classifiers; ++m) {
+		generate_response(rng, labels, number_classes, 0.0, response);
+		for (unsigned int n = 0; n < number_samples; ++n) {
+			for (unsigned int k = 0; k < number_classes; ++k) {
+				if (layout == "columns")
+					flat[k * number_samples + n] = response[n][k];
+				else
+					flat[n * number_classes + k] = response[n][k];
+			}
+		}
+
+		boost::posix_time::ptime start =
+			boost::posix_time::microsec_clock::universal_time();
+		if (layout == "nested")
+			mlp.AddMulticlassClassifier(response);
+		else if (layout == "columns")
+			mlp.AddMulticlassClassifier(&flat[0], 1, number_samples);
+		else
+			mlp.AddMulticlassClassifier(&flat[0], number_classes, 1);
+		seconds += (boost::posix_time::microsec_clock::universal_time()
+			- start).total_microseconds() * 1e-6;
+	}
+
+	allocations = mlp.Stats().scratch_allocations
+		/ static_cast<double>(std::max(1u, number_classifiers));
+
+	return (static_cast<double>(number_classifiers) * number_samples
+		* (number_classes - 1) / std::max(seconds, 1e-6));
+}
+
+// Time the construction of the initial LP, InitializeBoosting, in a child
+// process so that its peak resident memory can be told apart.  Returns the
+// seconds and sets the child's peak RSS in kilobytes.
+static double run_setup(unsigned int number_samples,
+	unsigned int number_classes, double nu, bool weight_sharing,
+	Boosting::LPBoostMulticlassClassifier::Formulation formulation,
+	long& peak_rss) {
+	int fds[2];
+	if (pipe(fds) != 0) {
+		std::cerr << "pipe failed." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	pid_t pid = fork();
+	if (pid < 0) {
+		std::cerr << "fork failed." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	if (pid == 0) {
+		close(fds[0]);
+		boost::mt19937 rng;
+		boost::uniform_int<> dist_classlabel(0, number_classes - 1);
+		boost::variate_generator<boost::mt19937&, boost::uniform_int<> >
+			rand_class_label(rng, dist_classlabel);
+		std::vector<int> labels(number_samples);
+		for (unsigned int n = 0; n < number_samples; ++n)
+			labels[n] = rand_class_label();
+
+		boost::posix_time::ptime start =
+			boost::posix_time::microsec_clock::universal_time();
+		Boosting::LPBoostMulticlassClassifier mlp(number_classes, nu,
+			weight_sharing);
+		mlp.InitializeBoosting(labels, false, "clp", formulation);
+		double seconds = (boost::posix_time::microsec_clock::universal_time()
+			- start).total_microseconds() * 1e-6;
+		ssize_t written = write(fds[1], &seconds, sizeof(seconds));
+		_exit(written == sizeof(seconds) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+	close(fds[1]);
+	double seconds = -1.0;
+	if (read(fds[0], &seconds, sizeof(seconds)) != sizeof(seconds))
+		seconds = -1.0;
+	close(fds[0]);
+	int status;
+	struct rusage usage;
+	wait4(pid, &status, 0, &usage);
+	peak_rss = usage.ru_maxrss;
+
+	return (seconds);
+}
+
+// Resident memory of this process in kilobytes.
+static long resident_kilobytes() {
+	long size = 0;
+	long resident = 0;
+	FILE* statm = fopen("/proc/self/statm", "r");
+	if (statm != NULL) {
+		if (fscanf(statm, "%ld %ld", &size, &resident) != 2)
+			resident = 0;
+		fclose(statm);
+	}
+	return (resident * (sysconf(_SC_PAGESIZE) / 1024));
+}
+
+// Run many small training jobs back to back in a child process, each
+// setting up, adding the weak learners and solving once.  mode "new"
+// constructs a classifier per job, "reset" reuses one through Reset and
+// "pool" constructs one per job with a solver pool.  Returns the seconds
+// per job and sets the resident memory growth from the first to the last
+// job in kilobytes.
+static double run_jobs(unsigned int number_samples,
+	unsigned int number_classes, unsigned int number_classifiers,
+	unsigned int jobs, double nu, bool weight_sharing,
+	const std::string& mode, long& rss_growth) {
+	int fds[2];
+	if (pipe(fds) != 0) {
+		std::cerr << "pipe failed." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	pid_t pid = fork();
+	if (pid < 0) {
+		std::cerr << "fork failed." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	if (pid == 0) {
+		close(fds[0]);
+		boost::mt19937 rng;
+		boost::uniform_int<> dist_classlabel(0, number_classes - 1);
+		boost::variate_generator<boost::mt19937&, boost::uniform_int<> >
+			rand_class_label(rng, dist_classlabel);
+		std::vector<int> labels(number_samples);
+		for (unsigned int n = 0; n < number_samples; ++n)
+			labels[n] = rand_class_label();
+		// The same weak learners for every job, only the LP work is timed
+		std::vector<std::vector<std::vector<double> > > responses(
+			number_classifiers);
+		for (unsigned int m = 0; m < number_classifiers; ++m)
+			generate_response(rng, labels, number_classes, 0.0, responses[m]);
+
+		if (mode == "pool")
+			Boosting::LPBoostMulticlassClassifier::SetSolverPoolSize(1);
+		Boosting::LPBoostMulticlassClassifier reused(number_classes, nu,
+			weight_sharing);
+		double result[2] = { 0.0, 0.0 };
+		long first_rss = 0;
+		boost::posix_time::ptime start =
+			boost::posix_time::microsec_clock::universal_time();
+		for (unsigned int job = 0; job < jobs; ++job) {
+			if (mode == "reset") {
+				reused.Reset(number_classes, nu, weight_sharing, labels);
+				for (unsigned int m = 0; m < number_classifiers; ++m)
+					reused.AddMulticlassClassifier(responses[m]);
+				reused.Update();
+			} else {
+				Boosting::LPBoostMulticlassClassifier mlp(number_classes, nu,
+					weight_sharing);
+				mlp.InitializeBoosting(labels);
+				for (unsigned int m = 0; m < number_classifiers; ++m)
+					mlp.AddMulticlassClassifier(responses[m]);
+				mlp.Update();
+			}
+			if (job == 0)
+				first_rss = resident_kilobytes();
+		}
+		result[0] = (boost::posix_time::microsec_clock::universal_time()
+			- start).total_microseconds() * 1e-6 / std::max(1u, jobs);
+		result[1] = static_cast<double>(resident_kilobytes() - first_rss);
+		ssize_t written = write(fds[1], result, sizeof(result));
+		_exit(written == sizeof(result) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+	close(fds[1]);
+	double result[2] = { -1.0, 0.0 };
+	if (read(fds[0], result, sizeof(result)) != sizeof(result))
+		result[0] = -1.0;
+	close(fds[0]);
+	int status;
+	waitpid(pid, &status, 0);
+	rss_growth = static_cast<long>(result[1]);
+
+	return (result[0]);
+}
+
+// Time the first simplex Update() on all weak learners, with the given
+// coarse-to-fine levels, 0 for the cold solve.  Returns the seconds and
+// sets the soft margin and the iterations of the full and coarse solves.
+static double run_coarse(unsigned int number_samples,
+	unsigned int number_classes, unsigned int number_classifiers, double nu,
+	bool weight_sharing, unsigned int levels, double fraction, double& gamma,
+	unsigned int& iterations, unsigned int& coarse_iterations) {
+	boost::mt19937 rng;	// same data for every level count
+	boost::uniform_int<> dist_classlabel(0, number_classes - 1);
+	boost::variate_generator<boost::mt19937&, boost::uniform_int<> >
+		rand_class_label(rng, dist_classlabel);
+	std::vector<int> labels(number_samples);
+	for (unsigned int n = 0; n < number_samples; ++n)
+		labels[n] = rand_class_label();
+
+	Boosting::LPBoostMulticlassClassifier mlp(number_classes, nu,
+		weight_sharing);
+	if (levels > 0)
+		mlp.SetCoarseToFine(levels, fraction);
+	mlp.InitializeBoosting(labels);
+	std::vector<std::vector<double> > response;
+	for (unsigned int m = 0; m < number_classifiers; ++m) {
+		generate_response(rng, labels, number_classes, 0.0, response);
+		mlp.AddMulticlassClassifier(response);
+	}
+
+	boost::posix_time::ptime start =
+		boost::posix_time::microsec_clock::universal_time();
+	mlp.Update();
+	double seconds = (boost::posix_time::microsec_clock::universal_time()
+		- start).total_microseconds() * 1e-6;
+	gamma = mlp.Gamma();
+	iterations = mlp.Stats().solver_iterations;
+	coarse_iterations = mlp.Stats().coarse_iterations;
+
+	return (seconds);
+}
+
+int main(int argc, char* argv[]) {
+	std::vector<unsigned int> samples;
+	std::vector<unsigned int> classes;
+	std::vector<unsigned int> classifiers;
+	unsigned int rounds;
+	double nu;
+	bool weight_sharing;
+	bool interior_point;
+	std::vector<std::string> normalizations;
+	double scale_spread;
+	bool setup;
+	bool kernels;
+	unsigned int jobs;
+	std::vector<unsigned int> coarse_levels;
+	double coarse_fraction;
+
+	po::options_description generic("Generic Options");
+	generic.add_options()
+		("help", "Produce help message")
+		;
+
+	po::options_description bench_options("Benchmark Options");
+	bench_options.add_options()
+		("samples", po::value<std::vector<unsigned int> >(&samples)
+			->multitoken(), "Numbers of samples N, default 1000 10000.")
+		("classes", po::value<std::vector<unsigned int> >(&classes)
+			->multitoken(), "Numbers of classes K, default 10.")
+		("classifiers", po::value<std::vector<unsigned int> >(&classifiers)
+			->multitoken(), "Numbers of weak learners M, default 20 200.")
+		("rounds", po::value<unsigned int>(&rounds)->default_value(10),
+			"The weak learners are added in this many rounds, with an "
+			"update after each, as in boosting.")
+		("nu", po::value<double>(&nu)->default_value(0.1),
+			"nu-parameter of LPBoost.")
+		("weight_sharing", po::value<bool>(&weight_sharing)->default_value(true),
+			"Share classifier weights among all classes.")
+		("interior_point",
+			po::value<bool>(&interior_point)->default_value(false),
+			"Use interior point (true) or simplex method (false).")
+		("normalization", po::value<std::vector<std::string> >(
+			&normalizations)->multitoken(), "Response normalizations, of "
+			"\"none\", \"maxabs\" and \"std\", default all.")
+		("scale_spread", po::value<double>(&scale_spread)->default_value(4.0),
+			"The responses of each weak learner are scaled by a random "
+			"factor within this many decades.")
+		("setup", po::bool_switch(&setup), "Only time the construction "
+			"of the initial LP and report its peak memory, for every "
+			"number of samples and classes.")
+		("kernels", po::bool_switch(&kernels), "Only time adding dense weak "
+			"learners, in margin coefficients per second for each shape and "
+			"response layout, with the scratch allocations per learner.")
+		("jobs", po::value<unsigned int>(&jobs)->default_value(0),
+			"Only time this many small training jobs per shape, with a new "
+			"classifier per job, one reused by Reset and a solver pool, "
+			"and report the resident memory growth over the jobs.")
+		("coarse_levels", po::value<std::vector<unsigned int> >(
+			&coarse_levels)->multitoken(), "Only time the first simplex "
+			"update on all weak learners per shape, cold and with each of "
+			"these numbers of coarse-to-fine levels.")
+		("coarse_fraction",
+			po::value<double>(&coarse_fraction)->default_value(0.1),
+			"Fraction of each class in the first coarse level.")
+		;
+
+	po::options_description all_options;
+	all_options.add(generic).add(bench_options);
+	po::variables_map vm;
+	po::store(po::command_line_parser(argc, argv).options(all_options).run(), vm);
+	po::notify(vm);
+
+	if (vm.count("help")) {
+		std::cerr << "Usage: mclpbench [options]" << std::endl;
+		std::cerr << std::endl;
+		std::cerr << "Time the primal and dual LP formulations on random "
+			<< "problems of all combinations of the given shapes and "
+			<< "normalizations." << std::endl;
+		std::cerr << all_options << std::endl;
+
+		exit(EXIT_SUCCESS);
+	}
+	if (samples.empty()) {
+		samples.push_back(1000);
+		samples.push_back(10000);
+	}
+	if (classes.empty())
+		classes.push_back(10);
+	if (classifiers.empty()) {
+		classifiers.push_back(20);
+		classifiers.push_back(200);
+	}
+	if (normalizations.empty()) {
+		normalizations.push_back("none");
+		normalizations.push_back("maxabs");
+		normalizations.push_back("std");
+	}
+	rounds = std::max(1u, rounds);
+
+	std::vector<Boosting::LPBoostMulticlassClassifier::ResponseNormalization>
+		normalization_modes;
+	for (unsigned int ni = 0; ni < normalizations.size(); ++ni) {
+		if (normalizations[ni] == "none") {
+			normalization_modes.push_back(
+				Boosting::LPBoostMulticlassClassifier::NoNormalization);
+		} else if (normalizations[ni] == "maxabs") {
+			normalization_modes.push_back(
+				Boosting::LPBoostMulticlassClassifier::MaxAbsNormalization);
+		} else if (normalizations[ni] == "std") {
+			normalization_modes.push_back(
+				Boosting::LPBoostMulticlassClassifier::MarginStdNormalization);
+		} else {
+			std::cerr << "Unknown normalization \"" << normalizations[ni]
+				<< "\"." << std::endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (kernels) {
+		const char* layouts[3] = { "nested", "rows", "columns" };
+		std::cout << std::setw(8) << "N" << std::setw(6) << "K"
+			<< std::setw(8) << "M" << std::setw(10) << "layout"
+			<< std::setw(14) << "elements/s" << std::setw(10) << "allocs/M"
+			<< std::endl;
+		for (unsigned int si = 0; si < samples.size(); ++si) {
+			for (unsigned int ki = 0; ki < classes.size(); ++ki) {
+				for (unsigned int mi = 0; mi < classifiers.size(); ++mi) {
+					for (unsigned int li = 0; li < 3; ++li) {
+						double allocations;
+						double rate = run_kernels(samples[si], classes[ki],
+							classifiers[mi], nu, weight_sharing, layouts[li],
+							allocations);
+						std::cout << std::setw(8) << samples[si]
+							<< std::setw(6) << classes[ki] << std::setw(8)
+							<< classifiers[mi] << std::setw(10) << layouts[li]
+							<< std::setw(14) << std::setprecision(4) << rate
+							<< std::setw(10) << allocations << std::endl;
+					}
+				}
+			}
+		}
+		exit(EXIT_SUCCESS);
+	}
+	if (coarse_levels.empty() == false) {
+		coarse_levels.insert(coarse_levels.begin(), 0);
+		std::cout << std::setw(8) << "N" << std::setw(6) << "K"
+			<< std::setw(8) << "M" << std::setw(8) << "levels"
+			<< std::setw(12) << "first [s]" << std::setw(8) << "iter"
+			<< std::setw(8) << "coarse" << std::setw(14) << "gamma"
+			<< std::endl;
+		for (unsigned int si = 0; si < samples.size(); ++si) {
+			for (unsigned int ki = 0; ki < classes.size(); ++ki) {
+				for (unsigned int mi = 0; mi < classifiers.size(); ++mi) {
+					for (unsigned int li = 0; li < coarse_levels.size(); ++li) {
+						double gamma;
+						unsigned int iterations;
+						unsigned int coarse_iterations;
+						double seconds = run_coarse(samples[si], classes[ki],
+							classifiers[mi], nu, weight_sharing,
+							coarse_levels[li], coarse_fraction, gamma,
+							iterations, coarse_iterations);
+						std::cout << std::setw(8) << samples[si]
+							<< std::setw(6) << classes[ki] << std::setw(8)
+							<< classifiers[mi] << std::setw(8)
+							<< coarse_levels[li] << std::setw(12)
+							<< std::setprecision(4) << seconds << std::setw(8)
+							<< iterations << std::setw(8) << coarse_iterations
+							<< std::setw(14) << std::setprecision(8) << gamma
+							<< std::endl;
+					}
+				}
+			}
+		}
+		exit(EXIT_SUCCESS);
+	}
+	if (jobs > 0) {
+		const char* modes[3] = { "new", "reset", "pool" };
+		std::cout << std::setw(8) << "N" << std::setw(6) << "K"
+			<< std::setw(8) << "M" << std::setw(8) << "mode"
+			<< std::setw(14) << "job [ms]" << std::setw(14) << "growth [KB]"
+			<< std::endl;
+		for (unsigned int si = 0; si < samples.size(); ++si) {
+			for (unsigned int ki = 0; ki < classes.size(); ++ki) {
+				for (unsigned int mi = 0; mi < classifiers.size(); ++mi) {
+					for (unsigned int mode = 0; mode < 3; ++mode) {
+						long growth;
+						double seconds = run_jobs(samples[si], classes[ki],
+							classifiers[mi], jobs, nu, weight_sharing,
+							modes[mode], growth);
+						std::cout << std::setw(8) << samples[si]
+							<< std::setw(6) << classes[ki] << std::setw(8)
+							<< classifiers[mi] << std::setw(8) << modes[mode]
+							<< std::setw(14) << std::setprecision(4)
+							<< 1000.0 * seconds << std::setw(14) << growth
+							<< std::endl;
+					}
+				}
+			}
+		}
+		exit(EXIT_SUCCESS);
+	}
+	if (setup) {
+		std::cout << std::setw(8) << "N" << std::setw(6) << "K"
+			<< std::setw(12) << "primal [s]" << std::setw(12) << "dual [s]"
+			<< std::setw(14) << "primal [MB]" << std::setw(12) << "dual [MB]"
+			<< std::endl;
+		for (unsigned int si = 0; si < samples.size(); ++si) {
+			for (unsigned int ki = 0; ki < classes.size(); ++ki) {
+				long rss_primal;
+				long rss_dual;
+				double primal = run_setup(samples[si], classes[ki], nu,
+					weight_sharing,
+					Boosting::LPBoostMulticlassClassifier::PrimalFormulation,
+					rss_primal);
+				double dual = run_setup(samples[si], classes[ki], nu,
+					weight_sharing,
+					Boosting::LPBoostMulticlassClassifier::DualFormulation,
+					rss_dual);
+				std::cout << std::setw(8) << samples[si] << std::setw(6)
+					<< classes[ki] << std::setprecision(4) << std::setw(12)
+					<< primal << std::setw(12) << dual << std::setw(14)
+					<< rss_primal / 1024.0 << std::setw(12)
+					<< rss_dual / 1024.0 << std::endl;
+			}
+		}
+		exit(EXIT_SUCCESS);
+	}
+
+	std::cout << std::setw(8) << "N" << std::setw(6) << "K"
+		<< std::setw(8) << "M" << std::setw(8) << "norm"
+		<< std::setw(12) << "rows p/d"
+		<< std::setw(12) << "primal [s]" << std::setw(12) << "dual [s]"
+		<< std::setw(10) << "iter p" << std::setw(10) << "iter d"
+		<< std::setw(8) << "winner" << std::endl;
+	for (unsigned int si = 0; si < samples.size(); ++si) {
+		for (unsigned int ki = 0; ki < classes.size(); ++ki) {
+			for (unsigned int mi = 0; mi < classifiers.size(); ++mi) {
+				for (unsigned int ni = 0; ni < normalizations.size(); ++ni) {
+					unsigned int N = samples[si];
+					unsigned int K = classes[ki];
+					unsigned int M = classifiers[mi];
+					double gamma_primal;
+					double gamma_dual;
+					unsigned int iterations_primal;
+					unsigned int iterations_dual;
+					double primal = run(N, K, M, rounds, nu, weight_sharing,
+						interior_point,
+						Boosting::LPBoostMulticlassClassifier::PrimalFormulation,
+						normalization_modes[ni], scale_spread, gamma_primal,
+						iterations_primal);
+					double dual = run(N, K, M, rounds, nu, weight_sharing,
+						interior_point,
+						Boosting::LPBoostMulticlassClassifier::DualFormulation,
+						normalization_modes[ni], scale_spread, gamma_dual,
+						iterations_dual);
+					if (fabs(gamma_primal - gamma_dual) > 1e-6) {
+						std::cerr << "Formulations disagree: gamma "
+							<< gamma_primal << " (primal) vs " << gamma_dual
+							<< " (dual)." << std::endl;
+					}
+
+					// Rows of the primal over rows of the dual
+					double ratio = static_cast<double>(N) * (K - 1) /
+						(static_cast<double>(M) * (weight_sharing ? 1 : K));
+					std::cout << std::setw(8) << N << std::setw(6) << K
+						<< std::setw(8) << M << std::setw(8)
+						<< normalizations[ni] << std::setw(12)
+						<< std::setprecision(4) << ratio << std::setw(12)
+						<< primal << std::setw(12) << dual << std::setw(10)
+						<< iterations_primal << std::setw(10)
+						<< iterations_dual << std::setw(8)
+						<< (primal <= dual ? "primal" : "dual") << std::endl;
+				}
+			}
+		}
+	}
+}
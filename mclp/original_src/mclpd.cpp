@@ -0,0 +1,177 @@
+/* Training daemon for multiclass LPBoost.  Serves named problems to any
+ * number of clients on a local Unix socket, one request per line; see the
+ * protocol and the journaling in LPBoostServer.h.
+ *
+ * Copyright (C) 2008 -- Sebastian Nowozin <sebastian.nowozin@tuebingen.mpg.de>
+ */
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <boost/program_options.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "LPBoostServer.h"
+
+namespace po = boost::program_options;
+
+static bool write_all(int fd, const std::string& data) {
+	size_t written = 0;
+	while (written < data.size()) {
+		ssize_t bytes = write(fd, data.data() + written,
+			data.size() - written);
+		if (bytes <= 0)
+			return (false);
+		written += bytes;
+	}
+	return (true);
+}
+
+// Serve the requests of one client until it disconnects.  A request
+// longer than max_request_bytes is answered with ERR as soon as it is
+// known to be too long, and the rest of it is dropped as it arrives.
+static void serve_client(Boosting::Server* server, int fd,
+	size_t max_request_bytes) {
+	std::string buffer;
+	bool discarding = false;	// The rest of a too long request
+	char chunk[65536];
+	std::ostringstream too_long;
+	too_long << "ERR request longer than " << max_request_bytes
+		<< " bytes\n";
+	while (true) {
+		ssize_t bytes = read(fd, chunk, sizeof(chunk));
+		if (bytes <= 0)
+			break;
+		buffer.append(chunk, bytes);
+
+		size_t begin = 0;
+		size_t end;
+		while ((end = buffer.find('\n', begin)) != std::string::npos) {
+			std::string line = buffer.substr(begin, end - begin);
+			begin = end + 1;
+			if (discarding) {
+				discarding = false;
+				continue;
+			}
+			if (line.empty() == false && line[line.size() - 1] == '\r')
+				line.erase(line.size() - 1);
+			std::string reply = (line.size() > max_request_bytes)
+				? too_long.str() : server->Handle(line) + "\n";
+			if (write_all(fd, reply) == false) {
+				close(fd);
+				return;
+			}
+		}
+		buffer.erase(0, begin);
+		if (discarding == false && buffer.size() > max_request_bytes) {
+			if (write_all(fd, too_long.str()) == false) {
+				close(fd);
+				return;
+			}
+			discarding = true;
+		}
+		if (discarding)
+			buffer.clear();
+	}
+	close(fd);
+}
+
+int main(int argc, char* argv[]) {
+	std::string socket_path;
+	std::string checkpoint_dir;
+	unsigned int memory_mb;
+	unsigned int max_request_mb;
+	bool verbose;
+
+	po::options_description generic("Generic Options");
+	generic.add_options()
+		("help", "Produce help message")
+		("verbose", "Report loaded and evicted problems")
+		;
+
+	po::options_description daemon_options("Daemon Options");
+	daemon_options.add_options()
+		("socket", po::value<std::string>(&socket_path)
+			->default_value("/tmp/mclpd.socket"),
+			"Unix socket to listen on, replaced if it exists.")
+		("checkpoint_dir", po::value<std::string>(&checkpoint_dir)
+			->default_value("mclpd-journal"),
+			"Directory of the problem journals, created if missing.  "
+			"Problems journaled by an earlier run are served from it.")
+		("memory", po::value<unsigned int>(&memory_mb)->default_value(1024),
+			"Memory budget of the loaded problems in megabytes, the least "
+			"recently used are evicted beyond it.")
+		("max_request", po::value<unsigned int>(&max_request_mb)
+			->default_value(256),
+			"Longest request line in megabytes, longer ones are answered "
+			"with an error and dropped.")
+		;
+
+	po::options_description all_options;
+	all_options.add(generic).add(daemon_options);
+	po::variables_map vm;
+	po::store(po::command_line_parser(argc, argv).options(all_options).run(), vm);
+	po::notify(vm);
+	verbose = vm.count("verbose") > 0;
+
+	if (vm.count("help")) {
+		std::cerr << "Usage: mclpd [options]" << std::endl;
+		std::cerr << std::endl;
+		std::cerr << "Serve multiclass LPBoost problems to local clients, "
+			<< "see the protocol in LPBoostServer.h." << std::endl;
+		std::cerr << all_options << std::endl;
+
+		exit(EXIT_SUCCESS);
+	}
+
+	boost::filesystem::create_directories(checkpoint_dir);
+	Boosting::Server server(checkpoint_dir,
+		static_cast<uint64_t>(memory_mb) << 20, verbose);
+
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (socket_path.size() >= sizeof(address.sun_path)) {
+		std::cerr << "Socket path \"" << socket_path << "\" too long."
+			<< std::endl;
+		exit(EXIT_FAILURE);
+	}
+	strncpy(address.sun_path, socket_path.c_str(),
+		sizeof(address.sun_path) - 1);
+	int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	unlink(socket_path.c_str());
+	if (listen_fd < 0 || bind(listen_fd,
+		reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0 ||
+		listen(listen_fd, 64) != 0) {
+		std::cerr << "Failed to listen on \"" << socket_path << "\": "
+			<< strerror(errno) << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	signal(SIGPIPE, SIG_IGN);	// Write errors end the client instead
+	std::cout << "Listening on \"" << socket_path << "\"." << std::endl;
+
+	while (true) {
+		int fd = accept(listen_fd, NULL, NULL);
+		if (fd < 0) {
+			if (errno == EINTR)
+				continue;
+			std::cerr << "accept failed: " << strerror(errno) << std::endl;
+			break;
+		}
+		boost::thread client(serve_client, &server, fd,
+			static_cast<size_t>(max_request_mb) << 20);
+		client.detach();
+	}
+	close(listen_fd);
+
+	return (EXIT_FAILURE);
+}
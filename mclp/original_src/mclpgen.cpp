@@ -7,12 +7,14 @@
 #include <sstream>
 #include <string>
 #include <algorithm>
+#include <limits>
 #include <boost/program_options.hpp>
 #include <boost/random.hpp>
 
 #include <assert.h>
 #include <stdlib.h>
 #include <math.h>
+#include <stdint.h>
 
 namespace po = boost::program_options;
 
@@ -121,8 +123,15 @@ int main(int argc, char* argv[]) {
 	std::cout << "Written " << number_samples << " files, "
 		<< number_classifiers << " weak learners, "
 		<< number_classes << " classes." << std::endl;
+	// 64-bit product, the element count overflows 32 bits for large
+	// problems.
+	uint64_t elements = static_cast<uint64_t>(number_samples)
+		* number_classifiers * number_classes;
 	std::cout << "Constraint matrix will have approximately "
-		<< (number_samples * number_classifiers * number_classes)
-		<< " non-zero elements." << std::endl;
+		<< elements << " non-zero elements." << std::endl;
+	if (elements > static_cast<uint64_t>(std::numeric_limits<int>::max())) {
+		std::cout << "Warning: this exceeds 2^31-1 elements, mclp needs a "
+			<< "solver build with 64-bit CoinBigIndex." << std::endl;
+	}
 }
 
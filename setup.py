@@ -1,6 +1,7 @@
 #!/usr/bin/env python
 
 import os
+import sys
 
 from distribute_setup import use_setuptools
 use_setuptools()
@@ -14,8 +15,14 @@ coin_libs = ["Clp", "CoinUtils", "Osi", "OsiClp"]
 
 LIB_DIRS = []
 BOOST_PYTHON_LIBRARY = "boost_python"
+BOOST_THREAD_LIBRARY = "boost_thread"
+BOOST_FILESYSTEM_LIBRARY = "boost_filesystem"
 BOOST_INCLUDE_PATH = os.environ.get('BOOST_INCLUDE_PATH', '/usr/include/boost')
 COIN_INCLUDE_PATH = os.environ.get('COIN_INCLUDE_PATH', '/usr/include/coin')
+# As in mclp/original_src/Makefile: the Cholesky backends Clp was built
+# with, and -fopenmp or -DHAS_OPENBLAS for barrier_threads to apply, e.g.
+# CHOLESKY_FLAGS="-DHAS_CLP_CHOLMOD -DHAS_OPENBLAS -fopenmp"
+CHOLESKY_FLAGS = os.environ.get('CHOLESKY_FLAGS', '').split()
 
 for suffix in boost_suffixes_to_try:    
     candidate_name = "boost_python" + suffix
@@ -24,6 +31,33 @@ for suffix in boost_suffixes_to_try:
         LIB_DIRS.append(library_path(candidate_name))
         break
 
+for suffix in boost_suffixes_to_try:
+    candidate_name = "boost_thread" + suffix
+    if has_library(candidate_name):
+        BOOST_THREAD_LIBRARY = candidate_name
+        lib_path = library_path(candidate_name)
+        if lib_path not in LIB_DIRS:
+            LIB_DIRS.append(lib_path)
+        break
+
+for suffix in boost_suffixes_to_try:
+    candidate_name = "boost_filesystem" + suffix
+    if has_library(candidate_name):
+        BOOST_FILESYSTEM_LIBRARY = candidate_name
+        lib_path = library_path(candidate_name)
+        if lib_path not in LIB_DIRS:
+            LIB_DIRS.append(lib_path)
+        break
+
+# update_async() runs on concurrent.futures, a backport on Python 2
+INSTALL_REQUIRES = []
+if sys.version_info[0] < 3:
+    INSTALL_REQUIRES.append("futures")
+
+CHOLESKY_LIBRARIES = []
+if "-DHAS_OPENBLAS" in CHOLESKY_FLAGS:
+    CHOLESKY_LIBRARIES.append("openblas")
+
 for coin_lib in coin_libs:
     if has_library(coin_lib):
         lib_path = library_path(coin_lib)
@@ -39,13 +73,16 @@ setup(name='mclp',
       include_package_data = True,
       zip_safe = False,
       setup_requires=['nose>=0.11'],
+      install_requires = INSTALL_REQUIRES,
       test_suite = "nose.collector",
       ext_modules = [
         Extension('mclp._mclp', 
                   ['mclp/LPBoostPythonWrapper.cpp', 'mclp/original_src/LPBoostMulticlassClassifier.cpp'], 
-                  libraries = [BOOST_PYTHON_LIBRARY, 'Clp', 'CoinUtils', 'Osi', 'OsiClp'],
+                  libraries = [BOOST_PYTHON_LIBRARY, BOOST_THREAD_LIBRARY, BOOST_FILESYSTEM_LIBRARY, 'boost_system', 'Clp', 'CoinUtils', 'Osi', 'OsiClp'] + CHOLESKY_LIBRARIES,
                   library_dirs = LIB_DIRS,
                   include_dirs = ['mclp/original_src', COIN_INCLUDE_PATH, BOOST_INCLUDE_PATH],
+                  extra_compile_args = CHOLESKY_FLAGS,
+                  extra_link_args = [flag for flag in CHOLESKY_FLAGS if flag == '-fopenmp'],
                   )
         ],
       )